@@ -5,6 +5,7 @@
 #include "Inline/BasicTypes.h"
 #include "Types.h"
 
+#include <atomic>
 #include <vector>
 
 namespace IR
@@ -142,6 +143,43 @@ namespace IR
 	};
 
 	// A WebAssembly module definition
+	// A hash of a module's contents that is computed on demand and cached with the module. Copying
+	// or assigning a module doesn't copy the cached hash, since the copy may then be modified.
+	struct ModuleHashCache
+	{
+		ModuleHashCache() : isValid(false) {}
+		ModuleHashCache(const ModuleHashCache&) : isValid(false) {}
+		ModuleHashCache& operator=(const ModuleHashCache&)
+		{
+			reset();
+			return *this;
+		}
+
+		// Reads the cached hash. Returns false if it hasn't been computed.
+		bool get(U64 outHashes[2]) const
+		{
+			if(!isValid.load(std::memory_order_acquire)) { return false; }
+			outHashes[0] = hashes[0].load(std::memory_order_relaxed);
+			outHashes[1] = hashes[1].load(std::memory_order_relaxed);
+			return true;
+		}
+
+		// Caches a hash. Threads that race to cache the hash of the same module store the same
+		// values, so they don't need to be serialized.
+		void set(const U64 inHashes[2]) const
+		{
+			hashes[0].store(inHashes[0], std::memory_order_relaxed);
+			hashes[1].store(inHashes[1], std::memory_order_relaxed);
+			isValid.store(true, std::memory_order_release);
+		}
+
+		void reset() const { isValid.store(false, std::memory_order_release); }
+
+	private:
+		mutable std::atomic<U64> hashes[2];
+		mutable std::atomic<bool> isValid;
+	};
+
 	struct Module
 	{
 		FeatureSpec featureSpec;
@@ -161,6 +199,11 @@ namespace IR
 
 		Uptr startFunctionIndex;
 
+		// The hash of the module's binary encoding, cached by the runtime when the module is first
+		// instantiated to find the object code compiled for it. Code that modifies a module after
+		// instantiating it must reset the cached hash.
+		ModuleHashCache hashCache;
+
 		Module() : startFunctionIndex(UINTPTR_MAX) {}
 
 		Module(const FeatureSpec& inFeatureSpec)
@@ -164,6 +164,64 @@ namespace Platform
 											  Uptr numPages,
 											  Uptr alignmentLog2);
 
+	// Hints that the specified virtual pages should be backed by huge pages where possible, to
+	// reduce TLB misses when accessing them. Does nothing if the platform doesn't support it.
+	// baseVirtualAddress must be a multiple of the preferred page size.
+	PLATFORM_API void adviseHugeVirtualPages(U8* baseVirtualAddress, Uptr numPages);
+
+	// Commits physical memory to the specified committed virtual pages immediately, so accessing
+	// them doesn't page fault. If isWrite is false, pages that are mapped copy-on-write keep
+	// sharing the mapped pages until they are written. baseVirtualAddress must be a multiple of
+	// the preferred page size. Return true if successful, or false if physical memory has been
+	// exhausted.
+	PLATFORM_API bool prefaultVirtualPages(U8* baseVirtualAddress, Uptr numPages, bool isWrite);
+
+	// Locks the specified committed virtual pages in physical memory, committing physical memory to
+	// them if needed, so they aren't paged out. Locking writable copy-on-write pages copies them.
+	// baseVirtualAddress must be a multiple of the preferred page size. Return true if successful,
+	// or false if the pages could not be locked.
+	PLATFORM_API bool lockVirtualPages(U8* baseVirtualAddress, Uptr numPages);
+
+	// Unlocks virtual pages that were locked by lockVirtualPages. Pages must be unlocked before
+	// they are decommitted. baseVirtualAddress must be a multiple of the preferred page size.
+	PLATFORM_API void unlockVirtualPages(U8* baseVirtualAddress, Uptr numPages);
+
+	// A file of zero-initialized pages in memory that can be mapped into virtual memory. Mapping a
+	// page file copy-on-write lets many mappings share the file's pages until each writes to them.
+	struct PageFile;
+
+	// Creates a page file with the specified number of pages. The pages don't use any physical
+	// memory until they are written. Returns nullptr if page files aren't supported.
+	PLATFORM_API PageFile* createPageFile(Uptr numPages);
+
+	// Destroys a page file. Mappings of the file keep its pages alive until they are unmapped.
+	PLATFORM_API void destroyPageFile(PageFile* file);
+
+	// Maps pages of a page file to the specified virtual pages, replacing any pages mapped there.
+	// If isCopyOnWrite, writes to the mapping are private to it; otherwise, they are written to the
+	// file. baseVirtualAddress must be in virtual addresses returned by allocateVirtualPages.
+	// Return true if successful, or false if the pages could not be mapped.
+	PLATFORM_API bool mapPageFile(PageFile* file,
+								  Uptr filePageIndex,
+								  U8* baseVirtualAddress,
+								  Uptr numPages,
+								  bool isCopyOnWrite,
+								  MemoryAccess access);
+
+	// Replaces the page file mappings of the specified virtual pages with uncommitted pages.
+	PLATFORM_API void unmapPageFile(U8* baseVirtualAddress, Uptr numPages);
+
+	// Resets pages of a page file to zero, and frees the physical memory they used. Must not be
+	// called for a page file that is mapped copy-on-write.
+	PLATFORM_API void decommitPageFilePages(PageFile* file, Uptr filePageIndex, Uptr numPages);
+
+	// Determines which of the specified virtual pages have been written since they were mapped
+	// copy-on-write, so they no longer share the page file's pages. Returns false if the platform
+	// can't determine that, in which case all the pages must be assumed to have been written.
+	PLATFORM_API bool getCopiedVirtualPages(U8* baseVirtualAddress,
+											Uptr numPages,
+											std::vector<bool>& outIsPageCopied);
+
 	//
 	// Error reporting
 	//
@@ -275,6 +333,15 @@ namespace Platform
 
 	RETURNS_TWICE PLATFORM_API Thread* forkCurrentThread();
 
+	// Returns the number of hardware threads that may run concurrently.
+	PLATFORM_API Uptr getNumberOfHardwareThreads();
+
+	// Returns the ID of the current process.
+	PLATFORM_API Uptr getProcessId();
+
+	// Lets the OS run another thread on the current thread's processor.
+	PLATFORM_API void yieldToAnotherThread();
+
 	// Returns the current value of a clock that may be used as an absolute time for wait timeouts.
 	// The resolution is microseconds, and the origin is arbitrary.
 	PLATFORM_API U64 getMonotonicClock();
@@ -220,6 +220,20 @@ namespace Runtime
 														   FunctionInstance* function,
 														   const IR::UntaggedValue* arguments);
 
+	// Invokes a FunctionInstance numInvokes times. The arguments for the invokes are read from an
+	// array of numInvokes * <number of parameters> values, and the results are written to an array
+	// of numInvokes * <number of results> values, without checking their types. If an invoke
+	// causes a runtime exception, catchThunk is called with the index of the invoke and the
+	// exception, the invoke's results are zeroed, and the batch continues with the next invoke.
+	// Returns the number of invokes that caused a runtime exception.
+	RUNTIME_API Uptr
+	invokeFunctionBatch(Context* context,
+						FunctionInstance* function,
+						Uptr numInvokes,
+						const IR::UntaggedValue* arguments,
+						IR::UntaggedValue* results,
+						const std::function<void(Uptr invokeIndex, Exception&&)>& catchThunk);
+
 	// Like invokeFunctionUnchecked, but returns a result tagged with its type, and takes arguments
 	// as tagged values. If the wrong number or types or arguments are provided, a runtime exception
 	// is thrown.
@@ -230,6 +244,12 @@ namespace Runtime
 	// Returns the type of a FunctionInstance.
 	RUNTIME_API IR::FunctionType getFunctionType(FunctionInstance* function);
 
+	// Returns a thunk that calls a FunctionInstance with the native C calling convention. The thunk
+	// takes the returned pointer to the function's code pointer, the ContextRuntimeData to call the
+	// function in, and the function's arguments, and returns the function's result.
+	RUNTIME_API void* getTypedInvokeThunk(FunctionInstance* function,
+										  void* const*& outNativeFunctionPointer);
+
 	//
 	// Tables
 	//
@@ -261,6 +281,9 @@ namespace Runtime
 	// Creates a Memory. May return null if the memory allocation fails.
 	RUNTIME_API MemoryInstance* createMemory(Compartment* compartment, IR::MemoryType type);
 
+	// Creates a copy of a memory in another compartment. If the platform supports it, the copy
+	// shares the memory's pages copy-on-write, so only the pages that either memory writes to after
+	// this are copied.
 	RUNTIME_API MemoryInstance* cloneMemory(MemoryInstance* memory, Compartment* newCompartment);
 
 	// Gets the base address of the memory's data.
@@ -277,6 +300,51 @@ namespace Runtime
 	// Unmaps a range of memory pages within the memory's address-space.
 	RUNTIME_API void unmapMemoryPages(MemoryInstance* memory, Uptr pageIndex, Uptr numPages);
 
+	// Sets the maximum number of address space reservations for freed memories that are kept to be
+	// reused by new memories, instead of reserving and freeing address space for each memory.
+	// Pooled reservations only use address space: their pages are decommitted when the memory is
+	// freed. Defaults to 16.
+	RUNTIME_API void setMaxPooledMemoryReservations(Uptr maxReservations);
+
+	// Statistics about the pool of memory address space reservations. The counts of allocated,
+	// reused, and freed reservations are totals since the process started.
+	struct MemoryReservationPoolStats
+	{
+		Uptr numPooledReservations;
+		Uptr maxPooledReservations;
+		Uptr numAllocatedReservations;
+		Uptr numReusedReservations;
+		Uptr numFreedReservations;
+	};
+
+	// Returns statistics about the pool of memory address space reservations.
+	RUNTIME_API MemoryReservationPoolStats getMemoryReservationPoolStats();
+
+	// Options for how physical memory is committed to a memory's pages.
+	struct MemoryCommitPolicy
+	{
+		// Hint that the pages should be backed by huge pages, to reduce TLB misses when accessing
+		// a large memory. Hosts usually only allow huge pages for anonymous memory, so memories
+		// that use huge pages don't share pages copy-on-write with their clones, snapshots, or the
+		// memory image cache, and don't reuse pooled address space. Cloning a memory or restoring
+		// a snapshot to a memory that uses huge pages copies its pages.
+		bool useHugePages = false;
+
+		// Commit physical memory to the pages when the memory grows, instead of when they are first
+		// accessed. Pages shared copy-on-write are still copied when they are first written.
+		bool prefault = false;
+
+		// Lock the pages in physical memory, so they aren't paged out. Locking pages that are
+		// shared copy-on-write copies them. Growing the memory fails if the pages can't be locked.
+		bool lock = false;
+	};
+
+	// Sets the commit policy of the memories that are created in a compartment after this,
+	// including the memories of modules instantiated in it. Clones of the compartment, and
+	// compartments restored from snapshots of it, inherit the policy.
+	RUNTIME_API void setMemoryCommitPolicy(Compartment* compartment,
+										   const MemoryCommitPolicy& policy);
+
 	// Validates that an offset range is wholly inside a Memory's virtual address range.
 	RUNTIME_API U8* getValidatedMemoryOffsetRange(MemoryInstance* memory,
 												  Uptr offset,
@@ -329,12 +397,180 @@ namespace Runtime
 		std::vector<ExceptionTypeInstance*> exceptionTypes;
 	};
 
+	// How much a module's code is optimized when it is compiled.
+	enum class OptimizationLevel : U8
+	{
+		// Compiles as quickly as possible, without optimizing the code.
+		none,
+
+		// Runs a few inexpensive optimization passes. This is the default.
+		basic,
+
+		// Runs a full -O3 style optimization pipeline, including inlining, loop optimizations, and
+		// vectorization. Takes much longer to compile than basic.
+		full
+	};
+
 	// Instantiates a module, bindings its imports to the specified objects. May throw a runtime
 	// exception for bad segment offsets.
-	RUNTIME_API ModuleInstance* instantiateModule(Compartment* compartment,
-												  const IR::Module& module,
-												  ImportBindings&& imports,
-												  std::string&& debugName);
+	RUNTIME_API ModuleInstance* instantiateModule(
+		Compartment* compartment,
+		const IR::Module& module,
+		ImportBindings&& imports,
+		std::string&& debugName,
+		OptimizationLevel optimizationLevel = OptimizationLevel::basic);
+
+	// A module that is being instantiated in the background.
+	struct AsyncInstantiation;
+
+	// Queues a module to be instantiated on a background thread, and returns a handle that can be
+	// used to wait for the module instance or cancel the instantiation. The module is copied, so it
+	// doesn't need to outlive the call. The compartment and the imported objects are rooted until
+	// the instantiation completes, and the objects created for the module instance are rooted while
+	// it is instantiated, so collectGarbage may be called concurrently. If onComplete is non-null,
+	// it is called when the instantiation completes with the module instance, or null if it failed
+	// or was cancelled. It is called on the background thread, or on the cancelling thread if the
+	// instantiation is cancelled before it starts. When the JIT is shut down, the queued
+	// instantiations are cancelled, and the running ones are completed.
+	RUNTIME_API AsyncInstantiation* instantiateModuleAsync(
+		Compartment* compartment,
+		const IR::Module& module,
+		ImportBindings&& imports,
+		std::string&& debugName,
+		OptimizationLevel optimizationLevel             = OptimizationLevel::basic,
+		std::function<void(ModuleInstance*)>&& onComplete = nullptr);
+
+	// Returns true if an asynchronous instantiation has completed, failed, or been cancelled.
+	RUNTIME_API bool isInstantiationComplete(AsyncInstantiation* instantiation);
+
+	// Waits for an asynchronous instantiation to complete, and returns the module instance. Returns
+	// null if the instantiation was cancelled, or threw a runtime exception; in the latter case,
+	// the exception is written to outException if it is non-null.
+	RUNTIME_API ModuleInstance* waitForInstantiation(AsyncInstantiation* instantiation,
+													 Exception* outException = nullptr);
+
+	// Cancels an asynchronous instantiation. An instantiation that hasn't started yet is removed
+	// from the queue without compiling anything; one that has already started runs to completion,
+	// but its module instance is discarded.
+	RUNTIME_API void cancelInstantiation(AsyncInstantiation* instantiation);
+
+	// Deletes the handle for an asynchronous instantiation, cancelling it if it hasn't completed.
+	// The module instance is only kept alive by the handle until it is deleted.
+	RUNTIME_API void deleteAsyncInstantiation(AsyncInstantiation* instantiation);
+
+	// Sets the maximum number of modules that are instantiated in the background at once, which is
+	// also the maximum size of the pool of background instantiation threads. Each of them may use
+	// up to the number of threads set by setMaxCompileThreads. Defaults to 1.
+	RUNTIME_API void setMaxAsyncInstantiationThreads(Uptr numThreads);
+
+	// Bounds the memory used by background instantiations by limiting the total size of the
+	// WebAssembly code in the modules that are compiled at once. A module larger than the limit is
+	// still compiled, but only when no other module is being compiled in the background. The
+	// default of 0 means no limit.
+	RUNTIME_API void setMaxAsyncCompileCodeBytes(Uptr numBytes);
+
+	// Sets the maximum number of threads used to compile a module. Modules are split into
+	// partitions by function that are compiled in parallel. The default of 0 uses one thread per
+	// hardware thread.
+	RUNTIME_API void setMaxCompileThreads(Uptr numThreads);
+
+	// Enables tiered compilation: modules are compiled without optimization so they can start
+	// running sooner, and functions that are called or loop often are recompiled with optimization
+	// in the background. Disabled by default.
+	RUNTIME_API void setTieredCompilation(bool enable);
+
+	// Returns the number of functions that tiered compilation has recompiled at the optimized tier.
+	RUNTIME_API Uptr getNumTieredUpFunctions();
+
+	// Waits until the functions that were queued to be recompiled at the optimized tier have been
+	// recompiled.
+	RUNTIME_API void waitForTierUp();
+
+	// Enables lazy compilation: instantiating a module only compiles a small stub for each of its
+	// functions, and each function is compiled the first time it is called. Disabled by default.
+	RUNTIME_API void setLazyCompilation(bool enable);
+
+	// Enables emitting DWARF debug info for compiled code, which maps machine code to the
+	// WebAssembly ops it was compiled from. It is used to describe the op that each frame of a call
+	// stack is executing, and by debuggers. Disabling it makes emitting, compiling, and loading
+	// code faster, but call stacks only identify the functions. Enabled by default.
+	RUNTIME_API void setDebugInfo(bool enable);
+
+	// Enables compiling loads and stores of unshared memories as ordinary memory accesses that LLVM
+	// may combine, eliminate, reorder, and vectorize. An out-of-bounds access still can't access
+	// memory outside the guard pages, but it may not trap if its result is unused, and may trap
+	// before or after the accesses around it. Disabled by default, so every out-of-bounds access
+	// traps in program order.
+	RUNTIME_API void setRelaxedMemoryTraps(bool enable);
+
+	// Enables writing the name and address range of each function and thunk that is compiled to
+	// /tmp/perf-<pid>.map, which the Linux perf tool uses to name JIT compiled code in profiles.
+	// Disabled by default.
+	RUNTIME_API void setPerfMapEnabled(bool enable);
+
+	// Enables registering compiled code with GDB's JIT interface, so GDB can show the names of
+	// WebAssembly functions, and step through them. Each registration makes loading code slower as
+	// more objects are registered, so it is only enabled by default in debug builds. Objects that
+	// were loaded while it was disabled aren't registered when it is enabled.
+	RUNTIME_API void setGDBRegistration(bool enable);
+
+	// Enables an on-disk cache of the object code compiled for modules, so instantiating a module
+	// that was compiled by an earlier process doesn't need to recompile it. When the cache grows
+	// larger than maxBytes, the least recently used entries are deleted; a maxBytes of 0 means no
+	// limit. An empty directory disables the cache, which is the default.
+	RUNTIME_API void setObjectCacheDirectory(const std::string& directory, U64 maxBytes);
+
+	// Sets the maximum size of the cache of memory images: the contents of a module's memories
+	// after its data segments are copied into them, which later instances of the module restore
+	// copy-on-write instead of copying the data segments. The size counts the data segment bytes
+	// of the cached images. When the cache grows larger than maxBytes, the least recently used
+	// images are evicted. A maxBytes of 0 disables the cache. Defaults to 256MB.
+	RUNTIME_API void setMaxMemoryImageCacheBytes(Uptr maxBytes);
+
+	// Statistics about the memory image cache. The counts of restored memories and rejected images
+	// are totals since the process started. An image is rejected if it was found by a module whose
+	// data segments it doesn't contain.
+	struct MemoryImageCacheStats
+	{
+		Uptr numImages;
+		Uptr numDataBytes;
+		Uptr maxDataBytes;
+		Uptr numRestoredMemories;
+		Uptr numRejectedImages;
+	};
+
+	// Returns statistics about the memory image cache.
+	RUNTIME_API MemoryImageCacheStats getMemoryImageCacheStats();
+
+	// A module and the object code that was compiled for it ahead of time, loaded from a
+	// precompiled module file.
+	struct PrecompiledModule;
+
+	// Writes a precompiled module file containing a module and the object code that was compiled
+	// for an instance of it. The module instance must have been instantiated with tiered and lazy
+	// compilation disabled. The object code depends on the host CPU, and on the calling conventions
+	// of the functions that the module's function imports were bound to. Returns false if the file
+	// couldn't be written.
+	RUNTIME_API bool savePrecompiledModule(ModuleInstance* moduleInstance,
+										   const IR::Module& module,
+										   const std::string& filename);
+
+	// Maps a precompiled module file into memory, without compiling any code. Returns null if the
+	// file couldn't be read, or was compiled for a different CPU or version of WAVM.
+	RUNTIME_API PrecompiledModule* loadPrecompiledModule(const std::string& filename);
+	RUNTIME_API void deletePrecompiledModule(PrecompiledModule* precompiledModule);
+
+	// Gets the module that a precompiled module was compiled from, to link its imports.
+	RUNTIME_API const IR::Module& getPrecompiledModuleIR(PrecompiledModule* precompiledModule);
+
+	// Instantiates a precompiled module, binding its imports to the specified objects, using the
+	// object code in the precompiled module instead of compiling it. Returns null if the imports
+	// have different calling conventions than the object code was compiled for. May throw a runtime
+	// exception for bad segment offsets.
+	RUNTIME_API ModuleInstance* instantiatePrecompiledModule(Compartment* compartment,
+															 PrecompiledModule* precompiledModule,
+															 ImportBindings&& imports,
+															 std::string&& debugName);
 
 	// Gets the start function of a ModuleInstance.
 	RUNTIME_API FunctionInstance* getStartFunction(ModuleInstance* moduleInstance);
@@ -354,6 +590,37 @@ namespace Runtime
 
 	RUNTIME_API Compartment* cloneCompartment(Compartment* compartment);
 
+	// Maps a memory, table, or global to the object with the same ID in a clone of its
+	// compartment, or in a compartment restored from a snapshot of it. Functions and exception
+	// types are shared between compartments, so they are returned unchanged.
+	RUNTIME_API Object* remapToClonedCompartment(Object* object, Compartment* newCompartment);
+
+	//
+	// Compartment snapshots
+	//
+
+	// A snapshot of a compartment's memories, tables, and globals, and of the values of a
+	// context's mutable globals: e.g. after instantiating modules and running their start
+	// functions. If the platform supports it, the snapshot shares the memories' pages
+	// copy-on-write, so restoring it doesn't copy them.
+	// The snapshot doesn't reference the snapshotted compartment's memories, tables, or globals,
+	// but it does reference the functions in the snapshotted tables. Functions reference their
+	// module instance, which references its compartment, so a snapshot of a compartment with
+	// functions in its tables keeps the compartment alive until the snapshot is deleted.
+	struct CompartmentSnapshot;
+
+	RUNTIME_API CompartmentSnapshot* snapshotCompartment(Context* context);
+	RUNTIME_API void deleteCompartmentSnapshot(CompartmentSnapshot* snapshot);
+
+	// Creates a new compartment with the state of a snapshot, and returns a context in it with the
+	// snapshotted values of the mutable globals. The module instances in the snapshotted
+	// compartment may be used with the new compartment by mapping their exports with
+	// remapToClonedCompartment.
+	// Like the objects in a cloned compartment, the new compartment's memories, tables, and globals
+	// are only kept alive by references to them. Returns null if it fails to allocate a memory or
+	// table.
+	RUNTIME_API Context* restoreCompartmentSnapshot(const CompartmentSnapshot* snapshot);
+
 	//
 	// Contexts
 	//
@@ -372,4 +639,60 @@ namespace Runtime
 	RUNTIME_API MemoryInstance* getMemoryFromRuntimeData(
 		struct ContextRuntimeData* contextRuntimeData,
 		Uptr memoryId);
+
+	//
+	// JIT memory
+	//
+
+	// Statistics about the memory used by the code and data of JIT compiled modules and thunks.
+	struct JITMemoryStats
+	{
+		Uptr numRegions;
+		Uptr numReservedBytes;
+		Uptr numCommittedBytes;
+		Uptr numCodeBytes;
+		Uptr numReadOnlyBytes;
+		Uptr numReadWriteBytes;
+		Uptr numReservations;
+	};
+
+	// Returns statistics about the memory currently used by JIT compiled code and data.
+	RUNTIME_API JITMemoryStats getJITMemoryStats();
+
+	//
+	// Typed functions
+	//
+
+	// A FunctionInstance bound to a static C++ signature. The signature is checked against the
+	// function's type when the TypedFunction is created, after which calls go through a thunk that
+	// passes the arguments and result in native registers, without any heap allocation. Like
+	// invokeFunctionUnchecked, runtime exceptions are not caught.
+	template<typename Signature> struct TypedFunction;
+	template<typename Result, typename... Args> struct TypedFunction<Result(Args...)>
+	{
+		TypedFunction() : nativeFunctionPointer(nullptr), thunk(nullptr) {}
+
+		// Binds the TypedFunction to a FunctionInstance. If the FunctionInstance's type doesn't
+		// match the signature, a runtime exception is thrown.
+		TypedFunction(FunctionInstance* function)
+		{
+			const IR::FunctionType signatureType(IR::inferResultType<Result>(),
+												 IR::TypeTuple({IR::inferValueType<Args>()...}));
+			if(getFunctionType(function) != signatureType)
+			{ throwException(Exception::invokeSignatureMismatchType); }
+			thunk = reinterpret_cast<Thunk>(getTypedInvokeThunk(function, nativeFunctionPointer));
+		}
+
+		Result operator()(Context* context, Args... args) const
+		{
+			wavmAssert(thunk);
+			return (*thunk)(nativeFunctionPointer, getContextRuntimeData(context), args...);
+		}
+
+	private:
+		typedef Result (*Thunk)(void* const*, ContextRuntimeData*, Args...);
+
+		void* const* nativeFunctionPointer;
+		Thunk thunk;
+	};
 }
@@ -13,15 +13,18 @@
 #include <fcntl.h>
 #include <limits.h>
 #include <pthread.h>
+#include <sched.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
 #include <atomic>
 #include <cstdlib>
 #include <exception>
@@ -41,6 +44,15 @@
 #define MAP_STACK_FLAGS 0
 #endif
 
+#if defined(__linux__) && !defined(MFD_CLOEXEC)
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+#if defined(__linux__) && !defined(MADV_POPULATE_READ)
+#define MADV_POPULATE_READ 22
+#define MADV_POPULATE_WRITE 23
+#endif
+
 using namespace Platform;
 
 // This struct layout is replicated in POSIX.S
@@ -200,6 +212,170 @@ void Platform::freeAlignedVirtualPages(U8* unalignedBaseAddress, Uptr numPages,
 	{ Errors::fatal("munmap failed"); }
 }
 
+void Platform::adviseHugeVirtualPages(U8* baseVirtualAddress, Uptr numPages)
+{
+	errorUnless(isPageAligned(baseVirtualAddress));
+#ifdef MADV_HUGEPAGE
+	// This is only a hint, so ignore failure, e.g. if the kernel was built without transparent huge
+	// page support.
+	madvise(baseVirtualAddress, numPages << getPageSizeLog2(), MADV_HUGEPAGE);
+#endif
+}
+
+bool Platform::prefaultVirtualPages(U8* baseVirtualAddress, Uptr numPages, bool isWrite)
+{
+	errorUnless(isPageAligned(baseVirtualAddress));
+	const Uptr numBytes = numPages << getPageSizeLog2();
+#ifdef __linux__
+	// Linux 5.14 can populate the pages in a single call. Older kernels fail with EINVAL, so fall
+	// back to touching each page.
+	if(!madvise(baseVirtualAddress, numBytes, isWrite ? MADV_POPULATE_WRITE : MADV_POPULATE_READ))
+	{ return true; }
+	else if(errno != EINVAL)
+	{
+		return false;
+	}
+#endif
+
+	// Touch each page. Writes use an atomic read-modify-write that doesn't change the page's
+	// contents, since other threads may be accessing them.
+	for(Uptr offset = 0; offset < numBytes; offset += Uptr(1) << getPageSizeLog2())
+	{
+		U8* address = baseVirtualAddress + offset;
+		if(isWrite) { __atomic_fetch_or(address, U8(0), __ATOMIC_RELAXED); }
+		else
+		{
+			*(volatile U8*)address;
+		}
+	}
+	return true;
+}
+
+bool Platform::lockVirtualPages(U8* baseVirtualAddress, Uptr numPages)
+{
+	errorUnless(isPageAligned(baseVirtualAddress));
+	return mlock(baseVirtualAddress, numPages << getPageSizeLog2()) == 0;
+}
+
+void Platform::unlockVirtualPages(U8* baseVirtualAddress, Uptr numPages)
+{
+	errorUnless(isPageAligned(baseVirtualAddress));
+	if(munlock(baseVirtualAddress, numPages << getPageSizeLog2()))
+	{ Errors::fatal("munlock failed"); }
+}
+
+struct Platform::PageFile
+{
+	int fd;
+};
+
+PageFile* Platform::createPageFile(Uptr numPages)
+{
+#ifdef __linux__
+	// Use a memfd: an anonymous file in memory that can be mapped shared or copy-on-write.
+	const int fd = int(syscall(SYS_memfd_create, "WAVM page file", MFD_CLOEXEC));
+	if(fd < 0) { return nullptr; }
+	if(ftruncate(fd, off_t(numPages << getPageSizeLog2())))
+	{
+		close(fd);
+		return nullptr;
+	}
+	return new PageFile{fd};
+#else
+	return nullptr;
+#endif
+}
+
+void Platform::destroyPageFile(PageFile* file)
+{
+	if(close(file->fd)) { Errors::fatal("close failed"); }
+	delete file;
+}
+
+bool Platform::mapPageFile(PageFile* file,
+						   Uptr filePageIndex,
+						   U8* baseVirtualAddress,
+						   Uptr numPages,
+						   bool isCopyOnWrite,
+						   MemoryAccess access)
+{
+	errorUnless(isPageAligned(baseVirtualAddress));
+	const Uptr pageSizeLog2 = getPageSizeLog2();
+	const Uptr numBytes     = numPages << pageSizeLog2;
+	const off_t offset      = off_t(filePageIndex << pageSizeLog2);
+	const int prot          = memoryAccessAsPOSIXFlag(access);
+	const int flags         = MAP_FIXED | (isCopyOnWrite ? MAP_PRIVATE : MAP_SHARED);
+	return mmap(baseVirtualAddress, numBytes, prot, flags, file->fd, offset) != MAP_FAILED;
+}
+
+void Platform::unmapPageFile(U8* baseVirtualAddress, Uptr numPages)
+{
+	errorUnless(isPageAligned(baseVirtualAddress));
+	void* result = mmap(baseVirtualAddress,
+						numPages << getPageSizeLog2(),
+						PROT_NONE,
+						MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS,
+						-1,
+						0);
+	if(result == MAP_FAILED) { Errors::fatal("mmap failed"); }
+}
+
+void Platform::decommitPageFilePages(PageFile* file, Uptr filePageIndex, Uptr numPages)
+{
+#ifdef __linux__
+	const Uptr pageSizeLog2 = getPageSizeLog2();
+	if(fallocate(file->fd,
+				 FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+				 off_t(filePageIndex << pageSizeLog2),
+				 off_t(numPages << pageSizeLog2)))
+	{ Errors::fatal("fallocate failed"); }
+#else
+	Errors::unreachable();
+#endif
+}
+
+bool Platform::getCopiedVirtualPages(U8* baseVirtualAddress,
+									 Uptr numPages,
+									 std::vector<bool>& outIsPageCopied)
+{
+#ifdef __linux__
+	// /proc/self/pagemap has a 64-bit entry for each virtual page of the process. Bit 63 is set if
+	// the page is present, bit 62 if it is swapped out, and bit 61 if it is a page of a file. The
+	// pages that a copy-on-write mapping has written are present or swapped out, but aren't pages
+	// of the file.
+	const int fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+	if(fd < 0) { return false; }
+
+	outIsPageCopied.assign(numPages, false);
+	const Uptr basePageIndex = reinterpret_cast<Uptr>(baseVirtualAddress) >> getPageSizeLog2();
+	std::vector<U64> entries(std::min(numPages, Uptr(8192)));
+	for(Uptr pageIndex = 0; pageIndex < numPages;)
+	{
+		const Uptr numReadPages = std::min(numPages - pageIndex, Uptr(entries.size()));
+		const Uptr numReadBytes = numReadPages * sizeof(U64);
+		if(pread(fd, entries.data(), numReadBytes, off_t((basePageIndex + pageIndex) * sizeof(U64)))
+		   != ssize_t(numReadBytes))
+		{
+			close(fd);
+			return false;
+		}
+
+		for(Uptr readPageIndex = 0; readPageIndex < numReadPages; ++readPageIndex)
+		{
+			const U64 entry = entries[readPageIndex];
+			outIsPageCopied[pageIndex + readPageIndex]
+				= (entry & (U64(3) << 62)) && !(entry & (U64(1) << 61));
+		}
+		pageIndex += numReadPages;
+	}
+
+	close(fd);
+	return true;
+#else
+	return false;
+#endif
+}
+
 static Mutex& getErrorReportingMutex()
 {
 	static Platform::Mutex mutex;
@@ -791,6 +967,16 @@ NO_ASAN Thread* Platform::forkCurrentThread()
 	}
 }
 
+Uptr Platform::getNumberOfHardwareThreads()
+{
+	const long numOnlineProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+	return numOnlineProcessors > 0 ? Uptr(numOnlineProcessors) : 1;
+}
+
+Uptr Platform::getProcessId() { return Uptr(getpid()); }
+
+void Platform::yieldToAnotherThread() { sched_yield(); }
+
 U64 Platform::getMonotonicClock()
 {
 #ifdef __APPLE__
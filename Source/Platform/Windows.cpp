@@ -206,6 +206,75 @@ void Platform::freeAlignedVirtualPages(U8* unalignedBaseAddress, Uptr numPages,
 	if(unalignedBaseAddress && !result) { Errors::fatal("VirtualFree(MEM_RELEASE) failed"); }
 }
 
+void Platform::adviseHugeVirtualPages(U8* baseVirtualAddress, Uptr numPages)
+{
+	// Windows only supports large pages that are allocated with VirtualAlloc(MEM_LARGE_PAGES), and
+	// can't be decommitted.
+	errorUnless(isPageAligned(baseVirtualAddress));
+}
+
+bool Platform::prefaultVirtualPages(U8* baseVirtualAddress, Uptr numPages, bool isWrite)
+{
+	errorUnless(isPageAligned(baseVirtualAddress));
+
+	// Touch each page. Writes use an interlocked read-modify-write that doesn't change the page's
+	// contents, since other threads may be accessing them.
+	const Uptr numBytes = numPages << getPageSizeLog2();
+	for(Uptr offset = 0; offset < numBytes; offset += Uptr(1) << getPageSizeLog2())
+	{
+		U8* address = baseVirtualAddress + offset;
+		if(isWrite) { InterlockedOr8((volatile char*)address, 0); }
+		else
+		{
+			*(volatile U8*)address;
+		}
+	}
+	return true;
+}
+
+bool Platform::lockVirtualPages(U8* baseVirtualAddress, Uptr numPages)
+{
+	errorUnless(isPageAligned(baseVirtualAddress));
+	return VirtualLock(baseVirtualAddress, numPages << getPageSizeLog2()) != 0;
+}
+
+void Platform::unlockVirtualPages(U8* baseVirtualAddress, Uptr numPages)
+{
+	errorUnless(isPageAligned(baseVirtualAddress));
+	if(!VirtualUnlock(baseVirtualAddress, numPages << getPageSizeLog2()))
+	{ Errors::fatal("VirtualUnlock failed"); }
+}
+
+// Mapping a file view into addresses reserved by VirtualAlloc requires the placeholder APIs that
+// aren't available on all the versions of Windows that WAVM supports, so page files aren't
+// supported.
+PageFile* Platform::createPageFile(Uptr numPages) { return nullptr; }
+void Platform::destroyPageFile(PageFile* file) { Errors::unreachable(); }
+
+bool Platform::mapPageFile(PageFile* file,
+						   Uptr filePageIndex,
+						   U8* baseVirtualAddress,
+						   Uptr numPages,
+						   bool isCopyOnWrite,
+						   MemoryAccess access)
+{
+	Errors::unreachable();
+}
+
+void Platform::unmapPageFile(U8* baseVirtualAddress, Uptr numPages) { Errors::unreachable(); }
+
+void Platform::decommitPageFilePages(PageFile* file, Uptr filePageIndex, Uptr numPages)
+{
+	Errors::unreachable();
+}
+
+bool Platform::getCopiedVirtualPages(U8* baseVirtualAddress,
+									 Uptr numPages,
+									 std::vector<bool>& outIsPageCopied)
+{
+	return false;
+}
+
 static Mutex& getErrorReportingMutex()
 {
 	static Platform::Mutex mutex;
@@ -864,6 +933,17 @@ Thread* Platform::forkCurrentThread()
 	}
 }
 
+Uptr Platform::getNumberOfHardwareThreads()
+{
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	return systemInfo.dwNumberOfProcessors ? Uptr(systemInfo.dwNumberOfProcessors) : 1;
+}
+
+Uptr Platform::getProcessId() { return Uptr(GetCurrentProcessId()); }
+
+void Platform::yieldToAnotherThread() { SwitchToThread(); }
+
 U64 Platform::getMonotonicClock()
 {
 	LARGE_INTEGER performanceCounter;
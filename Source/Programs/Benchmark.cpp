@@ -0,0 +1,562 @@
+#include "CLI.h"
+#include "IR/Module.h"
+#include "Inline/Assert.h"
+#include "Inline/BasicTypes.h"
+#include "Inline/Timing.h"
+#include "Logging/Logging.h"
+#include "Platform/Platform.h"
+#include "Runtime/Runtime.h"
+
+#include <inttypes.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+using namespace IR;
+using namespace Runtime;
+
+// Runs one of the runtime's microbenchmarks, selected by a subcommand, and logs its results as
+// metrics. Each subcommand's arguments are optional, and default to values that make it run for a
+// few seconds.
+
+enum
+{
+	benchmarkThreadNumStackBytes = 1 * 1024 * 1024
+};
+
+//
+// invoke: measures the throughput of invoking a trivial WebAssembly function from the host, with a
+// varying number of threads invoking the function concurrently.
+//
+
+static const char invokeModuleWAST[]
+	= "(module\n"
+	  "  (func (export \"increment\") (param i32) (result i32)\n"
+	  "    (i32.add (get_local 0) (i32.const 1))\n"
+	  "  )\n"
+	  ")\n";
+
+enum
+{
+	invokeBatchSize = 1024
+};
+
+enum class InvokeMode
+{
+	unchecked,
+	batched,
+	typed,
+};
+
+struct InvokeThreadArgs
+{
+	Context* context;
+	FunctionInstance* function;
+	Uptr numInvokes;
+	InvokeMode invokeMode;
+	std::atomic<bool>* startFlag;
+};
+
+static I64 invokeThreadEntry(void* argsVoid)
+{
+	InvokeThreadArgs* args = (InvokeThreadArgs*)argsVoid;
+
+	// Wait until all the threads are created before starting to invoke the function.
+	while(!args->startFlag->load(std::memory_order_acquire)) {};
+
+	switch(args->invokeMode)
+	{
+	case InvokeMode::unchecked:
+	{
+		UntaggedValue argument;
+		argument.i32 = 0;
+		for(Uptr invokeIndex = 0; invokeIndex < args->numInvokes; ++invokeIndex)
+		{ argument.i32 = invokeFunctionUnchecked(args->context, args->function, &argument)->i32; }
+
+		return argument.i32;
+	}
+	case InvokeMode::batched:
+	{
+		std::vector<UntaggedValue> arguments(invokeBatchSize);
+		std::vector<UntaggedValue> results(invokeBatchSize);
+		for(Uptr invokeIndex = 0; invokeIndex < invokeBatchSize; ++invokeIndex)
+		{ arguments[invokeIndex].i32 = I32(invokeIndex); }
+
+		Uptr numInvokes = 0;
+		while(numInvokes < args->numInvokes)
+		{
+			const Uptr numBatchInvokes
+				= std::min(Uptr(invokeBatchSize), args->numInvokes - numInvokes);
+			invokeFunctionBatch(args->context,
+								args->function,
+								numBatchInvokes,
+								arguments.data(),
+								results.data(),
+								[](Uptr, Exception&& exception) {
+									Errors::fatalf("Runtime exception: %s",
+												   describeException(exception).c_str());
+								});
+			errorUnless(results[numBatchInvokes - 1].i32 == I32(numBatchInvokes));
+			numInvokes += numBatchInvokes;
+		}
+
+		return numInvokes;
+	}
+	case InvokeMode::typed:
+	{
+		TypedFunction<I32(I32)> typedFunction(args->function);
+		I32 result = 0;
+		for(Uptr invokeIndex = 0; invokeIndex < args->numInvokes; ++invokeIndex)
+		{ result = typedFunction(args->context, result); }
+
+		return result;
+	}
+	default: Errors::unreachable();
+	};
+}
+
+static bool runInvokeBenchmark(int argc, char** argv)
+{
+	if(argc > 3) { return false; }
+	const Uptr numInvokesPerThread = argc > 1 ? Uptr(atol(argv[1])) : 10000000;
+	const Uptr maxThreads = argc > 2 ? Uptr(atol(argv[2])) : Platform::getNumberOfHardwareThreads();
+	if(!numInvokesPerThread || !maxThreads) { return false; }
+
+	Module module;
+	errorUnless(loadTextModule("invoke", invokeModuleWAST, module));
+
+	Compartment* compartment = createCompartment();
+	ModuleInstance* moduleInstance
+		= instantiateModule(compartment, module, ImportBindings{}, "invoke");
+	errorUnless(moduleInstance);
+	FunctionInstance* function = asFunctionNullable(getInstanceExport(moduleInstance, "increment"));
+	errorUnless(function);
+
+	for(Uptr numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		for(InvokeMode invokeMode : {InvokeMode::unchecked, InvokeMode::batched, InvokeMode::typed})
+		{
+			// Create a context for each thread, so the threads don't share the context's scratch
+			// memory for invoke arguments and results.
+			std::atomic<bool> startFlag{false};
+			std::vector<InvokeThreadArgs> threadArgs(numThreads);
+			for(InvokeThreadArgs& args : threadArgs)
+			{
+				args.context    = createContext(compartment);
+				args.function   = function;
+				args.numInvokes = numInvokesPerThread;
+				args.invokeMode = invokeMode;
+				args.startFlag  = &startFlag;
+			}
+
+			std::vector<Platform::Thread*> threads;
+			for(InvokeThreadArgs& args : threadArgs)
+			{
+				threads.push_back(Platform::createThread(
+					benchmarkThreadNumStackBytes, invokeThreadEntry, &args));
+			}
+
+			Timing::Timer timer;
+			startFlag.store(true, std::memory_order_release);
+			for(Platform::Thread* thread : threads)
+			{ errorUnless(Uptr(Platform::joinThread(thread)) == numInvokesPerThread); }
+
+			static const char* invokeModeNames[] = {"unchecked", "batched", "typed"};
+			const std::string description = std::to_string(numThreads)
+											+ " thread(s) invoked function ("
+											+ invokeModeNames[Uptr(invokeMode)] + ")";
+			Timing::logRatePerSecond(
+				description.c_str(), timer, F64(numInvokesPerThread * numThreads), "invokes");
+		}
+	}
+
+	return true;
+}
+
+//
+// instantiate: measures the throughput of instantiating many instances of a small WebAssembly
+// module, with and without registering the instances' code with GDB. The module's object code is
+// only compiled for the first instance, so this mostly measures loading the object code.
+//
+
+static const char instantiateModuleWAST[]
+	= "(module\n"
+	  "  (func (export \"add\") (param i32 i32) (result i32)\n"
+	  "    (i32.add (get_local 0) (get_local 1))\n"
+	  "  )\n"
+	  "  (func (export \"mul\") (param i32 i32) (result i32)\n"
+	  "    (i32.mul (get_local 0) (get_local 1))\n"
+	  "  )\n"
+	  "  (func (export \"fac\") (param i64) (result i64)\n"
+	  "    (if (result i64) (i64.eqz (get_local 0))\n"
+	  "      (then (i64.const 1))\n"
+	  "      (else (i64.mul (get_local 0) (call 2 (i64.sub (get_local 0) (i64.const 1)))))\n"
+	  "    )\n"
+	  "  )\n"
+	  ")\n";
+
+static bool runInstantiateBenchmark(int argc, char** argv)
+{
+	if(argc > 2) { return false; }
+	const Uptr numInstances = argc > 1 ? Uptr(atol(argv[1])) : 5000;
+	if(!numInstances) { return false; }
+
+	Module module;
+	errorUnless(loadTextModule("instantiate", instantiateModuleWAST, module));
+
+	for(bool enableGDBRegistration : {false, true})
+	{
+		setGDBRegistration(enableGDBRegistration);
+
+		GCPointer<Compartment> compartment = createCompartment();
+
+		// Instantiate the module once before starting the timer, so the timed instantiations don't
+		// include compiling its code.
+		errorUnless(instantiateModule(compartment, module, ImportBindings{}, "instantiate"));
+
+		const std::string description = std::string("Instantiated module (GDB registration ")
+										+ (enableGDBRegistration ? "enabled" : "disabled") + ")";
+
+		// Disable logging metrics for each instantiation while timing them.
+		Log::setCategoryEnabled(Log::metrics, false);
+		Timing::Timer timer;
+		for(Uptr instanceIndex = 0; instanceIndex < numInstances; ++instanceIndex)
+		{ errorUnless(instantiateModule(compartment, module, ImportBindings{}, "instantiate")); }
+		Log::setCategoryEnabled(Log::metrics, true);
+		Timing::logRatePerSecond(description.c_str(), timer, F64(numInstances), "instances");
+
+		compartment = nullptr;
+		collectGarbage();
+	}
+
+	return true;
+}
+
+//
+// trap: measures the throughput of trapping in WebAssembly code and describing the resulting
+// exception, including its call stack, with a varying number of threads trapping concurrently.
+//
+
+static const char trapModuleWAST[]
+	= "(module\n"
+	  "  (func (export \"trap\") (param i32)\n"
+	  "    (if (i32.eqz (get_local 0)) (then unreachable))\n"
+	  "    (call 0 (i32.sub (get_local 0) (i32.const 1)))\n"
+	  "  )\n"
+	  ")\n";
+
+enum
+{
+	trapCallDepth = 8
+};
+
+struct TrapThreadArgs
+{
+	Context* context;
+	FunctionInstance* function;
+	Uptr numTraps;
+	std::atomic<bool>* startFlag;
+};
+
+static I64 trapThreadEntry(void* argsVoid)
+{
+	TrapThreadArgs* args = (TrapThreadArgs*)argsVoid;
+
+	// Wait until all the threads are created before starting to trap.
+	while(!args->startFlag->load(std::memory_order_acquire)) {};
+
+	Uptr numTraps = 0;
+	for(Uptr trapIndex = 0; trapIndex < args->numTraps; ++trapIndex)
+	{
+		catchRuntimeExceptions(
+			[&] { invokeFunctionChecked(args->context, args->function, {I32(trapCallDepth)}); },
+			[&](Exception&& exception) {
+				if(describeException(exception).size()) { ++numTraps; }
+			});
+	}
+
+	return numTraps;
+}
+
+static bool runTrapBenchmark(int argc, char** argv)
+{
+	if(argc > 3) { return false; }
+	const Uptr numTrapsPerThread = argc > 1 ? Uptr(atol(argv[1])) : 10000;
+	const Uptr maxThreads = argc > 2 ? Uptr(atol(argv[2])) : Platform::getNumberOfHardwareThreads();
+	if(!numTrapsPerThread || !maxThreads) { return false; }
+
+	Module module;
+	errorUnless(loadTextModule("trap", trapModuleWAST, module));
+
+	Compartment* compartment = createCompartment();
+	ModuleInstance* moduleInstance
+		= instantiateModule(compartment, module, ImportBindings{}, "trap");
+	errorUnless(moduleInstance);
+	FunctionInstance* function = asFunctionNullable(getInstanceExport(moduleInstance, "trap"));
+	errorUnless(function);
+
+	for(Uptr numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		std::atomic<bool> startFlag{false};
+		std::vector<TrapThreadArgs> threadArgs(numThreads);
+		for(TrapThreadArgs& args : threadArgs)
+		{
+			args.context   = createContext(compartment);
+			args.function  = function;
+			args.numTraps  = numTrapsPerThread;
+			args.startFlag = &startFlag;
+		}
+
+		std::vector<Platform::Thread*> threads;
+		for(TrapThreadArgs& args : threadArgs)
+		{
+			threads.push_back(
+				Platform::createThread(benchmarkThreadNumStackBytes, trapThreadEntry, &args));
+		}
+
+		Timing::Timer timer;
+		startFlag.store(true, std::memory_order_release);
+		for(Platform::Thread* thread : threads)
+		{ errorUnless(Uptr(Platform::joinThread(thread)) == numTrapsPerThread); }
+
+		const std::string description
+			= std::to_string(numThreads) + " thread(s) trapped and described exception";
+		Timing::logRatePerSecond(
+			description.c_str(), timer, F64(numTrapsPerThread * numThreads), "traps");
+	}
+
+	return true;
+}
+
+//
+// memory: measures the throughput of creating and freeing memories, with and without pooling their
+// address space reservations. The memories are created in batches in a compartment that is freed
+// after each batch, so the time includes creating the compartment and collecting garbage,
+// amortized over the batch.
+//
+
+enum
+{
+	numMemoriesPerBatch = 16
+};
+
+static bool runMemoryBenchmark(int argc, char** argv)
+{
+	if(argc > 2) { return false; }
+	const Uptr numBatches
+		= (argc > 1 ? Uptr(atol(argv[1])) : 100000) / Uptr(numMemoriesPerBatch);
+	if(!numBatches) { return false; }
+
+	const MemoryType memoryType(false, SizeConstraints{1, 65536});
+	for(Uptr maxPooledReservations : {Uptr(0), Uptr(numMemoriesPerBatch)})
+	{
+		setMaxPooledMemoryReservations(maxPooledReservations);
+
+		// Disable logging metrics for each garbage collection while timing them.
+		Log::setCategoryEnabled(Log::metrics, false);
+		Timing::Timer timer;
+		for(Uptr batchIndex = 0; batchIndex < numBatches; ++batchIndex)
+		{
+			GCPointer<Compartment> compartment = createCompartment();
+			for(Uptr memoryIndex = 0; memoryIndex < numMemoriesPerBatch; ++memoryIndex)
+			{ errorUnless(createMemory(compartment, memoryType)); }
+
+			compartment = nullptr;
+			collectGarbage();
+		}
+		Log::setCategoryEnabled(Log::metrics, true);
+
+		const std::string description = "Created and freed memories ("
+										+ std::to_string(maxPooledReservations)
+										+ " pooled reservations)";
+		Timing::logRatePerSecond(
+			description.c_str(), timer, F64(numBatches * numMemoriesPerBatch), "memories");
+
+		const MemoryReservationPoolStats poolStats = getMemoryReservationPoolStats();
+		Log::printf(Log::metrics,
+					"Memory reservations: %" PRIuPTR " allocated, %" PRIuPTR " reused, %" PRIuPTR
+					" freed\n",
+					poolStats.numAllocatedReservations,
+					poolStats.numReusedReservations,
+					poolStats.numFreedReservations);
+	}
+
+	return true;
+}
+
+//
+// memory-access: measures the throughput of random accesses to a large memory from WebAssembly
+// code, with each combination of using huge pages and prefaulting the memory's pages. The first
+// kernel writes to every page it accesses for the first time, so it includes the page faults that
+// prefaulting avoids. The second kernel only reads pages that are already committed, so it mostly
+// measures TLB misses.
+//
+
+static const char memoryAccessModuleWAST[]
+	= "(module\n"
+	  "  (memory 1)\n"
+	  "  (func $random (param $state i32) (result i32)\n"
+	  "    (local $x i32)\n"
+	  "    (set_local $x (i32.shl (get_local $state) (i32.const 13)))\n"
+	  "    (set_local $x (i32.xor (get_local $state) (get_local $x)))\n"
+	  "    (set_local $x (i32.xor (get_local $x) (i32.shr_u (get_local $x) (i32.const 17))))\n"
+	  "    (i32.xor (get_local $x) (i32.shl (get_local $x) (i32.const 5)))\n"
+	  "  )\n"
+	  "  (func (export \"randomIncrement\") (param $numAccesses i32) (param $addressMask i32)\n"
+	  "    (local $state i32) (local $address i32)\n"
+	  "    (set_local $state (i32.const 1))\n"
+	  "    (block $done\n"
+	  "      (loop $loop\n"
+	  "        (br_if $done (i32.eqz (get_local $numAccesses)))\n"
+	  "        (set_local $state (call $random (get_local $state)))\n"
+	  "        (set_local $address (i32.and (get_local $state) (get_local $addressMask)))\n"
+	  "        (i32.store (get_local $address)\n"
+	  "          (i32.add (i32.load (get_local $address)) (i32.const 1)))\n"
+	  "        (set_local $numAccesses (i32.sub (get_local $numAccesses) (i32.const 1)))\n"
+	  "        (br $loop)\n"
+	  "      )\n"
+	  "    )\n"
+	  "  )\n"
+	  "  (func (export \"randomSum\") (param $numAccesses i32) (param $addressMask i32)\n"
+	  "    (result i32)\n"
+	  "    (local $state i32) (local $sum i32)\n"
+	  "    (set_local $state (i32.const 1))\n"
+	  "    (block $done\n"
+	  "      (loop $loop\n"
+	  "        (br_if $done (i32.eqz (get_local $numAccesses)))\n"
+	  "        (set_local $state (call $random (get_local $state)))\n"
+	  "        (set_local $sum (i32.add (get_local $sum)\n"
+	  "          (i32.load (i32.and (get_local $state) (get_local $addressMask)))))\n"
+	  "        (set_local $numAccesses (i32.sub (get_local $numAccesses) (i32.const 1)))\n"
+	  "        (br $loop)\n"
+	  "      )\n"
+	  "    )\n"
+	  "    (get_local $sum)\n"
+	  "  )\n"
+	  ")\n";
+
+static bool runMemoryAccessBenchmark(int argc, char** argv)
+{
+	if(argc > 3) { return false; }
+	const Uptr numMemoryBytes = (argc > 1 ? Uptr(atol(argv[1])) : 1024) << 20;
+	const Uptr numAccesses    = argc > 2 ? Uptr(atol(argv[2])) : 50000000;
+	if(!numMemoryBytes || (numMemoryBytes & (numMemoryBytes - 1))
+	   || numMemoryBytes > Uptr(1) << 31 || !numAccesses || numAccesses > INT32_MAX)
+	{ return false; }
+	const Uptr numMemoryPages = numMemoryBytes >> IR::numBytesPerPageLog2;
+	const I32 addressMask     = I32(numMemoryBytes - 1) & ~3;
+
+	Module module;
+	errorUnless(loadTextModule("memory-access", memoryAccessModuleWAST, module));
+
+	for(bool useHugePages : {false, true})
+	{
+		for(bool prefault : {false, true})
+		{
+			MemoryCommitPolicy policy;
+			policy.useHugePages = useHugePages;
+			policy.prefault     = prefault;
+
+			GCPointer<Compartment> compartment = createCompartment();
+			setMemoryCommitPolicy(compartment, policy);
+			ModuleInstance* moduleInstance
+				= instantiateModule(compartment, module, ImportBindings{}, "memory-access");
+			errorUnless(moduleInstance);
+			Context* context = createContext(compartment);
+
+			FunctionInstance* randomIncrement
+				= asFunctionNullable(getInstanceExport(moduleInstance, "randomIncrement"));
+			FunctionInstance* randomSum
+				= asFunctionNullable(getInstanceExport(moduleInstance, "randomSum"));
+			errorUnless(randomIncrement && randomSum);
+
+			const std::string description
+				= std::string(useHugePages ? "huge pages" : "no huge pages")
+				  + (prefault ? ", prefaulted" : ", not prefaulted");
+
+			Timing::Timer growTimer;
+			MemoryInstance* memory = getDefaultMemory(moduleInstance);
+			errorUnless(growMemory(memory, numMemoryPages - getMemoryNumPages(memory)) != -1);
+			Timing::logTimer(("Grew memory (" + description + ")").c_str(), growTimer);
+
+			Timing::Timer incrementTimer;
+			invokeFunctionChecked(
+				context, randomIncrement, {I32(numAccesses), I32(addressMask)});
+			Timing::logRatePerSecond(("Random increments (" + description + ")").c_str(),
+									 incrementTimer,
+									 F64(numAccesses),
+									 "accesses");
+
+			Timing::Timer sumTimer;
+			invokeFunctionChecked(context, randomSum, {I32(numAccesses), I32(addressMask)});
+			Timing::logRatePerSecond(("Random loads (" + description + ")").c_str(),
+									 sumTimer,
+									 F64(numAccesses),
+									 "accesses");
+
+			compartment = nullptr;
+			collectGarbage();
+		}
+	}
+
+	return true;
+}
+
+//
+// The subcommand table.
+//
+
+struct Subcommand
+{
+	const char* name;
+	const char* argumentsHelp;
+	bool (*run)(int argc, char** argv);
+};
+
+static const Subcommand subcommands[] = {
+	{"invoke", "[num invokes per thread] [max threads]", runInvokeBenchmark},
+	{"instantiate", "[num instances]", runInstantiateBenchmark},
+	{"trap", "[num traps per thread] [max threads]", runTrapBenchmark},
+	{"memory", "[num memories]", runMemoryBenchmark},
+	{"memory-access", "[memory MB (power of 2)] [num accesses]", runMemoryAccessBenchmark},
+};
+
+static void showHelp()
+{
+	std::cerr << "Usage:" << std::endl;
+	for(const Subcommand& subcommand : subcommands)
+	{
+		std::cerr << "  Benchmark " << subcommand.name << " " << subcommand.argumentsHelp
+				  << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 2)
+	{
+		showHelp();
+		return EXIT_FAILURE;
+	}
+
+	for(const Subcommand& subcommand : subcommands)
+	{
+		if(!strcmp(argv[1], subcommand.name))
+		{
+			Log::setCategoryEnabled(Log::metrics, true);
+
+			// Pass the subcommand its arguments with the subcommand name as argv[0].
+			if(!subcommand.run(argc - 1, argv + 1))
+			{
+				showHelp();
+				return EXIT_FAILURE;
+			}
+			return EXIT_SUCCESS;
+		}
+	}
+
+	std::cerr << "Unrecognized subcommand: " << argv[1] << std::endl;
+	showHelp();
+	return EXIT_FAILURE;
+}
@@ -15,6 +15,9 @@
 #include <iostream>
 #include <sstream>
 
+// The file extension of precompiled module files written by the Compile program.
+static const char precompiledModuleExtension[] = ".wavmp";
+
 inline std::string loadFile(const char* filename)
 {
 	Timing::Timer timer;
@@ -158,4 +161,29 @@ inline bool endsWith(const char* str, const char* suffix)
 	Uptr lensuffix = strlen(suffix);
 	if(lenstr < lensuffix) { return false; }
 	return (strncmp(str + lenstr - lensuffix, suffix, lensuffix) == 0);
-}
\ No newline at end of file
+}
+
+// Parses the argument of a --opt-level option: none, basic, or full. Returns false if the
+// argument is missing or isn't one of those names.
+inline bool parseOptimizationLevel(const char* levelName,
+								   Runtime::OptimizationLevel& outOptimizationLevel)
+{
+	if(!levelName) { return false; }
+	else if(!strcmp(levelName, "none"))
+	{
+		outOptimizationLevel = Runtime::OptimizationLevel::none;
+	}
+	else if(!strcmp(levelName, "basic"))
+	{
+		outOptimizationLevel = Runtime::OptimizationLevel::basic;
+	}
+	else if(!strcmp(levelName, "full"))
+	{
+		outOptimizationLevel = Runtime::OptimizationLevel::full;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,105 @@
+#include "CLI.h"
+#include "Emscripten/Emscripten.h"
+#include "IR/Module.h"
+#include "Inline/BasicTypes.h"
+#include "Runtime/Linker.h"
+#include "Runtime/Runtime.h"
+#include "RootResolver.h"
+#include "ThreadTest/ThreadTest.h"
+
+using namespace IR;
+using namespace Runtime;
+
+static void showHelp()
+{
+	std::cerr << "Usage: Compile in.wast|in.wasm out.wavmp [switches]" << std::endl;
+	std::cerr << "  --disable-emscripten\t\tDisable Emscripten intrinsics" << std::endl;
+	std::cerr << "  --enable-thread-test\t\tEnable ThreadTest intrinsics" << std::endl;
+	std::cerr << "  --opt-level none|basic|full\tSet how much the program's code is optimized"
+			  << std::endl;
+	std::cerr << "The precompiled module may be run by wavm on hosts with the same CPU, with the "
+				 "same intrinsics enabled."
+			  << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 3)
+	{
+		showHelp();
+		return EXIT_FAILURE;
+	}
+	const char* inputFilename           = argv[1];
+	const char* outputFilename          = argv[2];
+	bool enableEmscripten               = true;
+	bool enableThreadTest               = false;
+	OptimizationLevel optimizationLevel = OptimizationLevel::basic;
+	for(int argIndex = 3; argIndex < argc; ++argIndex)
+	{
+		if(!strcmp(argv[argIndex], "--disable-emscripten")) { enableEmscripten = false; }
+		else if(!strcmp(argv[argIndex], "--enable-thread-test"))
+		{
+			enableThreadTest = true;
+		}
+		else if(!strcmp(argv[argIndex], "--opt-level") && argIndex + 1 < argc)
+		{
+			if(!parseOptimizationLevel(argv[++argIndex], optimizationLevel))
+			{
+				showHelp();
+				return EXIT_FAILURE;
+			}
+		}
+		else
+		{
+			std::cerr << "Unrecognized argument: " << argv[argIndex] << std::endl;
+			showHelp();
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Load the module with the same features that wavm enables.
+	Module module;
+	module.featureSpec.importExportMutableGlobals          = true;
+	module.featureSpec.sharedTables                        = true;
+	module.featureSpec.requireSharedFlagForAtomicOperators = false;
+	if(!loadModule(inputFilename, module)) { return EXIT_FAILURE; }
+
+	// The object code depends on the calling conventions of the functions the module's imports are
+	// bound to, so link the module with the same intrinsic modules that wavm will.
+	Compartment* compartment = Runtime::createCompartment();
+	RootResolver rootResolver(compartment);
+	if(enableEmscripten)
+	{
+		Emscripten::Instance* emscriptenInstance = Emscripten::instantiate(compartment, module);
+		if(emscriptenInstance)
+		{
+			rootResolver.moduleNameToInstanceMap.set("env", emscriptenInstance->env);
+			rootResolver.moduleNameToInstanceMap.set("asm2wasm", emscriptenInstance->asm2wasm);
+			rootResolver.moduleNameToInstanceMap.set("global", emscriptenInstance->global);
+		}
+	}
+	if(enableThreadTest)
+	{
+		ModuleInstance* threadTestInstance = ThreadTest::instantiate(compartment);
+		rootResolver.moduleNameToInstanceMap.set("threadTest", threadTestInstance);
+	}
+
+	LinkResult linkResult = linkModule(module, rootResolver);
+	if(!linkResult.success)
+	{
+		std::cerr << "Failed to link module" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// Compile the module by instantiating it, without running any of its code, and write the
+	// compiled object code to the output file.
+	ModuleInstance* moduleInstance = instantiateModule(compartment,
+													   module,
+													   std::move(linkResult.resolvedImports),
+													   inputFilename,
+													   optimizationLevel);
+	if(!moduleInstance) { return EXIT_FAILURE; }
+	if(!savePrecompiledModule(moduleInstance, module, outputFilename)) { return EXIT_FAILURE; }
+
+	return EXIT_SUCCESS;
+}
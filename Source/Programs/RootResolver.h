@@ -0,0 +1,107 @@
+#pragma once
+
+#include "IR/Module.h"
+#include "IR/Operators.h"
+#include "IR/Validate.h"
+#include "Inline/BasicTypes.h"
+#include "Inline/HashMap.h"
+#include "Inline/Serialization.h"
+#include "Logging/Logging.h"
+#include "Runtime/Linker.h"
+#include "Runtime/Runtime.h"
+
+// Resolves imports from a set of named module instances, and generates stubs for imports that
+// can't be resolved.
+struct RootResolver : Runtime::Resolver
+{
+	Runtime::Compartment* compartment;
+	HashMap<std::string, Runtime::ModuleInstance*> moduleNameToInstanceMap;
+
+	RootResolver(Runtime::Compartment* inCompartment) : compartment(inCompartment) {}
+
+	bool resolve(const std::string& moduleName,
+				 const std::string& exportName,
+				 IR::ObjectType type,
+				 Runtime::Object*& outObject) override
+	{
+		auto namedInstance = moduleNameToInstanceMap.get(moduleName);
+		if(namedInstance)
+		{
+			outObject = Runtime::getInstanceExport(*namedInstance, exportName);
+			if(outObject)
+			{
+				if(Runtime::isA(outObject, type)) { return true; }
+				else
+				{
+					Log::printf(Log::error,
+								"Resolved import %s.%s to a %s, but was expecting %s\n",
+								moduleName.c_str(),
+								exportName.c_str(),
+								asString(Runtime::getObjectType(outObject)).c_str(),
+								asString(type).c_str());
+					return false;
+				}
+			}
+		}
+
+		Log::printf(Log::error,
+					"Generated stub for missing import %s.%s : %s\n",
+					moduleName.c_str(),
+					exportName.c_str(),
+					asString(type).c_str());
+		outObject = getStubObject(exportName, type);
+		return true;
+	}
+
+	Runtime::Object* getStubObject(const std::string& exportName, IR::ObjectType type) const
+	{
+		// If the import couldn't be resolved, stub it in.
+		switch(type.kind)
+		{
+		case IR::ObjectKind::function:
+		{
+			// Generate a function body that just uses the unreachable op to fault if called.
+			Serialization::ArrayOutputStream codeStream;
+			IR::OperatorEncoderStream encoder(codeStream);
+			encoder.unreachable();
+			encoder.end();
+
+			// Generate a module for the stub function.
+			IR::Module stubModule;
+			IR::DisassemblyNames stubModuleNames;
+			stubModule.types.push_back(asFunctionType(type));
+			stubModule.functions.defs.push_back({{0}, {}, std::move(codeStream.getBytes()), {}});
+			stubModule.exports.push_back({"importStub", IR::ObjectKind::function, 0});
+			stubModuleNames.functions.push_back({"importStub: " + exportName, {}, {}});
+			IR::setDisassemblyNames(stubModule, stubModuleNames);
+			IR::validateDefinitions(stubModule);
+
+			// Instantiate the module and return the stub function instance.
+			auto stubModuleInstance
+				= Runtime::instantiateModule(compartment, stubModule, {}, "importStub");
+			return Runtime::getInstanceExport(stubModuleInstance, "importStub");
+		}
+		case IR::ObjectKind::memory:
+		{
+			return Runtime::asObject(Runtime::createMemory(compartment, asMemoryType(type)));
+		}
+		case IR::ObjectKind::table:
+		{
+			return Runtime::asObject(Runtime::createTable(compartment, asTableType(type)));
+		}
+		case IR::ObjectKind::global:
+		{
+			return Runtime::asObject(Runtime::createGlobal(
+				compartment,
+				asGlobalType(type),
+				IR::Value(asGlobalType(type).valueType, IR::UntaggedValue())));
+		}
+		case IR::ObjectKind::exceptionType:
+		{
+			return Runtime::asObject(
+				Runtime::createExceptionTypeInstance(asExceptionType(type), "importStub"));
+		}
+		default: Errors::unreachable();
+		};
+	}
+};
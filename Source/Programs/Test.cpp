@@ -25,6 +25,7 @@ DEFINE_INTRINSIC_MODULE(spectest);
 struct TestScriptState
 {
 	bool hasInstantiatedModule;
+	OptimizationLevel optimizationLevel;
 	GCPointer<ModuleInstance> lastModuleInstance;
 	GCPointer<Compartment> compartment;
 	GCPointer<Context> context;
@@ -36,6 +37,7 @@ struct TestScriptState
 
 	TestScriptState()
 	: hasInstantiatedModule(false)
+	, optimizationLevel(OptimizationLevel::basic)
 	, compartment(Runtime::createCompartment())
 	, context(Runtime::createContext(compartment))
 	{
@@ -163,7 +165,8 @@ static bool processAction(TestScriptState& state, Action* action, IR::ValueTuple
 			state.lastModuleInstance    = instantiateModule(state.compartment,
                                                          *moduleAction->module,
                                                          std::move(linkResult.resolvedImports),
-                                                         "test module");
+                                                         "test module",
+                                                         state.optimizationLevel);
 
 			// Call the module start function, if it has one.
 			FunctionInstance* startFunction = getStartFunction(state.lastModuleInstance);
@@ -477,7 +480,8 @@ static void processCommand(TestScriptState& state, const Command* command)
 								= instantiateModule(state.compartment,
 													*assertCommand->moduleAction->module,
 													std::move(linkResult.resolvedImports),
-													"test module");
+													"test module",
+													state.optimizationLevel);
 
 							// Call the module start function, if it has one.
 							FunctionInstance* startFunction = getStartFunction(moduleInstance);
@@ -549,9 +553,39 @@ DEFINE_INTRINSIC_MEMORY(spectest,
 
 int main(int argc, char** argv)
 {
-	if(argc != 2)
+	OptimizationLevel optimizationLevel = OptimizationLevel::basic;
+	bool expectTierUp                   = false;
+	bool isValidCommandLine             = argc >= 2;
+	for(int argIndex = 2; isValidCommandLine && argIndex < argc; ++argIndex)
 	{
-		std::cerr << "Usage: Test in.wast" << std::endl;
+		if(!strcmp(argv[argIndex], "--object-cache") && argIndex + 1 < argc)
+		{ Runtime::setObjectCacheDirectory(argv[++argIndex], 0); }
+		else if(!strcmp(argv[argIndex], "--tiered"))
+		{
+			Runtime::setTieredCompilation(true);
+		}
+		else if(!strcmp(argv[argIndex], "--lazy"))
+		{
+			Runtime::setLazyCompilation(true);
+		}
+		else if(!strcmp(argv[argIndex], "--expect-tier-up"))
+		{
+			expectTierUp = true;
+		}
+		else if(!strcmp(argv[argIndex], "--opt-level") && argIndex + 1 < argc)
+		{
+			isValidCommandLine = parseOptimizationLevel(argv[++argIndex], optimizationLevel);
+		}
+		else
+		{
+			isValidCommandLine = false;
+		}
+	}
+	if(!isValidCommandLine)
+	{
+		std::cerr << "Usage: Test in.wast [--object-cache dir] [--tiered] [--lazy] "
+					 "[--expect-tier-up] [--opt-level none|basic|full]"
+				  << std::endl;
 		return EXIT_FAILURE;
 	}
 	const char* filename = argv[1];
@@ -569,7 +603,8 @@ int main(int argc, char** argv)
 	if(!testScriptString.size()) { return EXIT_FAILURE; }
 
 	// Process the test script.
-	TestScriptState* testScriptState = new TestScriptState();
+	TestScriptState* testScriptState   = new TestScriptState();
+	testScriptState->optimizationLevel = optimizationLevel;
 	std::vector<std::unique_ptr<Command>> testCommands;
 
 	// Parse the test script.
@@ -602,6 +637,19 @@ int main(int argc, char** argv)
 		exitCode = EXIT_FAILURE;
 	}
 
+	// Check that tiered compilation recompiled some functions at the optimized tier while the test
+	// script ran.
+	if(expectTierUp)
+	{
+		Runtime::waitForTierUp();
+		if(!Runtime::getNumTieredUpFunctions())
+		{
+			std::cerr << filename << ": no functions were recompiled at the optimized tier"
+					  << std::endl;
+			exitCode = EXIT_FAILURE;
+		}
+	}
+
 	delete testScriptState;
 	testCommands.clear();
 	collectGarbage();
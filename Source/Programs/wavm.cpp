@@ -9,132 +9,59 @@
 #include "Runtime/Intrinsics.h"
 #include "Runtime/Linker.h"
 #include "Runtime/Runtime.h"
+#include "RootResolver.h"
 #include "ThreadTest/ThreadTest.h"
 #include "WAST/WAST.h"
 
+#include <inttypes.h>
+
 using namespace IR;
 using namespace Runtime;
 
-struct RootResolver : Resolver
-{
-	Compartment* compartment;
-	HashMap<std::string, ModuleInstance*> moduleNameToInstanceMap;
-
-	RootResolver(Compartment* inCompartment) : compartment(inCompartment) {}
-
-	bool resolve(const std::string& moduleName,
-				 const std::string& exportName,
-				 ObjectType type,
-				 Object*& outObject) override
-	{
-		auto namedInstance = moduleNameToInstanceMap.get(moduleName);
-		if(namedInstance)
-		{
-			outObject = getInstanceExport(*namedInstance, exportName);
-			if(outObject)
-			{
-				if(isA(outObject, type)) { return true; }
-				else
-				{
-					Log::printf(Log::error,
-								"Resolved import %s.%s to a %s, but was expecting %s\n",
-								moduleName.c_str(),
-								exportName.c_str(),
-								asString(getObjectType(outObject)).c_str(),
-								asString(type).c_str());
-					return false;
-				}
-			}
-		}
-
-		Log::printf(Log::error,
-					"Generated stub for missing import %s.%s : %s\n",
-					moduleName.c_str(),
-					exportName.c_str(),
-					asString(type).c_str());
-		outObject = getStubObject(exportName, type);
-		return true;
-	}
-
-	Object* getStubObject(const std::string& exportName, ObjectType type) const
-	{
-		// If the import couldn't be resolved, stub it in.
-		switch(type.kind)
-		{
-		case IR::ObjectKind::function:
-		{
-			// Generate a function body that just uses the unreachable op to fault if called.
-			Serialization::ArrayOutputStream codeStream;
-			OperatorEncoderStream encoder(codeStream);
-			encoder.unreachable();
-			encoder.end();
-
-			// Generate a module for the stub function.
-			Module stubModule;
-			DisassemblyNames stubModuleNames;
-			stubModule.types.push_back(asFunctionType(type));
-			stubModule.functions.defs.push_back({{0}, {}, std::move(codeStream.getBytes()), {}});
-			stubModule.exports.push_back({"importStub", IR::ObjectKind::function, 0});
-			stubModuleNames.functions.push_back({"importStub: " + exportName, {}, {}});
-			IR::setDisassemblyNames(stubModule, stubModuleNames);
-			IR::validateDefinitions(stubModule);
-
-			// Instantiate the module and return the stub function instance.
-			auto stubModuleInstance = instantiateModule(compartment, stubModule, {}, "importStub");
-			return getInstanceExport(stubModuleInstance, "importStub");
-		}
-		case IR::ObjectKind::memory:
-		{
-			return asObject(Runtime::createMemory(compartment, asMemoryType(type)));
-		}
-		case IR::ObjectKind::table:
-		{
-			return asObject(Runtime::createTable(compartment, asTableType(type)));
-		}
-		case IR::ObjectKind::global:
-		{
-			return asObject(Runtime::createGlobal(
-				compartment,
-				asGlobalType(type),
-				IR::Value(asGlobalType(type).valueType, IR::UntaggedValue())));
-		}
-		case IR::ObjectKind::exceptionType:
-		{
-			return asObject(
-				Runtime::createExceptionTypeInstance(asExceptionType(type), "importStub"));
-		}
-		default: Errors::unreachable();
-		};
-	}
-};
+// The maximum size of the object cache enabled by --object-cache.
+static constexpr U64 objectCacheMaxBytes = U64(1024) * 1024 * 1024;
 
 struct CommandLineOptions
 {
-	const char* filename     = nullptr;
-	const char* functionName = nullptr;
-	char** args              = nullptr;
-	bool onlyCheck           = false;
-	bool enableEmscripten    = true;
-	bool enableThreadTest    = false;
+	const char* filename                = nullptr;
+	const char* functionName            = nullptr;
+	char** args                         = nullptr;
+	bool onlyCheck                      = false;
+	bool enableEmscripten               = true;
+	bool enableThreadTest               = false;
+	OptimizationLevel optimizationLevel = OptimizationLevel::basic;
+	MemoryCommitPolicy memoryCommitPolicy;
 };
 
 static int run(const CommandLineOptions& options)
 {
-	Module module;
+	Module loadedModule;
 
 	// Enable some additional "features" in WAVM that are disabled by default.
-	module.featureSpec.importExportMutableGlobals = true;
-	module.featureSpec.sharedTables               = true;
+	loadedModule.featureSpec.importExportMutableGlobals = true;
+	loadedModule.featureSpec.sharedTables               = true;
 	// Allow atomics on unshared memories to accomodate atomics on the Emscripten memory.
-	module.featureSpec.requireSharedFlagForAtomicOperators = false;
+	loadedModule.featureSpec.requireSharedFlagForAtomicOperators = false;
 
-	// Load the module.
-	if(!loadModule(options.filename, module)) { return EXIT_FAILURE; }
+	// Load the module, or the precompiled module and the module it was compiled from.
+	PrecompiledModule* precompiledModule = nullptr;
+	if(endsWith(options.filename, precompiledModuleExtension))
+	{
+		precompiledModule = loadPrecompiledModule(options.filename);
+		if(!precompiledModule) { return EXIT_FAILURE; }
+	}
+	else if(!loadModule(options.filename, loadedModule))
+	{
+		return EXIT_FAILURE;
+	}
+	const Module& module
+		= precompiledModule ? getPrecompiledModuleIR(precompiledModule) : loadedModule;
 	if(options.onlyCheck) { return EXIT_SUCCESS; }
 
 	// Link the module with the intrinsic modules.
 	Compartment* compartment = Runtime::createCompartment();
 	Context* context         = Runtime::createContext(compartment);
+	Runtime::setMemoryCommitPolicy(compartment, options.memoryCommitPolicy);
 	RootResolver rootResolver(compartment);
 
 	Emscripten::Instance* emscriptenInstance = nullptr;
@@ -169,8 +96,17 @@ static int run(const CommandLineOptions& options)
 	}
 
 	// Instantiate the module.
-	ModuleInstance* moduleInstance = instantiateModule(
-		compartment, module, std::move(linkResult.resolvedImports), options.filename);
+	ModuleInstance* moduleInstance
+		= precompiledModule
+			  ? instantiatePrecompiledModule(compartment,
+											 precompiledModule,
+											 std::move(linkResult.resolvedImports),
+											 options.filename)
+			  : instantiateModule(compartment,
+								  module,
+								  std::move(linkResult.resolvedImports),
+								  options.filename,
+								  options.optimizationLevel);
 	if(!moduleInstance) { return EXIT_FAILURE; }
 
 	// Call the module start function, if it has one.
@@ -258,6 +194,16 @@ static int run(const CommandLineOptions& options)
 	IR::ValueTuple functionResults = invokeFunctionChecked(context, functionInstance, invokeArgs);
 	Timing::logTimer("Invoked function", executionTimer);
 
+	const JITMemoryStats jitMemoryStats = getJITMemoryStats();
+	Log::printf(Log::metrics,
+				"JIT memory: %" PRIuPTR " KB committed in %" PRIuPTR " regions, %" PRIuPTR
+				" KB code, %" PRIuPTR " KB data in %" PRIuPTR " objects\n",
+				jitMemoryStats.numCommittedBytes / 1024,
+				jitMemoryStats.numRegions,
+				jitMemoryStats.numCodeBytes / 1024,
+				(jitMemoryStats.numReadOnlyBytes + jitMemoryStats.numReadWriteBytes) / 1024,
+				jitMemoryStats.numReservations);
+
 	if(options.functionName)
 	{
 		Log::printf(Log::debug,
@@ -279,13 +225,32 @@ static int run(const CommandLineOptions& options)
 void showHelp()
 {
 	std::cerr << "Usage: wavm [switches] [programfile] [--] [arguments]" << std::endl;
-	std::cerr << "  in.wast|in.wasm\t\tSpecify program file (.wast/.wasm)" << std::endl;
+	std::cerr << "  in.wast|in.wasm|in.wavmp\tSpecify program file (.wast/.wasm/.wavmp)"
+			  << std::endl;
 	std::cerr << "  -f|--function name\t\tSpecify function name to run in module rather than main"
 			  << std::endl;
 	std::cerr << "  -c|--check\t\t\tExit after checking that the program is valid" << std::endl;
 	std::cerr << "  -d|--debug\t\t\tWrite additional debug information to stdout" << std::endl;
 	std::cerr << "  --disable-emscripten\t\tDisable Emscripten intrinsics" << std::endl;
 	std::cerr << "  --enable-thread-test\t\tEnable ThreadTest intrinsics" << std::endl;
+	std::cerr << "  --object-cache dir\t\tCache compiled object code in a directory" << std::endl;
+	std::cerr << "  --tiered\t\t\tCompile quickly, and optimize hot functions in the background"
+			  << std::endl;
+	std::cerr << "  --lazy\t\t\tCompile each function the first time it is called" << std::endl;
+	std::cerr << "  --no-debug-info\t\tDon't emit debug info for compiled code" << std::endl;
+	std::cerr << "  --relaxed-memory-traps\tOptimize memory accesses that may trap out of order"
+			  << std::endl;
+	std::cerr << "  --perf-map\t\t\tWrite /tmp/perf-<pid>.map for the perf profiler" << std::endl;
+	std::cerr << "  --gdb-jit[=on|off]\t\tRegister compiled code with GDB (default: debug builds)"
+			  << std::endl;
+	std::cerr << "  --opt-level none|basic|full\tSet how much the program's code is optimized"
+			  << std::endl;
+	std::cerr << "  --huge-pages\t\t\tBack the program's memory with huge pages if possible"
+			  << std::endl;
+	std::cerr << "  --prefault-memory\t\tCommit physical memory when the program's memory grows"
+			  << std::endl;
+	std::cerr << "  --lock-memory\t\t\tLock the program's memory in physical memory" << std::endl;
+	std::cerr << "  --metrics\t\t\tWrite compile and run time metrics to stdout" << std::endl;
 	std::cerr << "  --\t\t\t\tStop parsing arguments" << std::endl;
 }
 
@@ -320,6 +285,67 @@ int main(int argc, char** argv)
 		{
 			options.enableThreadTest = true;
 		}
+		else if(!strcmp(*options.args, "--object-cache"))
+		{
+			if(!*++options.args)
+			{
+				showHelp();
+				return EXIT_FAILURE;
+			}
+			Runtime::setObjectCacheDirectory(*options.args, objectCacheMaxBytes);
+		}
+		else if(!strcmp(*options.args, "--tiered"))
+		{
+			Runtime::setTieredCompilation(true);
+		}
+		else if(!strcmp(*options.args, "--lazy"))
+		{
+			Runtime::setLazyCompilation(true);
+		}
+		else if(!strcmp(*options.args, "--no-debug-info"))
+		{
+			Runtime::setDebugInfo(false);
+		}
+		else if(!strcmp(*options.args, "--relaxed-memory-traps"))
+		{
+			Runtime::setRelaxedMemoryTraps(true);
+		}
+		else if(!strcmp(*options.args, "--perf-map"))
+		{
+			Runtime::setPerfMapEnabled(true);
+		}
+		else if(!strcmp(*options.args, "--gdb-jit") || !strcmp(*options.args, "--gdb-jit=on"))
+		{
+			Runtime::setGDBRegistration(true);
+		}
+		else if(!strcmp(*options.args, "--gdb-jit=off"))
+		{
+			Runtime::setGDBRegistration(false);
+		}
+		else if(!strcmp(*options.args, "--huge-pages"))
+		{
+			options.memoryCommitPolicy.useHugePages = true;
+		}
+		else if(!strcmp(*options.args, "--prefault-memory"))
+		{
+			options.memoryCommitPolicy.prefault = true;
+		}
+		else if(!strcmp(*options.args, "--lock-memory"))
+		{
+			options.memoryCommitPolicy.lock = true;
+		}
+		else if(!strcmp(*options.args, "--opt-level"))
+		{
+			if(!parseOptimizationLevel(*++options.args, options.optimizationLevel))
+			{
+				showHelp();
+				return EXIT_FAILURE;
+			}
+		}
+		else if(!strcmp(*options.args, "--metrics"))
+		{
+			Log::setCategoryEnabled(Log::metrics, true);
+		}
 		else if(!strcmp(*options.args, "--"))
 		{
 			++options.args;
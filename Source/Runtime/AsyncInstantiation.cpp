@@ -0,0 +1,401 @@
+#include "IR/Module.h"
+#include "Inline/Assert.h"
+#include "Inline/BasicTypes.h"
+#include "Inline/Lock.h"
+#include "Inline/Timing.h"
+#include "Platform/Platform.h"
+#include "Runtime.h"
+#include "RuntimePrivate.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+using namespace IR;
+using namespace Runtime;
+
+// LLVM uses a lot of stack for deeply nested code, so give instantiation threads the same generous
+// stack as compile threads. Events may be signaled while no thread is waiting for them, so waiters
+// poll the state they are waiting for as well.
+enum
+{
+	instantiationThreadNumStackBytes = 8 * 1024 * 1024,
+	pollMicroseconds                 = 10000
+};
+
+enum class InstantiationState
+{
+	queued,
+	running,
+	complete,
+	failed,
+	cancelled
+};
+
+// The state of an asynchronous instantiation, shared between its handle and the background thread
+// that instantiates it.
+struct InstantiationJob
+{
+	Compartment* compartment;
+	IR::Module module;
+	ImportBindings imports;
+	std::string debugName;
+	OptimizationLevel optimizationLevel;
+	std::function<void(ModuleInstance*)> onComplete;
+	Uptr numCodeBytes;
+
+	// The compartment and imported objects, which are rooted until the job finishes.
+	std::vector<Object*> rootedObjects;
+
+	// Guarded by instantiationMutex.
+	InstantiationState state;
+	ModuleInstance* moduleInstance;
+	Exception exception;
+
+	// Signaled when the job leaves the queued or running state. Waiters poll the state as well, in
+	// case the event is signaled between checking the state and waiting.
+	Platform::Event completionEvent;
+
+	InstantiationJob(Compartment* inCompartment,
+					 const IR::Module& inModule,
+					 ImportBindings&& inImports,
+					 std::string&& inDebugName,
+					 OptimizationLevel inOptimizationLevel,
+					 std::function<void(ModuleInstance*)>&& inOnComplete)
+	: compartment(inCompartment)
+	, module(inModule)
+	, imports(std::move(inImports))
+	, debugName(std::move(inDebugName))
+	, optimizationLevel(inOptimizationLevel)
+	, onComplete(std::move(inOnComplete))
+	, numCodeBytes(0)
+	, state(InstantiationState::queued)
+	, moduleInstance(nullptr)
+	{
+		for(const FunctionDef& functionDef : module.functions.defs)
+		{ numCodeBytes += functionDef.code.size(); }
+
+		rootedObjects.push_back(compartment);
+		rootedObjects.insert(
+			rootedObjects.end(), imports.functions.begin(), imports.functions.end());
+		rootedObjects.insert(rootedObjects.end(), imports.tables.begin(), imports.tables.end());
+		rootedObjects.insert(rootedObjects.end(), imports.memories.begin(), imports.memories.end());
+		rootedObjects.insert(rootedObjects.end(), imports.globals.begin(), imports.globals.end());
+		rootedObjects.insert(
+			rootedObjects.end(), imports.exceptionTypes.begin(), imports.exceptionTypes.end());
+		for(Object* object : rootedObjects) { addGCRoot(object); }
+	}
+};
+
+struct Runtime::AsyncInstantiation
+{
+	std::shared_ptr<InstantiationJob> job;
+};
+
+// Guards the instantiation queue, the pool of instantiation threads, and the state of all
+// instantiation jobs.
+static Platform::Mutex instantiationMutex;
+static std::vector<std::shared_ptr<InstantiationJob>> queuedInstantiationJobs;
+static std::vector<Platform::Thread*> instantiationThreads;
+static Uptr numBusyInstantiationThreads        = 0;
+static Uptr numRunningCodeBytes                = 0;
+static bool isShuttingDownInstantiationThreads = false;
+
+// Signaled to wake idle instantiation threads when there are queued jobs they may be able to run.
+static Platform::Event instantiationWakeEvent;
+
+static std::atomic<Uptr> maxInstantiationThreads(1);
+static std::atomic<Uptr> maxCompileCodeBytes(0);
+
+// Removes the first queued job that fits in the compile memory budget from the queue. Returns null
+// if there isn't one. The caller must hold instantiationMutex.
+static std::shared_ptr<InstantiationJob> dequeueInstantiationJob()
+{
+	const Uptr maxCodeBytes = maxCompileCodeBytes;
+	for(auto it = queuedInstantiationJobs.begin(); it != queuedInstantiationJobs.end(); ++it)
+	{
+		std::shared_ptr<InstantiationJob> job = *it;
+		if(!maxCodeBytes || !numRunningCodeBytes
+		   || numRunningCodeBytes + job->numCodeBytes <= maxCodeBytes)
+		{
+			queuedInstantiationJobs.erase(it);
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+// Returns the number of queued jobs that could be started now without exceeding the compile
+// memory budget. The caller must hold instantiationMutex.
+static Uptr getNumStartableInstantiationJobs()
+{
+	const Uptr maxCodeBytes = maxCompileCodeBytes;
+	Uptr numCodeBytes       = numRunningCodeBytes;
+	Uptr numStartableJobs   = 0;
+	for(const std::shared_ptr<InstantiationJob>& job : queuedInstantiationJobs)
+	{
+		if(!maxCodeBytes || !numCodeBytes || numCodeBytes + job->numCodeBytes <= maxCodeBytes)
+		{
+			numCodeBytes += job->numCodeBytes;
+			++numStartableJobs;
+		}
+	}
+	return numStartableJobs;
+}
+
+static void finishInstantiationJob(InstantiationJob* job, InstantiationState state)
+{
+	ModuleInstance* moduleInstance;
+	{
+		Lock<Platform::Mutex> instantiationLock(instantiationMutex);
+
+		// Discard the module instance if the job was cancelled while it was running.
+		if(job->state == InstantiationState::cancelled)
+		{
+			state = InstantiationState::cancelled;
+			if(job->moduleInstance)
+			{
+				removeGCRoot(job->moduleInstance);
+				job->moduleInstance = nullptr;
+			}
+		}
+		job->state     = state;
+		moduleInstance = job->moduleInstance;
+	}
+	job->completionEvent.signal();
+
+	if(job->onComplete) { job->onComplete(moduleInstance); }
+	for(Object* object : job->rootedObjects) { removeGCRoot(object); }
+}
+
+static void startInstantiationThreads();
+
+// Instantiates queued modules as they fit in the compile memory budget, until the pool is shut
+// down.
+static I64 instantiationThreadEntry(void*)
+{
+	while(true)
+	{
+		std::shared_ptr<InstantiationJob> job;
+		{
+			Lock<Platform::Mutex> instantiationLock(instantiationMutex);
+			job = dequeueInstantiationJob();
+			if(job)
+			{
+				job->state = InstantiationState::running;
+				numRunningCodeBytes += job->numCodeBytes;
+				++numBusyInstantiationThreads;
+			}
+			else if(isShuttingDownInstantiationThreads)
+			{
+				return 0;
+			}
+		}
+
+		if(!job)
+		{
+			instantiationWakeEvent.wait(Platform::getMonotonicClock() + pollMicroseconds);
+			continue;
+		}
+
+		Timing::Timer instantiationTimer;
+		bool threwException = false;
+		catchRuntimeExceptions(
+			[&] {
+				// Root the objects created for the module instance until the module instance itself
+				// is rooted, so a concurrent collectGarbage can't delete them.
+				RootNewObjectsScope rootNewObjectsScope;
+				ModuleInstance* moduleInstance = instantiateModule(job->compartment,
+																   job->module,
+																   std::move(job->imports),
+																   std::move(job->debugName),
+																   job->optimizationLevel);
+				if(moduleInstance) { addGCRoot(moduleInstance); }
+				Lock<Platform::Mutex> instantiationLock(instantiationMutex);
+				job->moduleInstance = moduleInstance;
+			},
+			[&](Exception&& exception) {
+				threwException = true;
+				job->exception = std::move(exception);
+			});
+		Timing::logTimer("Instantiated module in background", instantiationTimer);
+
+		{
+			Lock<Platform::Mutex> instantiationLock(instantiationMutex);
+			numRunningCodeBytes -= job->numCodeBytes;
+			--numBusyInstantiationThreads;
+
+			// Jobs that didn't fit in the compile memory budget may fit now.
+			startInstantiationThreads();
+		}
+
+		const bool succeeded = !threwException && job->moduleInstance;
+		finishInstantiationJob(
+			job.get(), succeeded ? InstantiationState::complete : InstantiationState::failed);
+	}
+}
+
+// Wakes an idle instantiation thread for each queued job that fits in the compile memory budget,
+// and adds threads to the pool if there aren't enough idle threads, up to the maximum number of
+// threads. Jobs that don't fit in the budget don't wake or add any threads. The caller must hold
+// instantiationMutex.
+static void startInstantiationThreads()
+{
+	if(isShuttingDownInstantiationThreads) { return; }
+
+	const Uptr numStartableJobs = getNumStartableInstantiationJobs();
+	Uptr numIdleThreads         = instantiationThreads.size() - numBusyInstantiationThreads;
+	for(Uptr jobIndex = 0; jobIndex < std::min(numStartableJobs, numIdleThreads); ++jobIndex)
+	{ instantiationWakeEvent.signal(); }
+
+	while(numIdleThreads < numStartableJobs
+		  && instantiationThreads.size() < maxInstantiationThreads)
+	{
+		instantiationThreads.push_back(Platform::createThread(
+			instantiationThreadNumStackBytes, instantiationThreadEntry, nullptr));
+		++numIdleThreads;
+	}
+}
+
+AsyncInstantiation* Runtime::instantiateModuleAsync(
+	Compartment* compartment,
+	const IR::Module& module,
+	ImportBindings&& imports,
+	std::string&& debugName,
+	OptimizationLevel optimizationLevel,
+	std::function<void(ModuleInstance*)>&& onComplete)
+{
+	auto job = std::make_shared<InstantiationJob>(compartment,
+												  module,
+												  std::move(imports),
+												  std::move(debugName),
+												  optimizationLevel,
+												  std::move(onComplete));
+
+	Lock<Platform::Mutex> instantiationLock(instantiationMutex);
+	queuedInstantiationJobs.push_back(job);
+	startInstantiationThreads();
+
+	return new AsyncInstantiation{job};
+}
+
+bool Runtime::isInstantiationComplete(AsyncInstantiation* instantiation)
+{
+	Lock<Platform::Mutex> instantiationLock(instantiationMutex);
+	const InstantiationState state = instantiation->job->state;
+	return state != InstantiationState::queued && state != InstantiationState::running;
+}
+
+ModuleInstance* Runtime::waitForInstantiation(AsyncInstantiation* instantiation,
+											  Exception* outException)
+{
+	InstantiationJob* job = instantiation->job.get();
+	while(true)
+	{
+		{
+			Lock<Platform::Mutex> instantiationLock(instantiationMutex);
+			switch(job->state)
+			{
+			case InstantiationState::queued:
+			case InstantiationState::running: break;
+			case InstantiationState::complete: return job->moduleInstance;
+			case InstantiationState::failed:
+				if(outException) { *outException = job->exception; }
+				return nullptr;
+			case InstantiationState::cancelled: return nullptr;
+			default: Errors::unreachable();
+			};
+		}
+
+		job->completionEvent.wait(Platform::getMonotonicClock() + pollMicroseconds);
+	}
+}
+
+void Runtime::cancelInstantiation(AsyncInstantiation* instantiation)
+{
+	std::shared_ptr<InstantiationJob> job = instantiation->job;
+	{
+		Lock<Platform::Mutex> instantiationLock(instantiationMutex);
+		switch(job->state)
+		{
+		case InstantiationState::queued:
+		{
+			// Remove the job from the queue, and complete it below.
+			auto it = std::find(
+				queuedInstantiationJobs.begin(), queuedInstantiationJobs.end(), instantiation->job);
+			wavmAssert(it != queuedInstantiationJobs.end());
+			queuedInstantiationJobs.erase(it);
+			job->state = InstantiationState::cancelled;
+			break;
+		}
+		case InstantiationState::running:
+			// The instantiation thread discards the module instance when it completes.
+			job->state = InstantiationState::cancelled;
+			return;
+		case InstantiationState::complete:
+		case InstantiationState::failed:
+		case InstantiationState::cancelled: return;
+		default: Errors::unreachable();
+		};
+	}
+
+	finishInstantiationJob(job.get(), InstantiationState::cancelled);
+}
+
+void Runtime::deleteAsyncInstantiation(AsyncInstantiation* instantiation)
+{
+	cancelInstantiation(instantiation);
+
+	{
+		Lock<Platform::Mutex> instantiationLock(instantiationMutex);
+		InstantiationJob* job = instantiation->job.get();
+		if(job->state == InstantiationState::complete && job->moduleInstance)
+		{
+			removeGCRoot(job->moduleInstance);
+			job->moduleInstance = nullptr;
+		}
+	}
+
+	delete instantiation;
+}
+
+void Runtime::setMaxAsyncInstantiationThreads(Uptr numThreads)
+{
+	wavmAssert(numThreads > 0);
+	maxInstantiationThreads = numThreads;
+
+	Lock<Platform::Mutex> instantiationLock(instantiationMutex);
+	startInstantiationThreads();
+}
+
+void Runtime::setMaxAsyncCompileCodeBytes(Uptr numBytes) { maxCompileCodeBytes = numBytes; }
+
+void Runtime::shutdownAsyncInstantiationThreads()
+{
+	// Cancel the queued jobs, and stop the threads once they finish the jobs they are running.
+	std::vector<std::shared_ptr<InstantiationJob>> cancelledJobs;
+	std::vector<Platform::Thread*> exitingThreads;
+	{
+		Lock<Platform::Mutex> instantiationLock(instantiationMutex);
+		cancelledJobs.swap(queuedInstantiationJobs);
+		for(const std::shared_ptr<InstantiationJob>& job : cancelledJobs)
+		{ job->state = InstantiationState::cancelled; }
+
+		isShuttingDownInstantiationThreads = true;
+		exitingThreads.swap(instantiationThreads);
+	}
+
+	for(const std::shared_ptr<InstantiationJob>& job : cancelledJobs)
+	{ finishInstantiationJob(job.get(), InstantiationState::cancelled); }
+
+	for(Platform::Thread* thread : exitingThreads)
+	{
+		instantiationWakeEvent.signal();
+		Platform::joinThread(thread);
+	}
+
+	Lock<Platform::Mutex> instantiationLock(instantiationMutex);
+	wavmAssert(!numBusyInstantiationThreads);
+	isShuttingDownInstantiationThreads = false;
+}
@@ -0,0 +1,106 @@
+#include "Inline/Assert.h"
+#include "Inline/BasicTypes.h"
+#include "Inline/Lock.h"
+#include "Runtime.h"
+#include "RuntimePrivate.h"
+
+#include <string.h>
+#include <vector>
+
+using namespace Runtime;
+
+struct Runtime::CompartmentSnapshot
+{
+	// Copies of the snapshotted compartment's globals and tables, in a compartment that isn't
+	// otherwise used, so the snapshot doesn't reference the snapshotted compartment's objects.
+	GCPointer<Compartment> objectCompartment;
+	std::vector<GCPointer<GlobalInstance>> globals;
+	std::vector<GCPointer<TableInstance>> tables;
+
+	std::vector<MemorySnapshot> memories;
+	MemoryCommitPolicy memoryCommitPolicy;
+
+	// The values of the snapshotted context's mutable globals.
+	U32 numGlobalBytes;
+	U8 globalData[maxGlobalBytes];
+};
+
+CompartmentSnapshot* Runtime::snapshotCompartment(Context* context)
+{
+	Compartment* compartment      = context->compartment;
+	CompartmentSnapshot* snapshot = new CompartmentSnapshot;
+	snapshot->objectCompartment   = createCompartment();
+
+	Lock<Platform::Mutex> lock(compartment->mutex);
+
+	// Snapshot globals.
+	for(GlobalInstance* global : compartment->globals)
+	{
+		errorUnless(global);
+		snapshot->globals.push_back(cloneGlobal(global, snapshot->objectCompartment));
+	}
+
+	// Snapshot memories.
+	snapshot->memoryCommitPolicy = compartment->memoryCommitPolicy;
+	for(MemoryInstance* memory : compartment->memories)
+	{
+		errorUnless(memory);
+		snapshot->memories.push_back(snapshotMemory(memory));
+	}
+
+	// Snapshot tables.
+	for(TableInstance* table : compartment->tables)
+	{
+		errorUnless(table);
+		snapshot->tables.push_back(cloneTable(table, snapshot->objectCompartment));
+	}
+
+	// Snapshot the context's mutable globals.
+	snapshot->numGlobalBytes = compartment->numGlobalBytes;
+	memcpy(snapshot->globalData, context->runtimeData->globalData, snapshot->numGlobalBytes);
+
+	return snapshot;
+}
+
+Context* Runtime::restoreCompartmentSnapshot(const CompartmentSnapshot* snapshot)
+{
+	GCPointer<Compartment> compartment = createCompartment();
+	compartment->memoryCommitPolicy    = snapshot->memoryCommitPolicy;
+
+	// Restore globals.
+	for(Uptr globalIndex = 0; globalIndex < snapshot->globals.size(); ++globalIndex)
+	{
+		GlobalInstance* newGlobal = cloneGlobal(snapshot->globals[globalIndex], compartment);
+		if(!newGlobal) { return nullptr; }
+		wavmAssert(newGlobal->id == globalIndex);
+	}
+	wavmAssert(compartment->numGlobalBytes == snapshot->numGlobalBytes);
+
+	// Restore memories.
+	for(Uptr memoryIndex = 0; memoryIndex < snapshot->memories.size(); ++memoryIndex)
+	{
+		MemoryInstance* newMemory
+			= restoreMemorySnapshot(snapshot->memories[memoryIndex], compartment);
+		if(!newMemory) { return nullptr; }
+		wavmAssert(newMemory->id == memoryIndex);
+	}
+
+	// Restore tables.
+	for(Uptr tableIndex = 0; tableIndex < snapshot->tables.size(); ++tableIndex)
+	{
+		TableInstance* newTable = cloneTable(snapshot->tables[tableIndex], compartment);
+		if(!newTable) { return nullptr; }
+		wavmAssert(newTable->id == tableIndex);
+	}
+
+	// Initialize new contexts' mutable globals with the snapshotted values, and create a context.
+	{
+		Lock<Platform::Mutex> lock(compartment->mutex);
+		memcpy(compartment->initialContextGlobalData,
+			   snapshot->globalData,
+			   snapshot->numGlobalBytes);
+	}
+	return createContext(compartment);
+}
+
+void Runtime::deleteCompartmentSnapshot(CompartmentSnapshot* snapshot) { delete snapshot; }
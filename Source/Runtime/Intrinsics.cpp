@@ -119,6 +119,10 @@ Runtime::ModuleInstance* Intrinsics::instantiateModule(
 			errorUnless(moduleInstance->exportMap.add(pair.key, functionInstance));
 		}
 
+		// Compile the thunks that generated code uses to call the module's functions through a
+		// table together, instead of compiling each one the first time it is stored in a table.
+		LLVMJIT::compileIntrinsicThunks(moduleInstance->functions);
+
 		for(const auto& pair : moduleRef.impl->tableMap)
 		{
 			auto tableInstance = pair.value->instantiate(compartment);
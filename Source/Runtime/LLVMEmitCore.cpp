@@ -50,6 +50,9 @@ void EmitFunctionContext::loop(ControlStructureImm imm)
 	for(Iptr elementIndex = Iptr(blockType.params().size()) - 1; elementIndex >= 0; --elementIndex)
 	{ parameterPHIs[elementIndex]->addIncoming(pop(), loopEntryBlock); }
 
+	// Count loop iterations in baseline tier code.
+	emitTierUpCounter();
+
 	// Push a control context that ends at the end block/phi.
 	pushControlStack(ControlContext::Type::loop, blockType.results(), endBlock, endPHIs);
 
@@ -308,8 +311,8 @@ void EmitFunctionContext::call(CallImm imm)
 		FunctionInstance* importedCallee
 			= moduleContext.moduleInstance->functions[imm.functionIndex];
 		calleeType = importedCallee->type;
-		callee     = emitLiteralPointer(
-            importedCallee->nativeFunction,
+		callee     = moduleContext.emitBoundSymbol(
+            "functionImport" + std::to_string(imm.functionIndex),
             asLLVMType(importedCallee->type, importedCallee->callingConvention)->getPointerTo());
 		callingConvention = importedCallee->callingConvention;
 	}
@@ -317,9 +320,23 @@ void EmitFunctionContext::call(CallImm imm)
 	{
 		const Uptr functionDefIndex = imm.functionIndex - module.functions.imports.size();
 		wavmAssert(functionDefIndex < moduleContext.functionDefs.size());
-		callee            = moduleContext.functionDefs[functionDefIndex];
 		calleeType        = module.types[module.functions.defs[functionDefIndex].type.index];
 		callingConvention = CallingConvention::wasm;
+		if(moduleContext.tier == CodeTier::untiered)
+		{ callee = moduleContext.functionDefs[functionDefIndex]; }
+		else
+		{
+			// Tiered code calls functions through their FunctionInstance's code pointer, so the
+			// callee's optimized code is called once it replaces the baseline code.
+			auto llvmFunctionType = asLLVMType(calleeType, CallingConvention::wasm);
+			auto codePointer      = moduleContext.emitBoundSymbol(
+				"functionDefCode" + std::to_string(functionDefIndex),
+				llvmFunctionType->getPointerTo()->getPointerTo());
+			auto codeLoad = irBuilder.CreateLoad(codePointer);
+			codeLoad->setAlignment(sizeof(void*));
+			codeLoad->setAtomic(llvm::AtomicOrdering::Unordered);
+			callee = codeLoad;
+		}
 	}
 
 	// Pop the call arguments from the operand stack.
@@ -362,8 +379,7 @@ void EmitFunctionContext::call_indirect(CallIndirectImm imm)
 	auto functionTypePointerPointer = irBuilder.CreateInBoundsGEP(
 		typedTableBasePointer, {functionIndexZExt, emitLiteral((U32)0)});
 	auto functionTypePointer = irBuilder.CreateLoad(functionTypePointerPointer);
-	auto llvmCalleeType
-		= emitLiteralPointer(reinterpret_cast<void*>(calleeType.getEncoding().impl), llvmI8PtrType);
+	auto llvmCalleeType = moduleContext.emitFunctionTypeEncoding(imm.type.index);
 
 	// If the function type doesn't match, trap.
 	emitConditionalTrapIntrinsic(
@@ -98,7 +98,7 @@ void EmitFunctionContext::try_(ControlStructureImm imm)
 
 static llvm::Function* createSEHFilterFunction(
 	EmitFunctionContext& functionContext,
-	const Runtime::ExceptionTypeInstance* catchTypeInstance,
+	llvm::Constant* catchTypeInstance,
 	llvm::Value*& outExceptionDataAlloca)
 {
 	// Insert an alloca for the exception point at the beginning of the function, and add it as a
@@ -183,8 +183,8 @@ static llvm::Function* createSEHFilterFunction(
 		// exception type, return 1 from the filter function.
 		auto exceptionTypeInstance = filterIRBuilder.CreateLoad(
 			filterIRBuilder.CreateIntToPtr(exceptionData, llvmI64Type->getPointerTo()));
-		auto isExpectedTypeInstance = filterIRBuilder.CreateICmpEQ(
-			exceptionTypeInstance, emitLiteral(reinterpret_cast<I64>(catchTypeInstance)));
+		auto isExpectedTypeInstance
+			= filterIRBuilder.CreateICmpEQ(exceptionTypeInstance, catchTypeInstance);
 		filterIRBuilder.CreateRet(filterIRBuilder.CreateZExt(isExpectedTypeInstance, llvmI32Type));
 	}
 
@@ -210,8 +210,10 @@ void EmitFunctionContext::catch_(CatchImm imm)
 	// Look up the exception type instance to be caught
 	wavmAssert(imm.exceptionTypeIndex
 			   < moduleContext.moduleInstance->exceptionTypeInstances.size());
-	const Runtime::ExceptionTypeInstance* catchTypeInstance
-		= moduleContext.moduleInstance->exceptionTypeInstances[imm.exceptionTypeIndex];
+	const ExceptionType catchType
+		= moduleContext.moduleInstance->exceptionTypeInstances[imm.exceptionTypeIndex]->type;
+	llvm::Constant* catchTypeInstance
+		= moduleContext.emitExceptionTypeInstance(imm.exceptionTypeIndex, llvmI64Type);
 
 	// Create a filter function that returns 1 for the specific exception type this instruction
 	// catches.
@@ -232,16 +234,14 @@ void EmitFunctionContext::catch_(CatchImm imm)
 	irBuilder.SetInsertPoint(catchBlock);
 
 	catchContext.exceptionPointer = irBuilder.CreateLoad(exceptionDataAlloca);
-	for(Uptr argumentIndex = 0; argumentIndex < catchTypeInstance->type.params.size();
-		++argumentIndex)
+	for(Uptr argumentIndex = 0; argumentIndex < catchType.params.size(); ++argumentIndex)
 	{
-		const ValueType parameters = catchTypeInstance->type.params[argumentIndex];
+		const ValueType parameters = catchType.params[argumentIndex];
 		auto argument              = loadFromUntypedPointer(
             irBuilder.CreateInBoundsGEP(
                 catchContext.exceptionPointer,
-                {emitLiteral(offsetof(
-                    ExceptionData,
-                    arguments[catchTypeInstance->type.params.size() - argumentIndex - 1]))}),
+                {emitLiteral(offsetof(ExceptionData,
+                                      arguments[catchType.params.size() - argumentIndex - 1]))}),
             asLLVMType(parameters));
 		push(argument);
 	}
@@ -314,8 +314,8 @@ void EmitFunctionContext::try_(ControlStructureImm imm)
 		CatchContext{landingPadInst, landingPadBlock, exceptionTypeInstance, exceptionPointer});
 
 	// Add the platform exception type to the landing pad's type filter.
-	auto platformExceptionTypeInfo = (llvm::Constant*)irBuilder.CreateIntToPtr(
-		emitLiteral(reinterpret_cast<Uptr>(Platform::getUserExceptionTypeInfo())), llvmI8PtrType);
+	auto platformExceptionTypeInfo
+		= moduleContext.emitBoundSymbol("userExceptionTypeInfo", llvmI8PtrType);
 	landingPadInst->addClause(platformExceptionTypeInfo);
 
 	// Create an end try+phi for the try result.
@@ -355,12 +355,14 @@ void EmitFunctionContext::catch_(CatchImm imm)
 	// Look up the exception type instance to be caught
 	wavmAssert(imm.exceptionTypeIndex
 			   < moduleContext.moduleInstance->exceptionTypeInstances.size());
-	const Runtime::ExceptionTypeInstance* catchTypeInstance
-		= moduleContext.moduleInstance->exceptionTypeInstances[imm.exceptionTypeIndex];
+	const ExceptionType catchType
+		= moduleContext.moduleInstance->exceptionTypeInstances[imm.exceptionTypeIndex]->type;
+	llvm::Constant* catchTypeInstance
+		= moduleContext.emitExceptionTypeInstance(imm.exceptionTypeIndex, llvmI64Type);
 
 	irBuilder.SetInsertPoint(catchContext.nextHandlerBlock);
-	auto isExceptionType = irBuilder.CreateICmpEQ(
-		catchContext.exceptionTypeInstance, emitLiteral(reinterpret_cast<Uptr>(catchTypeInstance)));
+	auto isExceptionType
+		= irBuilder.CreateICmpEQ(catchContext.exceptionTypeInstance, catchTypeInstance);
 
 	auto catchBlock     = llvm::BasicBlock::Create(*llvmContext, "catch", llvmFunction);
 	auto unhandledBlock = llvm::BasicBlock::Create(*llvmContext, "unhandled", llvmFunction);
@@ -368,10 +370,9 @@ void EmitFunctionContext::catch_(CatchImm imm)
 	catchContext.nextHandlerBlock = unhandledBlock;
 	irBuilder.SetInsertPoint(catchBlock);
 
-	for(Iptr argumentIndex = catchTypeInstance->type.params.size() - 1; argumentIndex >= 0;
-		--argumentIndex)
+	for(Iptr argumentIndex = catchType.params.size() - 1; argumentIndex >= 0; --argumentIndex)
 	{
-		const ValueType parameters = catchTypeInstance->type.params[argumentIndex];
+		const ValueType parameters = catchType.params[argumentIndex];
 		const Uptr argumentOffset  = offsetof(ExceptionData, arguments)
 									+ sizeof(ExceptionData::arguments[0]) * argumentIndex;
 		auto argument
@@ -452,7 +453,7 @@ void EmitFunctionContext::throw_(ThrowImm imm)
 				elementValue->getType()->getPointerTo()));
 	}
 
-	emitThrow(emitLiteral((U64) reinterpret_cast<Uptr>(exceptionTypeInstance)),
+	emitThrow(moduleContext.emitExceptionTypeInstance(imm.exceptionTypeIndex, llvmI64Type),
 			  sizeof(Uptr) == 8
 				  ? irBuilder.CreatePtrToInt(argBaseAddress, llvmI64Type)
 				  : zext(irBuilder.CreatePtrToInt(argBaseAddress, llvmI32Type), llvmI64Type),
@@ -154,8 +154,8 @@ ValueVector EmitFunctionContext::emitRuntimeIntrinsic(
 	wavmAssert(isA(intrinsicObject, intrinsicType));
 	FunctionInstance* intrinsicFunction = asFunction(intrinsicObject);
 	wavmAssert(intrinsicFunction->type == intrinsicType);
-	auto intrinsicFunctionPointer = emitLiteralPointer(
-		intrinsicFunction->nativeFunction,
+	auto intrinsicFunctionPointer = moduleContext.emitBoundSymbol(
+		std::string("wavmIntrinsics.") + intrinsicName,
 		asLLVMType(intrinsicType, intrinsicFunction->callingConvention)->getPointerTo());
 
 	return emitCallOrInvoke(intrinsicFunctionPointer,
@@ -187,6 +187,38 @@ void EmitFunctionContext::emitConditionalTrapIntrinsic(
 	irBuilder.SetInsertPoint(endBlock);
 }
 
+void EmitFunctionContext::emitTierUpCounter()
+{
+	if(moduleContext.tier != CodeTier::baseline) { return; }
+
+	// Decrement the function's tier-up counter, and if this decrement brought it to zero, request
+	// that the function be recompiled at the optimized tier. The counter may wrap around and reach
+	// zero again while this code keeps running, so the JIT ignores repeated requests.
+	llvm::Value* tierUpCounter = moduleContext.emitBoundSymbol(
+		"tierUpCounter" + std::to_string(functionDefIndex), llvmI32Type->getPointerTo());
+	llvm::Value* previousCount = irBuilder.CreateAtomicRMW(llvm::AtomicRMWInst::Sub,
+														   tierUpCounter,
+														   emitLiteral(I32(1)),
+														   llvm::AtomicOrdering::Monotonic);
+
+	auto tierUpBlock = llvm::BasicBlock::Create(*llvmContext, "tierUp", llvmFunction);
+	auto endBlock    = llvm::BasicBlock::Create(*llvmContext, "tierUpEnd", llvmFunction);
+	irBuilder.CreateCondBr(irBuilder.CreateICmpEQ(previousCount, emitLiteral(I32(1))),
+						   tierUpBlock,
+						   endBlock,
+						   moduleContext.likelyFalseBranchWeights);
+
+	irBuilder.SetInsertPoint(tierUpBlock);
+	emitRuntimeIntrinsic("tierUpFunction",
+						 FunctionType(TypeTuple{}, TypeTuple{ValueType::i64, ValueType::i64}),
+						 {moduleContext.emitBoundSymbol(
+							  "functionDef" + std::to_string(functionDefIndex), llvmI64Type),
+						  emitLiteral(U64(functionDefIndex))});
+	irBuilder.CreateBr(endBlock);
+
+	irBuilder.SetInsertPoint(endBlock);
+}
+
 //
 // Control structure operators
 //
@@ -307,21 +339,27 @@ private:
 void EmitFunctionContext::emit()
 {
 	// Create debug info for the function.
-	llvm::SmallVector<llvm::Metadata*, 10> diFunctionParameterTypes;
-	for(auto parameterType : functionType.params())
-	{ diFunctionParameterTypes.push_back(moduleContext.diValueTypes[(Uptr)parameterType]); }
-	auto diParamArray   = moduleContext.diBuilder->getOrCreateTypeArray(diFunctionParameterTypes);
-	auto diFunctionType = moduleContext.diBuilder->createSubroutineType(diParamArray);
-	diFunction          = moduleContext.diBuilder->createFunction(moduleContext.diModuleScope,
-                                                         functionInstance->debugName,
-                                                         llvmFunction->getName(),
-                                                         moduleContext.diModuleScope,
-                                                         0,
-                                                         diFunctionType,
-                                                         false,
-                                                         true,
-                                                         0);
-	llvmFunction->setSubprogram(diFunction);
+	diFunction = nullptr;
+	if(moduleContext.emitDebugInfo)
+	{
+		llvm::SmallVector<llvm::Metadata*, 10> diFunctionParameterTypes;
+		for(auto parameterType : functionType.params())
+		{ diFunctionParameterTypes.push_back(moduleContext.diValueTypes[(Uptr)parameterType]); }
+		auto diBuilder      = moduleContext.diBuilder.get();
+		auto diParamArray   = diBuilder->getOrCreateTypeArray(diFunctionParameterTypes);
+		auto diFunctionType = diBuilder->createSubroutineType(diParamArray);
+
+		diFunction = diBuilder->createFunction(moduleContext.diModuleScope,
+											   functionInstance->debugName,
+											   llvmFunction->getName(),
+											   moduleContext.diModuleScope,
+											   0,
+											   diFunctionType,
+											   false,
+											   true,
+											   0);
+		llvmFunction->setSubprogram(diFunction);
+	}
 
 	// Create the return basic block, and push the root control context for the function.
 	auto returnBlock = llvm::BasicBlock::Create(*llvmContext, "return", llvmFunction);
@@ -367,12 +405,16 @@ void EmitFunctionContext::emit()
 		}
 	}
 
+	// Count calls to the function in baseline tier code.
+	emitTierUpCounter();
+
 	// If enabled, emit a call to the WAVM function enter hook (for debugging).
 	if(ENABLE_FUNCTION_ENTER_EXIT_HOOKS)
 	{
 		emitRuntimeIntrinsic("debugEnterFunction",
 							 FunctionType(TypeTuple{}, TypeTuple{ValueType::i64}),
-							 {emitLiteral(reinterpret_cast<U64>(functionInstance))});
+							 {moduleContext.emitBoundSymbol(
+								 "functionDef" + std::to_string(functionDefIndex), llvmI64Type)});
 	}
 
 	// Decode the WebAssembly opcodes and emit LLVM IR for them.
@@ -382,8 +424,11 @@ void EmitFunctionContext::emit()
 	Uptr opIndex = 0;
 	while(decoder && controlStack.size())
 	{
-		irBuilder.SetCurrentDebugLocation(
-			llvm::DILocation::get(*llvmContext, (unsigned int)opIndex++, 0, diFunction));
+		if(diFunction)
+		{
+			irBuilder.SetCurrentDebugLocation(
+				llvm::DILocation::get(*llvmContext, (unsigned int)opIndex++, 0, diFunction));
+		}
 		if(ENABLE_LOGGING) { logOperator(decoder.decodeOpWithoutConsume(operatorPrinter)); }
 
 		if(controlStack.back().isReachable) { decoder.decodeOp(*this); }
@@ -399,7 +444,8 @@ void EmitFunctionContext::emit()
 	{
 		emitRuntimeIntrinsic("debugExitFunction",
 							 FunctionType(TypeTuple{}, TypeTuple{ValueType::i64}),
-							 {emitLiteral(reinterpret_cast<U64>(functionInstance))});
+							 {moduleContext.emitBoundSymbol(
+								 "functionDef" + std::to_string(functionDefIndex), llvmI64Type)});
 	}
 
 	// Emit the function return.
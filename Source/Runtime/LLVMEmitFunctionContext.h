@@ -19,6 +19,7 @@ namespace LLVMJIT
 		const IR::Module& module;
 		const IR::FunctionDef& functionDef;
 		IR::FunctionType functionType;
+		Uptr functionDefIndex;
 		Runtime::FunctionInstance* functionInstance;
 		llvm::Function* llvmFunction;
 
@@ -68,14 +69,15 @@ namespace LLVMJIT
 		EmitFunctionContext(EmitModuleContext& inModuleContext,
 							const Module& inModule,
 							const FunctionDef& inFunctionDef,
+							Uptr inFunctionDefIndex,
 							FunctionInstance* inFunctionInstance,
 							llvm::Function* inLLVMFunction)
-		: EmitContext(inModuleContext.moduleInstance->defaultMemory,
-					  inModuleContext.moduleInstance->defaultTable)
+		: EmitContext(inModuleContext.defaultMemoryOffset, inModuleContext.defaultTableOffset)
 		, moduleContext(inModuleContext)
 		, module(inModule)
 		, functionDef(inFunctionDef)
 		, functionType(inModule.types[inFunctionDef.type.index])
+		, functionDefIndex(inFunctionDefIndex)
 		, functionInstance(inFunctionInstance)
 		, llvmFunction(inLLVMFunction)
 		, localEscapeBlock(nullptr)
@@ -142,6 +144,9 @@ namespace LLVMJIT
 											  U32 offset,
 											  llvm::Type* memoryType);
 
+		// Loads the number of pages in the default memory as an I32.
+		llvm::Value* loadDefaultMemoryNumPages();
+
 		// Traps a divide-by-zero
 		void trapDivideByZero(ValueType type, llvm::Value* divisor);
 
@@ -169,6 +174,9 @@ namespace LLVMJIT
 										  FunctionType intrinsicType,
 										  const std::initializer_list<llvm::Value*>& args);
 
+		// Emits code to count down the function's tier-up counter in baseline tier code.
+		void emitTierUpCounter();
+
 		void pushControlStack(ControlContext::Type type,
 							  TypeTuple resultTypes,
 							  llvm::BasicBlock* endBlock,
@@ -214,6 +222,14 @@ namespace LLVMJIT
 		llvm::Value* emitRotl(ValueType type, llvm::Value* left, llvm::Value* right);
 		llvm::Value* emitRotr(ValueType type, llvm::Value* left, llvm::Value* right);
 		llvm::Value* emitF64Promote(llvm::Value* operand);
+		llvm::Value* emitQuietNaN(ValueType type, llvm::Value* nan);
+		llvm::Value* emitFloatMinMax(ValueType type,
+									 bool isMax,
+									 llvm::Value* left,
+									 llvm::Value* right);
+		llvm::Value* emitFloatRound(ValueType type,
+									llvm::Intrinsic::ID intrinsicId,
+									llvm::Value* operand);
 
 		template<typename Float>
 		llvm::Value* emitTruncFloatToInt(ValueType destType,
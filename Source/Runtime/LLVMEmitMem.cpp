@@ -8,32 +8,74 @@ using namespace IR;
 
 //
 // Memory size operators
-// These just call out to wavmIntrinsics.growMemory/currentMemory, passing a pointer to the default
-// memory for the module.
+// The number of pages in each memory is stored in the compartment runtime data, so memory.size is a
+// load. memory.grow only calls out to wavmIntrinsics.growMemory if it needs to commit pages.
 //
 
+llvm::Value* EmitFunctionContext::loadDefaultMemoryNumPages()
+{
+	// The memory's number of pages is at the same index in memoryNumPages as its base address is in
+	// memories.
+	static_assert(sizeof(CompartmentRuntimeData::memoryNumPages[0])
+					  == sizeof(CompartmentRuntimeData::memories[0]),
+				  "memoryNumPages and memories must have the same element size");
+	llvm::Constant* numPagesOffset = llvm::ConstantExpr::getAdd(
+		defaultMemoryOffset,
+		emitLiteral(U64(offsetof(CompartmentRuntimeData, memoryNumPages)
+						- offsetof(CompartmentRuntimeData, memories))));
+	llvm::LoadInst* numPages = irBuilder.CreateLoad(irBuilder.CreatePointerCast(
+		irBuilder.CreateInBoundsGEP(getCompartmentAddress(), {numPagesOffset}),
+		llvmI64Type->getPointerTo()));
+	numPages->setAlignment(sizeof(Uptr));
+	numPages->setAtomic(llvm::AtomicOrdering::Monotonic);
+
+	// A memory can't have more than IR::maxMemoryPages, so the number of pages fits in an I32.
+	return irBuilder.CreateTrunc(numPages, llvmI32Type);
+}
+
 void EmitFunctionContext::memory_grow(MemoryImm)
 {
-	llvm::Value* deltaNumPages   = pop();
+	llvm::Value* deltaNumPages = pop();
+
+	// Growing by zero pages just returns the current size, and growing beyond the memory type's
+	// maximum size always fails, so handle both without calling into the runtime.
+	const U64 maxNumPages = std::min(moduleContext.module.memories.getType(0).size.max,
+									 U64(IR::maxMemoryPages));
+	llvm::Value* numPages = loadDefaultMemoryNumPages();
+	llvm::Value* isZero
+		= irBuilder.CreateICmpEQ(deltaNumPages, typedZeroConstants[(Uptr)ValueType::i32]);
+	llvm::Value* exceedsMax = irBuilder.CreateICmpUGT(
+		zext(deltaNumPages, llvmI64Type),
+		irBuilder.CreateSub(emitLiteral(maxNumPages), zext(numPages, llvmI64Type)));
+	llvm::Value* fastResult = irBuilder.CreateSelect(isZero, numPages, emitLiteral(I32(-1)));
+
+	auto growBlock = llvm::BasicBlock::Create(*llvmContext, "memoryGrow", llvmFunction);
+	auto endBlock  = llvm::BasicBlock::Create(*llvmContext, "memoryGrowEnd", llvmFunction);
+	llvm::BasicBlock* fastBlock = irBuilder.GetInsertBlock();
+	irBuilder.CreateCondBr(irBuilder.CreateOr(isZero, exceedsMax), endBlock, growBlock);
+
+	irBuilder.SetInsertPoint(growBlock);
 	ValueVector previousNumPages = emitRuntimeIntrinsic(
 		"growMemory",
 		FunctionType(TypeTuple(ValueType::i32), TypeTuple({ValueType::i32, ValueType::i64})),
-		{deltaNumPages, emitLiteral(U64(moduleContext.moduleInstance->defaultMemory->id))});
+		{deltaNumPages, defaultMemoryId});
 	wavmAssert(previousNumPages.size() == 1);
-	push(previousNumPages[0]);
-}
-void EmitFunctionContext::memory_size(MemoryImm)
-{
-	ValueVector currentNumPages
-		= emitRuntimeIntrinsic("currentMemory",
-							   FunctionType(TypeTuple(ValueType::i32), TypeTuple(ValueType::i64)),
-							   {emitLiteral(U64(moduleContext.moduleInstance->defaultMemory->id))});
-	wavmAssert(currentNumPages.size() == 1);
-	push(currentNumPages[0]);
+	llvm::BasicBlock* growEndBlock = irBuilder.GetInsertBlock();
+	irBuilder.CreateBr(endBlock);
+
+	irBuilder.SetInsertPoint(endBlock);
+	llvm::PHINode* result = irBuilder.CreatePHI(llvmI32Type, 2);
+	result->addIncoming(fastResult, fastBlock);
+	result->addIncoming(previousNumPages[0], growEndBlock);
+	push(result);
 }
+void EmitFunctionContext::memory_size(MemoryImm) { push(loadDefaultMemoryNumPages()); }
 
 //
 // Load/store operators
+// Accesses are volatile unless relaxed memory traps are enabled for an unshared memory, so LLVM
+// doesn't delete or reorder an out of bounds access that must trap by faulting on the memory's
+// guard pages.
 //
 
 #define EMIT_LOAD_OP(valueTypeId, name, llvmMemoryType, naturalAlignmentLog2, conversionOp)        \
@@ -43,7 +85,7 @@ void EmitFunctionContext::memory_size(MemoryImm)
 		auto pointer   = coerceByteIndexToPointer(byteIndex, imm.offset, llvmMemoryType);          \
 		auto load      = irBuilder.CreateLoad(pointer);                                            \
 		load->setAlignment(1 << imm.alignmentLog2);                                                \
-		load->setVolatile(true);                                                                   \
+		load->setVolatile(moduleContext.areMemoryAccessesVolatile);                                \
 		push(conversionOp(load, asLLVMType(ValueType::valueTypeId)));                              \
 	}
 #define EMIT_STORE_OP(valueTypeId, name, llvmMemoryType, naturalAlignmentLog2, conversionOp)       \
@@ -54,7 +96,7 @@ void EmitFunctionContext::memory_size(MemoryImm)
 		auto pointer     = coerceByteIndexToPointer(byteIndex, imm.offset, llvmMemoryType);        \
 		auto memoryValue = conversionOp(value, llvmMemoryType);                                    \
 		auto store       = irBuilder.CreateStore(memoryValue, pointer);                            \
-		store->setVolatile(true);                                                                  \
+		store->setVolatile(moduleContext.areMemoryAccessesVolatile);                               \
 		store->setAlignment(1 << imm.alignmentLog2);                                               \
 	}
 
@@ -91,36 +133,33 @@ void EmitFunctionContext::atomic_wake(AtomicLoadOrStoreImm<2>)
 {
 	auto numWaiters = pop();
 	auto address    = pop();
-	auto memoryId   = emitLiteral(U64(moduleContext.moduleInstance->defaultMemory->id));
 	push(emitRuntimeIntrinsic(
 		"atomic_wake",
 		FunctionType(TypeTuple{ValueType::i32},
 					 TypeTuple{ValueType::i32, ValueType::i32, ValueType::i64}),
-		{address, numWaiters, memoryId})[0]);
+		{address, numWaiters, defaultMemoryId})[0]);
 }
 void EmitFunctionContext::i32_atomic_wait(AtomicLoadOrStoreImm<2>)
 {
 	auto timeout       = pop();
 	auto expectedValue = pop();
 	auto address       = pop();
-	auto memoryId      = emitLiteral(U64(moduleContext.moduleInstance->defaultMemory->id));
 	push(emitRuntimeIntrinsic(
 		"atomic_wait_i32",
 		FunctionType(TypeTuple{ValueType::i32},
 					 TypeTuple{ValueType::i32, ValueType::i32, ValueType::f64, ValueType::i64}),
-		{address, expectedValue, timeout, memoryId})[0]);
+		{address, expectedValue, timeout, defaultMemoryId})[0]);
 }
 void EmitFunctionContext::i64_atomic_wait(AtomicLoadOrStoreImm<3>)
 {
 	auto timeout       = pop();
 	auto expectedValue = pop();
 	auto address       = pop();
-	auto memoryId      = emitLiteral(U64(moduleContext.moduleInstance->defaultMemory->id));
 	push(emitRuntimeIntrinsic(
 		"atomic_wait_i64",
 		FunctionType(TypeTuple{ValueType::i32},
 					 TypeTuple{ValueType::i32, ValueType::i64, ValueType::f64, ValueType::i64}),
-		{address, expectedValue, timeout, memoryId})[0]);
+		{address, expectedValue, timeout, defaultMemoryId})[0]);
 }
 
 void EmitFunctionContext::trapIfMisalignedAtomic(llvm::Value* address, U32 alignmentLog2)
@@ -4,31 +4,59 @@
 #include "Inline/Timing.h"
 #include "LLVMEmitFunctionContext.h"
 #include "LLVMJIT.h"
+#include "Platform/Platform.h"
+
+#include <stdlib.h>
+#include <string.h>
 
 using namespace LLVMJIT;
 using namespace IR;
 
-EmitModuleContext::EmitModuleContext(const Module& inModule, ModuleInstance* inModuleInstance)
-: module(inModule), moduleInstance(inModuleInstance)
+EmitModuleContext::EmitModuleContext(const Module& inModule,
+									 ModuleInstance* inModuleInstance,
+									 Uptr inBeginFunctionDefIndex,
+									 Uptr inEndFunctionDefIndex,
+									 CodeTier inTier)
+: module(inModule)
+, moduleInstance(inModuleInstance)
+, beginFunctionDefIndex(inBeginFunctionDefIndex)
+, endFunctionDefIndex(inEndFunctionDefIndex)
+, tier(inTier)
 {
+	wavmAssert(beginFunctionDefIndex <= endFunctionDefIndex);
+	wavmAssert(endFunctionDefIndex <= module.functions.defs.size());
+
 	llvmModuleSharedPtr = std::make_shared<llvm::Module>("", *llvmContext);
 	llvmModule          = llvmModuleSharedPtr.get();
-	diBuilder           = llvm::make_unique<llvm::DIBuilder>(*llvmModule);
-
-	diModuleScope = diBuilder->createFile("unknown", "unknown");
-	diCompileUnit = diBuilder->createCompileUnit(0xffff, diModuleScope, "WAVM", true, "", 0);
-
-	diValueTypes[(Uptr)ValueType::any] = nullptr;
-	diValueTypes[(Uptr)ValueType::i32]
-		= diBuilder->createBasicType("i32", 32, llvm::dwarf::DW_ATE_signed);
-	diValueTypes[(Uptr)ValueType::i64]
-		= diBuilder->createBasicType("i64", 64, llvm::dwarf::DW_ATE_signed);
-	diValueTypes[(Uptr)ValueType::f32]
-		= diBuilder->createBasicType("f32", 32, llvm::dwarf::DW_ATE_float);
-	diValueTypes[(Uptr)ValueType::f64]
-		= diBuilder->createBasicType("f64", 64, llvm::dwarf::DW_ATE_float);
-	diValueTypes[(Uptr)ValueType::v128]
-		= diBuilder->createBasicType("v128", 128, llvm::dwarf::DW_ATE_signed);
+	emitDebugInfo       = isDebugInfoEnabled();
+	if(emitDebugInfo)
+	{
+		diBuilder = llvm::make_unique<llvm::DIBuilder>(*llvmModule);
+
+		diModuleScope = diBuilder->createFile("unknown", "unknown");
+		diCompileUnit = diBuilder->createCompileUnit(0xffff, diModuleScope, "WAVM", true, "", 0);
+
+		diValueTypes[(Uptr)ValueType::any] = nullptr;
+		diValueTypes[(Uptr)ValueType::i32]
+			= diBuilder->createBasicType("i32", 32, llvm::dwarf::DW_ATE_signed);
+		diValueTypes[(Uptr)ValueType::i64]
+			= diBuilder->createBasicType("i64", 64, llvm::dwarf::DW_ATE_signed);
+		diValueTypes[(Uptr)ValueType::f32]
+			= diBuilder->createBasicType("f32", 32, llvm::dwarf::DW_ATE_float);
+		diValueTypes[(Uptr)ValueType::f64]
+			= diBuilder->createBasicType("f64", 64, llvm::dwarf::DW_ATE_float);
+		diValueTypes[(Uptr)ValueType::v128]
+			= diBuilder->createBasicType("v128", 128, llvm::dwarf::DW_ATE_signed);
+	}
+
+	defaultMemoryOffset = moduleInstance->defaultMemory
+							  ? emitBoundSymbol("defaultMemoryOffset", llvmI64Type)
+							  : nullptr;
+	defaultTableOffset = moduleInstance->defaultTable
+							 ? emitBoundSymbol("defaultTableOffset", llvmI64Type)
+							 : nullptr;
+	areMemoryAccessesVolatile = !areMemoryTrapsRelaxed()
+								|| (module.memories.size() && module.memories.getType(0).isShared);
 
 	auto zeroAsMetadata      = llvm::ConstantAsMetadata::get(emitLiteral(I32(0)));
 	auto i32MaxAsMetadata    = llvm::ConstantAsMetadata::get(emitLiteral(I32(INT32_MAX)));
@@ -70,7 +98,8 @@ std::shared_ptr<llvm::Module> EmitModuleContext::emit()
 #endif
 								 llvmModule);
 
-	// Create the LLVM functions.
+	// Create the LLVM functions. Functions outside the range being emitted are only declared, and
+	// calls to them are resolved by name when the module's objects are linked.
 	functionDefs.resize(module.functions.defs.size());
 	for(Uptr functionDefIndex = 0; functionDefIndex < module.functions.defs.size();
 		++functionDefIndex)
@@ -81,32 +110,245 @@ std::shared_ptr<llvm::Module> EmitModuleContext::emit()
 		auto externalName              = getExternalFunctionName(moduleInstance, functionDefIndex);
 		functionDefs[functionDefIndex] = llvm::Function::Create(
 			llvmFunctionType, llvm::Function::ExternalLinkage, externalName, llvmModule);
-		functionDefs[functionDefIndex]->setPersonalityFn(personalityFunction);
 		functionDefs[functionDefIndex]->setCallingConv(asLLVMCallingConv(CallingConvention::wasm));
+		if(functionDefIndex >= beginFunctionDefIndex && functionDefIndex < endFunctionDefIndex)
+		{ functionDefs[functionDefIndex]->setPersonalityFn(personalityFunction); }
 	}
 
-	// Compile each function in the module.
-	for(Uptr functionDefIndex = 0; functionDefIndex < module.functions.defs.size();
+	// Compile each function in the range.
+	for(Uptr functionDefIndex = beginFunctionDefIndex; functionDefIndex < endFunctionDefIndex;
 		++functionDefIndex)
 	{
 		EmitFunctionContext(*this,
 							module,
 							module.functions.defs[functionDefIndex],
+							functionDefIndex,
 							moduleInstance->functionDefs[functionDefIndex],
 							functionDefs[functionDefIndex])
 			.emit();
 	}
 
 	// Finalize the debug info.
-	diBuilder->finalize();
+	if(emitDebugInfo) { diBuilder->finalize(); }
 
-	Timing::logRatePerSecond("Emitted LLVM IR", emitTimer, (F64)llvmModule->size(), "functions");
+	Timing::logRatePerSecond("Emitted LLVM IR",
+							 emitTimer,
+							 (F64)(endFunctionDefIndex - beginFunctionDefIndex),
+							 "functions");
 
 	return llvmModuleSharedPtr;
 }
 
+std::shared_ptr<llvm::Module> EmitModuleContext::emitLazyCompileStubs()
+{
+	Object* intrinsicObject = Runtime::getInstanceExport(moduleInstance->compartment->wavmIntrinsics,
+														 "compileLazyFunction");
+	wavmAssert(intrinsicObject);
+	FunctionInstance* intrinsicFunction      = asFunction(intrinsicObject);
+	llvm::Constant* intrinsicFunctionPointer = emitBoundSymbol(
+		"wavmIntrinsics.compileLazyFunction",
+		asLLVMType(intrinsicFunction->type, intrinsicFunction->callingConvention)->getPointerTo());
+
+	for(Uptr functionDefIndex = beginFunctionDefIndex; functionDefIndex < endFunctionDefIndex;
+		++functionDefIndex)
+	{
+		// Give the stub the function's external name, so it is the function's code until the
+		// function is compiled.
+		FunctionType functionType
+			= module.types[module.functions.defs[functionDefIndex].type.index];
+		auto llvmFunctionType = asLLVMType(functionType, CallingConvention::wasm);
+		auto llvmFunction
+			= llvm::Function::Create(llvmFunctionType,
+									 llvm::Function::ExternalLinkage,
+									 getExternalFunctionName(moduleInstance, functionDefIndex),
+									 llvmModule);
+		llvmFunction->setCallingConv(asLLVMCallingConv(CallingConvention::wasm));
+
+		EmitContext emitContext(nullptr, nullptr);
+		emitContext.irBuilder.SetInsertPoint(
+			llvm::BasicBlock::Create(*llvmContext, "entry", llvmFunction));
+		emitContext.contextPointerVariable
+			= emitContext.irBuilder.CreateAlloca(llvmI8PtrType, nullptr, "context");
+
+		auto llvmArgIt = llvmFunction->arg_begin();
+		emitContext.irBuilder.CreateStore(&*llvmArgIt++, emitContext.contextPointerVariable);
+		std::vector<llvm::Value*> args;
+		for(; llvmArgIt != llvmFunction->arg_end(); ++llvmArgIt) { args.push_back(&*llvmArgIt); }
+
+		// Compile the function, which replaces the code pointer in its FunctionInstance. The
+		// function's index is passed along with it, so the runtime doesn't need to search for it.
+		emitContext.emitCallOrInvoke(
+			intrinsicFunctionPointer,
+			{emitBoundSymbol("functionDef" + std::to_string(functionDefIndex), llvmI64Type),
+			 emitLiteral(U64(functionDefIndex))},
+			intrinsicFunction->type,
+			intrinsicFunction->callingConvention);
+
+		// Call the compiled code, and return its results.
+		auto codeLoad = emitContext.irBuilder.CreateLoad(
+			emitBoundSymbol("functionDefCode" + std::to_string(functionDefIndex),
+							llvmFunctionType->getPointerTo()->getPointerTo()));
+		codeLoad->setAlignment(sizeof(void*));
+		codeLoad->setAtomic(llvm::AtomicOrdering::Unordered);
+		ValueVector results = emitContext.emitCallOrInvoke(
+			codeLoad, args, functionType, CallingConvention::wasm);
+		emitContext.emitReturn(functionType.results(), results);
+	}
+
+	if(emitDebugInfo) { diBuilder->finalize(); }
+	return llvmModuleSharedPtr;
+}
+
 std::shared_ptr<llvm::Module> LLVMJIT::emitModule(const Module& module,
-												  ModuleInstance* moduleInstance)
+												  ModuleInstance* moduleInstance,
+												  Uptr beginFunctionDefIndex,
+												  Uptr endFunctionDefIndex,
+												  CodeTier tier)
+{
+	return EmitModuleContext(
+			   module, moduleInstance, beginFunctionDefIndex, endFunctionDefIndex, tier)
+		.emit();
+}
+
+std::shared_ptr<llvm::Module> LLVMJIT::emitLazyCompileStubs(const Module& module,
+															ModuleInstance* moduleInstance)
+{
+	return EmitModuleContext(
+			   module, moduleInstance, 0, module.functions.defs.size(), CodeTier::baseline)
+		.emitLazyCompileStubs();
+}
+
+llvm::Constant* EmitModuleContext::emitBoundSymbol(const std::string& name, llvm::Type* type)
+{
+	// Declare the symbol as an external byte, and use its address as the bound value.
+	llvm::Constant* symbolAddress = llvmModule->getOrInsertGlobal(name, llvmI8Type);
+	if(type->isPointerTy()) { return llvm::ConstantExpr::getPointerCast(symbolAddress, type); }
+	else
+	{
+		wavmAssert(type->isIntegerTy());
+		return llvm::ConstantExpr::getPtrToInt(symbolAddress, type);
+	}
+}
+
+llvm::Constant* EmitModuleContext::emitFunctionTypeEncoding(Uptr typeIndex)
+{
+	// LLVM assumes distinct symbols have distinct addresses, so use the same symbol for all
+	// indices of equivalent types.
+	wavmAssert(typeIndex < module.types.size());
+	Uptr canonicalTypeIndex = 0;
+	while(module.types[canonicalTypeIndex] != module.types[typeIndex]) { ++canonicalTypeIndex; }
+	return emitBoundSymbol("functionType" + std::to_string(canonicalTypeIndex), llvmI8PtrType);
+}
+
+llvm::Constant* EmitModuleContext::emitExceptionTypeInstance(Uptr exceptionTypeIndex,
+															 llvm::Type* type)
+{
+	return emitBoundSymbol("exceptionType" + std::to_string(exceptionTypeIndex), type);
+}
+
+llvm::Constant* EmitModuleContext::emitMutableGlobalOffset(Uptr globalIndex)
+{
+	return emitBoundSymbol("globalOffset" + std::to_string(globalIndex), llvmI64Type);
+}
+
+// If name is prefix followed by a decimal index, writes the index to outIndex and returns true.
+static bool parseIndexedSymbolName(const char* name, const char* prefix, Uptr& outIndex)
+{
+	const Uptr numPrefixChars = strlen(prefix);
+	if(strncmp(name, prefix, numPrefixChars)) { return false; }
+
+	const char* indexString = name + numPrefixChars;
+	char* indexEnd          = nullptr;
+	const U64 index64       = std::strtoull(indexString, &indexEnd, 10);
+	if(indexEnd == indexString || *indexEnd || index64 > UINTPTR_MAX) { return false; }
+	outIndex = Uptr(index64);
+	return true;
+}
+
+bool LLVMJIT::resolveBoundSymbol(const Module& module,
+								 ModuleInstance* moduleInstance,
+								 const char* name,
+								 Uptr& outValue)
 {
-	return EmitModuleContext(module, moduleInstance).emit();
-}
\ No newline at end of file
+#if(defined(_WIN32) && !defined(_WIN64))
+	// Skip the underscore that prefixes C symbols on 32-bit Windows.
+	if(*name != '_') { return false; }
+	++name;
+#endif
+
+	const char wavmIntrinsicsPrefix[] = "wavmIntrinsics.";
+	const Uptr numWAVMIntrinsicsPrefixChars = sizeof(wavmIntrinsicsPrefix) - 1;
+
+	Uptr index;
+	if(parseIndexedSymbolName(name, "functionImport", index))
+	{
+		if(index >= module.functions.imports.size()) { return false; }
+		outValue = reinterpret_cast<Uptr>(moduleInstance->functions[index]->nativeFunction);
+	}
+	else if(parseIndexedSymbolName(name, "functionDef", index))
+	{
+		if(index >= moduleInstance->functionDefs.size()) { return false; }
+		outValue = reinterpret_cast<Uptr>(moduleInstance->functionDefs[index]);
+	}
+	else if(parseIndexedSymbolName(name, "functionDefCode", index))
+	{
+		if(index >= moduleInstance->functionDefs.size()) { return false; }
+		outValue = reinterpret_cast<Uptr>(&moduleInstance->functionDefs[index]->nativeFunction);
+	}
+	else if(parseIndexedSymbolName(name, "tierUpCounter", index))
+	{
+		if(index >= moduleInstance->functionDefs.size()) { return false; }
+		outValue = reinterpret_cast<Uptr>(getTierUpCounter(moduleInstance, index));
+	}
+	else if(parseIndexedSymbolName(name, "functionType", index))
+	{
+		if(index >= module.types.size()) { return false; }
+		outValue = reinterpret_cast<Uptr>(module.types[index].getEncoding().impl);
+	}
+	else if(parseIndexedSymbolName(name, "globalOffset", index))
+	{
+		if(index >= moduleInstance->globals.size()) { return false; }
+		const GlobalInstance* global = moduleInstance->globals[index];
+		if(!global->type.isMutable) { return false; }
+		outValue = offsetof(ContextRuntimeData, globalData) + global->mutableDataOffset;
+	}
+	else if(parseIndexedSymbolName(name, "global", index))
+	{
+		if(index >= moduleInstance->globals.size()) { return false; }
+		outValue = reinterpret_cast<Uptr>(&moduleInstance->globals[index]->initialValue);
+	}
+	else if(parseIndexedSymbolName(name, "exceptionType", index))
+	{
+		if(index >= moduleInstance->exceptionTypeInstances.size()) { return false; }
+		outValue = reinterpret_cast<Uptr>(moduleInstance->exceptionTypeInstances[index]);
+	}
+	else if(!strcmp(name, "defaultMemoryOffset"))
+	{
+		if(!moduleInstance->defaultMemory) { return false; }
+		outValue = offsetof(CompartmentRuntimeData, memories)
+				   + sizeof(U8*) * moduleInstance->defaultMemory->id;
+	}
+	else if(!strcmp(name, "defaultTableOffset"))
+	{
+		if(!moduleInstance->defaultTable) { return false; }
+		outValue = offsetof(CompartmentRuntimeData, tables)
+				   + sizeof(TableInstance::FunctionElement*) * moduleInstance->defaultTable->id;
+	}
+	else if(!strcmp(name, "userExceptionTypeInfo"))
+	{
+		outValue = reinterpret_cast<Uptr>(Platform::getUserExceptionTypeInfo());
+	}
+	else if(!strncmp(name, wavmIntrinsicsPrefix, numWAVMIntrinsicsPrefixChars))
+	{
+		Object* intrinsicObject = getInstanceExport(moduleInstance->compartment->wavmIntrinsics,
+													name + numWAVMIntrinsicsPrefixChars);
+		if(!intrinsicObject || intrinsicObject->kind != Runtime::ObjectKind::function) { return false; }
+		outValue = reinterpret_cast<Uptr>(asFunction(intrinsicObject)->nativeFunction);
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
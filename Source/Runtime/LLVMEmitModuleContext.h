@@ -15,16 +15,34 @@ namespace LLVMJIT
 		const IR::Module& module;
 		Runtime::ModuleInstance* moduleInstance;
 
+		// The range of function definitions that are emitted into this LLVM module.
+		Uptr beginFunctionDefIndex;
+		Uptr endFunctionDefIndex;
+
+		CodeTier tier;
+
 		std::shared_ptr<llvm::Module> llvmModuleSharedPtr;
 		llvm::Module* llvmModule;
 		std::vector<llvm::Function*> functionDefs;
 
+		// The debug info builder and types, which are only created if emitDebugInfo is true.
+		bool emitDebugInfo;
 		std::unique_ptr<llvm::DIBuilder> diBuilder;
 		llvm::DICompileUnit* diCompileUnit;
 		llvm::DIFile* diModuleScope;
 
 		llvm::DIType* diValueTypes[(Uptr)ValueType::num];
 
+		// The offsets of the default memory and table base pointers in the CompartmentRuntimeData,
+		// or null if the module has no default memory or table.
+		llvm::Constant* defaultMemoryOffset;
+		llvm::Constant* defaultTableOffset;
+
+		// Whether non-atomic accesses to the default memory are volatile. They are unless relaxed
+		// memory traps are enabled and the memory isn't shared, since LLVM may otherwise delete or
+		// reorder accesses that trap, or that other threads may observe.
+		bool areMemoryAccessesVolatile;
+
 		llvm::MDNode* likelyFalseBranchWeights;
 		llvm::MDNode* likelyTrueBranchWeights;
 
@@ -37,9 +55,23 @@ namespace LLVMJIT
 		llvm::Function* cxaBeginCatchFunction;
 #endif
 
-		EmitModuleContext(const Module& inModule, ModuleInstance* inModuleInstance);
+		EmitModuleContext(const Module& inModule,
+						  ModuleInstance* inModuleInstance,
+						  Uptr inBeginFunctionDefIndex,
+						  Uptr inEndFunctionDefIndex,
+						  CodeTier inTier);
 
 		std::shared_ptr<llvm::Module> emit();
+		std::shared_ptr<llvm::Module> emitLazyCompileStubs();
+
+		// Emits a reference to an external symbol that is bound to a value of the module instance
+		// when the module's object code is loaded. This keeps the object code independent of the
+		// module instance it was compiled for. The bound values must be non-zero.
+		llvm::Constant* emitBoundSymbol(const std::string& name, llvm::Type* type);
+
+		llvm::Constant* emitFunctionTypeEncoding(Uptr typeIndex);
+		llvm::Constant* emitExceptionTypeInstance(Uptr exceptionTypeIndex, llvm::Type* type);
+		llvm::Constant* emitMutableGlobalOffset(Uptr globalIndex);
 
 		inline llvm::Function* getLLVMIntrinsic(llvm::ArrayRef<llvm::Type*> typeArguments,
 												llvm::Intrinsic::ID id)
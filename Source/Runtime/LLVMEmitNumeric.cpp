@@ -266,31 +266,66 @@ EMIT_FP_BINARY_OP(le, coerceBoolToI32(irBuilder.CreateFCmpOLE(left, right)))
 EMIT_FP_BINARY_OP(gt, coerceBoolToI32(irBuilder.CreateFCmpOGT(left, right)))
 EMIT_FP_BINARY_OP(ge, coerceBoolToI32(irBuilder.CreateFCmpOGE(left, right)))
 
-// These operations don't match LLVM's semantics exactly, so just call out to C++ implementations.
-EMIT_FP_BINARY_OP(min,
-				  emitRuntimeIntrinsic(type == ValueType::f32 ? "f32.min" : "f64.min",
-									   FunctionType(TypeTuple(type), TypeTuple{type, type}),
-									   {left, right})[0])
-EMIT_FP_BINARY_OP(max,
-				  emitRuntimeIntrinsic(type == ValueType::f32 ? "f32.max" : "f64.max",
-									   FunctionType(TypeTuple(type), TypeTuple{type, type}),
-									   {left, right})[0])
-EMIT_FP_UNARY_OP(ceil,
-				 emitRuntimeIntrinsic(type == ValueType::f32 ? "f32.ceil" : "f64.ceil",
-									  FunctionType(TypeTuple(type), TypeTuple{type}),
-									  {operand})[0])
-EMIT_FP_UNARY_OP(floor,
-				 emitRuntimeIntrinsic(type == ValueType::f32 ? "f32.floor" : "f64.floor",
-									  FunctionType(TypeTuple(type), TypeTuple{type}),
-									  {operand})[0])
-EMIT_FP_UNARY_OP(trunc,
-				 emitRuntimeIntrinsic(type == ValueType::f32 ? "f32.trunc" : "f64.trunc",
-									  FunctionType(TypeTuple(type), TypeTuple{type}),
-									  {operand})[0])
-EMIT_FP_UNARY_OP(nearest,
-				 emitRuntimeIntrinsic(type == ValueType::f32 ? "f32.nearest" : "f64.nearest",
-									  FunctionType(TypeTuple(type), TypeTuple{type}),
-									  {operand})[0])
+llvm::Value* EmitFunctionContext::emitQuietNaN(ValueType type, llvm::Value* nan)
+{
+	// Set the most significant bit of the NaN's significand.
+	llvm::Type* intType = asLLVMType(type == ValueType::f32 ? ValueType::i32 : ValueType::i64);
+	llvm::Value* quietBit
+		= type == ValueType::f32 ? emitLiteral(U32(0x00400000)) : emitLiteral(U64(1) << 51);
+	return irBuilder.CreateBitCast(
+		irBuilder.CreateOr(irBuilder.CreateBitCast(nan, intType), quietBit), asLLVMType(type));
+}
+
+llvm::Value* EmitFunctionContext::emitFloatMinMax(ValueType type,
+												  bool isMax,
+												  llvm::Value* left,
+												  llvm::Value* right)
+{
+	llvm::Type* intType = asLLVMType(type == ValueType::f32 ? ValueType::i32 : ValueType::i64);
+
+	// If either operand is a NaN, return it as a quiet NaN, preferring the left operand.
+	llvm::Value* nanResult = emitQuietNaN(
+		type, irBuilder.CreateSelect(irBuilder.CreateFCmpUNO(left, left), left, right));
+
+	// If the operands are ordered and compare equal, they either have the same bits or are -0.0 and
+	// +0.0: ORing the bits gives the minimum of -0.0 and +0.0, and ANDing them gives the maximum.
+	llvm::Value* leftBits  = irBuilder.CreateBitCast(left, intType);
+	llvm::Value* rightBits = irBuilder.CreateBitCast(right, intType);
+	llvm::Value* equalResult
+		= irBuilder.CreateBitCast(isMax ? irBuilder.CreateAnd(leftBits, rightBits)
+										: irBuilder.CreateOr(leftBits, rightBits),
+								  asLLVMType(type));
+
+	llvm::Value* orderedResult = irBuilder.CreateSelect(
+		isMax ? irBuilder.CreateFCmpOGT(left, right) : irBuilder.CreateFCmpOLT(left, right),
+		left,
+		irBuilder.CreateSelect(isMax ? irBuilder.CreateFCmpOGT(right, left)
+									 : irBuilder.CreateFCmpOLT(right, left),
+							   right,
+							   equalResult));
+
+	return irBuilder.CreateSelect(irBuilder.CreateFCmpUNO(left, right), nanResult, orderedResult);
+}
+
+llvm::Value* EmitFunctionContext::emitFloatRound(ValueType type,
+												 llvm::Intrinsic::ID intrinsicId,
+												 llvm::Value* operand)
+{
+	// The LLVM rounding intrinsics lower to a single roundss/roundsd on targets with SSE4.1, but
+	// LLVM doesn't guarantee that they quiet a signaling NaN operand, so do that explicitly.
+	return irBuilder.CreateSelect(irBuilder.CreateFCmpUNO(operand, operand),
+								  emitQuietNaN(type, operand),
+								  callLLVMIntrinsic({operand->getType()}, intrinsicId, {operand}));
+}
+
+// LLVM's minnum/maxnum don't propagate NaNs or order -0.0 and +0.0 the way WebAssembly requires, so
+// min and max are emitted as explicit comparisons.
+EMIT_FP_BINARY_OP(min, emitFloatMinMax(type, false, left, right))
+EMIT_FP_BINARY_OP(max, emitFloatMinMax(type, true, left, right))
+EMIT_FP_UNARY_OP(ceil, emitFloatRound(type, llvm::Intrinsic::ceil, operand))
+EMIT_FP_UNARY_OP(floor, emitFloatRound(type, llvm::Intrinsic::floor, operand))
+EMIT_FP_UNARY_OP(trunc, emitFloatRound(type, llvm::Intrinsic::trunc, operand))
+EMIT_FP_UNARY_OP(nearest, emitFloatRound(type, llvm::Intrinsic::nearbyint, operand))
 
 llvm::Value* EmitFunctionContext::emitAnyTrue(llvm::Value* boolVector)
 {
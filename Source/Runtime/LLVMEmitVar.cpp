@@ -45,33 +45,49 @@ void EmitFunctionContext::get_global(GetOrSetVariableImm<true> imm)
 	{
 		llvm::Value* globalPointer = irBuilder.CreatePointerCast(
 			irBuilder.CreateInBoundsGEP(irBuilder.CreateLoad(contextPointerVariable),
-										{emitLiteral(Uptr(offsetof(ContextRuntimeData, globalData))
-													 + global->mutableDataOffset)}),
+										{moduleContext.emitMutableGlobalOffset(imm.variableIndex)}),
 			llvmValueType->getPointerTo());
 		push(irBuilder.CreateLoad(globalPointer));
+		return;
 	}
-	else
+
+	// If the global is defined by this module with a constant initializer, its value doesn't
+	// depend on the module instance, and can be emitted as a literal.
+	if(imm.variableIndex >= module.globals.imports.size())
 	{
-		if(getTypeByteWidth(global->type.valueType) > sizeof(void*))
+		const GlobalDef& globalDef
+			= module.globals.defs[imm.variableIndex - module.globals.imports.size()];
+		llvm::Constant* immutableValue = nullptr;
+		switch(globalDef.initializer.type)
 		{
-			llvm::Value* globalPointer
-				= emitLiteralPointer(&global->initialValue, llvmValueType->getPointerTo());
-			push(irBuilder.CreateLoad(globalPointer));
-		}
-		else
+		case InitializerExpression::Type::i32_const:
+			immutableValue = emitLiteral(globalDef.initializer.i32);
+			break;
+		case InitializerExpression::Type::i64_const:
+			immutableValue = emitLiteral(globalDef.initializer.i64);
+			break;
+		case InitializerExpression::Type::f32_const:
+			immutableValue = emitLiteral(globalDef.initializer.f32);
+			break;
+		case InitializerExpression::Type::f64_const:
+			immutableValue = emitLiteral(globalDef.initializer.f64);
+			break;
+		default: break;
+		};
+		if(immutableValue)
 		{
-			llvm::Constant* immutableValue;
-			switch(global->type.valueType)
-			{
-			case ValueType::i32: immutableValue = emitLiteral(global->initialValue.i32); break;
-			case ValueType::i64: immutableValue = emitLiteral(global->initialValue.i64); break;
-			case ValueType::f32: immutableValue = emitLiteral(global->initialValue.f32); break;
-			case ValueType::f64: immutableValue = emitLiteral(global->initialValue.f64); break;
-			default: Errors::unreachable();
-			};
 			push(immutableValue);
+			return;
 		}
 	}
+
+	// Otherwise, load the value from the global instance, which is bound to the code when it is
+	// loaded. The value never changes, so the load may be freely hoisted or combined.
+	auto load = irBuilder.CreateLoad(
+		moduleContext.emitBoundSymbol("global" + std::to_string(imm.variableIndex),
+									  llvmValueType->getPointerTo()));
+	load->setMetadata(llvm::LLVMContext::MD_invariant_load, llvm::MDNode::get(*llvmContext, {}));
+	push(load);
 }
 void EmitFunctionContext::set_global(GetOrSetVariableImm<true> imm)
 {
@@ -81,8 +97,7 @@ void EmitFunctionContext::set_global(GetOrSetVariableImm<true> imm)
 	llvm::Type* llvmValueType  = asLLVMType(global->type.valueType);
 	llvm::Value* globalPointer = irBuilder.CreatePointerCast(
 		irBuilder.CreateInBoundsGEP(irBuilder.CreateLoad(contextPointerVariable),
-									{emitLiteral(Uptr(offsetof(ContextRuntimeData, globalData)
-													  + global->mutableDataOffset))}),
+									{moduleContext.emitMutableGlobalOffset(imm.variableIndex)}),
 		llvmValueType->getPointerTo());
 	auto value = irBuilder.CreateBitCast(pop(), llvmValueType);
 	irBuilder.CreateStore(value, globalPointer);
@@ -2,23 +2,30 @@
 #include "Inline/Assert.h"
 #include "Inline/BasicTypes.h"
 #include "Inline/HashMap.h"
+#include "Inline/HashSet.h"
 #include "Inline/Lock.h"
 #include "Inline/Timing.h"
 #include "Logging/Logging.h"
 #include "RuntimePrivate.h"
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <inttypes.h>
+#include <stdio.h>
+
 #include "LLVMPreInclude.h"
 
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Analysis/Passes.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/DebugInfo/DIContext.h"
 #include "llvm/DebugInfo/DWARF/DWARFContext.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/JITEventListener.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
-#include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
-#include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
-#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/ExecutionEngine/RuntimeDyld.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DebugLoc.h"
 #include "llvm/IR/LegacyPassManager.h"
@@ -29,7 +36,10 @@
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/Memory.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "llvm/Transforms/Scalar.h"
 
 #if PRINT_DISASSEMBLY
@@ -51,49 +61,332 @@
 using namespace IR;
 using namespace LLVMJIT;
 
-llvm::LLVMContext* LLVMJIT::llvmContext = nullptr;
-llvm::Type* LLVMJIT::llvmValueTypes[(Uptr)ValueType::num];
-
-llvm::Type* LLVMJIT::llvmI8Type;
-llvm::Type* LLVMJIT::llvmI16Type;
-llvm::Type* LLVMJIT::llvmI32Type;
-llvm::Type* LLVMJIT::llvmI64Type;
-llvm::Type* LLVMJIT::llvmF32Type;
-llvm::Type* LLVMJIT::llvmF64Type;
-llvm::Type* LLVMJIT::llvmVoidType;
-llvm::Type* LLVMJIT::llvmBoolType;
-llvm::Type* LLVMJIT::llvmI8PtrType;
-
-llvm::Type* LLVMJIT::llvmI8x16Type;
-llvm::Type* LLVMJIT::llvmI16x8Type;
-llvm::Type* LLVMJIT::llvmI32x4Type;
-llvm::Type* LLVMJIT::llvmI64x2Type;
-llvm::Type* LLVMJIT::llvmF32x4Type;
-llvm::Type* LLVMJIT::llvmF64x2Type;
+thread_local llvm::LLVMContext* LLVMJIT::llvmContext = nullptr;
+thread_local llvm::Type* LLVMJIT::llvmValueTypes[(Uptr)ValueType::num];
+
+thread_local llvm::Type* LLVMJIT::llvmI8Type;
+thread_local llvm::Type* LLVMJIT::llvmI16Type;
+thread_local llvm::Type* LLVMJIT::llvmI32Type;
+thread_local llvm::Type* LLVMJIT::llvmI64Type;
+thread_local llvm::Type* LLVMJIT::llvmF32Type;
+thread_local llvm::Type* LLVMJIT::llvmF64Type;
+thread_local llvm::Type* LLVMJIT::llvmVoidType;
+thread_local llvm::Type* LLVMJIT::llvmBoolType;
+thread_local llvm::Type* LLVMJIT::llvmI8PtrType;
+
+thread_local llvm::Type* LLVMJIT::llvmI8x16Type;
+thread_local llvm::Type* LLVMJIT::llvmI16x8Type;
+thread_local llvm::Type* LLVMJIT::llvmI32x4Type;
+thread_local llvm::Type* LLVMJIT::llvmI64x2Type;
+thread_local llvm::Type* LLVMJIT::llvmF32x4Type;
+thread_local llvm::Type* LLVMJIT::llvmF64x2Type;
 
 #if defined(_WIN64)
-llvm::Type* LLVMJIT::llvmExceptionPointersStructType;
+thread_local llvm::Type* LLVMJIT::llvmExceptionPointersStructType;
 #endif
 
-llvm::Constant* LLVMJIT::typedZeroConstants[(Uptr)ValueType::num];
+thread_local llvm::Constant* LLVMJIT::typedZeroConstants[(Uptr)ValueType::num];
 
-static Platform::Mutex llvmMutex;
+// The target machine used by the current thread.
+static thread_local llvm::TargetMachine* targetMachine = nullptr;
 
-static llvm::TargetMachine* targetMachine = nullptr;
+// Guards the one-time initialization of LLVM's target and GDB registration listener.
+static Platform::Mutex llvmInitMutex;
+static bool isLLVMInitialized = false;
 
 static llvm::JITEventListener* gdbRegistrationListener = nullptr;
 
-// A map from address to loaded JIT symbols.
-static Platform::Mutex addressToSymbolMapMutex;
-static std::map<Uptr, struct JITSymbol*> addressToSymbolMap;
+// Whether loaded objects are registered with GDB's JIT interface. Registering an object adds it to
+// a global list that gets slower to update as it grows, so it's only enabled by default in debug
+// builds.
+static std::atomic<bool> isGDBRegistrationEnabled(WAVM_DEBUG ? true : false);
+
+// The maximum number of threads used to compile a module. 0 means one per hardware thread.
+static std::atomic<Uptr> maxCompileThreads(0);
+
+// Modules with fewer function definitions than this per thread aren't worth splitting.
+enum
+{
+	minFunctionDefsPerPartition = 16
+};
+
+// LLVM uses a lot of stack for deeply nested code, so give compile threads a generous stack.
+enum
+{
+	compileThreadNumStackBytes = 8 * 1024 * 1024
+};
+
+// Whether modules are compiled at the baseline tier, with hot functions recompiled at the optimized
+// tier in the background.
+static std::atomic<bool> isTieredCompilationEnabled(false);
+
+// Whether module functions are compiled the first time they are called, instead of when the module
+// is instantiated.
+static std::atomic<bool> isLazyCompilationEnabled(false);
+
+// Whether emitted code includes DWARF debug info that maps machine code to WebAssembly op indices.
+static std::atomic<bool> isDebugInfoEnabledFlag(true);
+
+// Whether loads and stores of unshared memories are emitted as non-volatile accesses.
+static std::atomic<bool> areMemoryTrapsRelaxedFlag(false);
+
+// The number of calls and loop iterations after which baseline tier code for a function requests
+// that it be recompiled at the optimized tier.
+enum
+{
+	tierUpThreshold = 10000
+};
+
+// The maximum number of bytes of object code kept in memory for reuse by later instantiations of
+// the same module.
+enum
+{
+	maxCompiledModuleCacheBytes = 256 * 1024 * 1024
+};
+
+// The object code compiled for recently instantiated modules, ordered from least to most recently
+// used.
+static Platform::Mutex compiledModuleCacheMutex;
+static std::vector<std::shared_ptr<struct CompiledModule>> compiledModuleCache;
+static Uptr numCompiledModuleCacheBytes = 0;
+
+// Maps offsets in a function's machine code to the index of the WebAssembly op they were compiled
+// from, sorted by offset.
+typedef std::vector<std::pair<U32, U32>> OffsetToOpIndexTable;
+
+// The address range of a loaded JIT symbol.
+struct JITSymbolTableEntry
+{
+	Uptr endAddress;
+	struct JITSymbol* symbol;
+};
+
+// The loaded JIT symbols, sorted by end address. A published table is never modified: adding or
+// removing symbols publishes a new copy of the table, so threads can look up symbols without taking
+// a lock (see JITSymbolTableReadScope).
+static Platform::Mutex jitSymbolTableUpdateMutex;
+static std::atomic<const std::vector<JITSymbolTableEntry>*> jitSymbolTable(nullptr);
+
+// Readers of the JIT symbol table count themselves in the counter for the current epoch. Replacing
+// the table advances the epoch, and waits for the readers counted in the previous epoch, which may
+// be using the old table, before freeing it.
+static std::atomic<U64> jitSymbolTableEpoch(0);
+static std::atomic<Uptr> jitSymbolTableNumReaders[2];
+
+// Guards the thunk caches, and the LLVM state used to compile thunks.
+static Platform::Mutex thunkMutex;
+static struct LLVMThreadState* thunkLLVMState = nullptr;
 
 // A map from function types to JIT symbols for cached invoke thunks (C++ -> WASM)
 static HashMap<FunctionType, struct JITSymbol*> invokeThunkTypeToSymbolMap;
 
-// A map from function types to JIT symbols for cached native thunks (WASM -> C++)
+// A map from function types and calling conventions to JIT symbols for cached batch invoke thunks
+// (C++ -> WASM)
+static std::map<std::pair<Uptr, CallingConvention>, struct JITSymbol*>
+	invokeBatchThunkTypeToSymbolMap;
+
+// A map from function types and calling conventions to JIT symbols for cached typed invoke thunks
+// (C++ -> WASM)
+static std::map<std::pair<Uptr, CallingConvention>, struct JITSymbol*>
+	typedInvokeThunkTypeToSymbolMap;
+
+// A map from native functions to JIT symbols for cached intrinsic thunks (WASM -> C++)
 static HashMap<void*, struct JITSymbol*> intrinsicFunctionToThunkSymbolMap;
 
 static void initLLVM();
+static void initLLVMTypes();
+
+// The LLVM context and target machine used to emit and compile code on a thread. LLVM contexts
+// aren't thread-safe, so each compile thread creates its own.
+struct LLVMThreadState
+{
+	llvm::LLVMContext* context;
+	llvm::TargetMachine* targetMachine;
+
+	LLVMThreadState();
+	~LLVMThreadState();
+
+	LLVMThreadState(const LLVMThreadState&) = delete;
+	void operator=(const LLVMThreadState&) = delete;
+};
+
+// Binds a LLVMThreadState to the current thread for the lifetime of the scope.
+struct LLVMThreadStateScope
+{
+	LLVMThreadStateScope(LLVMThreadState& state)
+	: savedContext(llvmContext), savedTargetMachine(targetMachine)
+	{
+		bind(state.context, state.targetMachine);
+	}
+	~LLVMThreadStateScope() { bind(savedContext, savedTargetMachine); }
+
+private:
+	llvm::LLVMContext* savedContext;
+	llvm::TargetMachine* savedTargetMachine;
+
+	static void bind(llvm::LLVMContext* context, llvm::TargetMachine* inTargetMachine)
+	{
+		llvmContext   = context;
+		targetMachine = inTargetMachine;
+		initLLVMTypes();
+	}
+};
+
+// A thread with a stack large enough for LLVM that runs compile jobs queued by other threads, in
+// the order they were queued. The thread is started when a job is queued, and exits when it has
+// been idle for idleTimeoutMicroseconds, or when it is shut down.
+struct CompileThread
+{
+	CompileThread()
+	: numPendingJobs(0), thread(nullptr), isThreadRunning(false), isShuttingDown(false)
+	{
+	}
+
+	// Queues a job to run on the thread.
+	void queueJob(std::function<void()>&& job)
+	{
+		Lock<Platform::Mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+		++numPendingJobs;
+		if(isThreadRunning) { wakeEvent.signal(); }
+		else
+		{
+			// Join the thread that exited when it was idle before starting a new one.
+			if(thread) { Platform::joinThread(thread); }
+			isThreadRunning = true;
+			thread = Platform::createThread(compileThreadNumStackBytes, threadEntry, this);
+		}
+	}
+
+	// Runs a job on the thread, and waits for it to complete.
+	void runJob(const std::function<void()>& job)
+	{
+		// The completion state is shared with the job, since the job may still be signaling the
+		// event after this thread has seen that it completed.
+		struct Completion
+		{
+			std::atomic<bool> isComplete;
+			Platform::Event event;
+
+			Completion() : isComplete(false) {}
+		};
+		auto completion = std::make_shared<Completion>();
+		queueJob([job, completion]() {
+			job();
+			completion->isComplete = true;
+			completion->event.signal();
+		});
+		while(!completion->isComplete)
+		{ completion->event.wait(Platform::getMonotonicClock() + pollMicroseconds); }
+	}
+
+	// Waits until the thread has run all the jobs that were queued.
+	void waitUntilIdle()
+	{
+		while(true)
+		{
+			{
+				Lock<Platform::Mutex> lock(mutex);
+				if(!numPendingJobs) { return; }
+			}
+			idleEvent.wait(Platform::getMonotonicClock() + pollMicroseconds);
+		}
+	}
+
+	// Runs the jobs that were queued, and waits for the thread to exit.
+	void shutdown()
+	{
+		Platform::Thread* exitingThread;
+		{
+			Lock<Platform::Mutex> lock(mutex);
+			isShuttingDown = true;
+			exitingThread  = thread;
+			thread         = nullptr;
+		}
+		if(exitingThread)
+		{
+			wakeEvent.signal();
+			Platform::joinThread(exitingThread);
+		}
+
+		Lock<Platform::Mutex> lock(mutex);
+		isShuttingDown = false;
+	}
+
+private:
+	// Events may be signaled while no thread is waiting for them, so waiters poll the state they
+	// are waiting for as well.
+	enum
+	{
+		pollMicroseconds        = 10000,
+		idleTimeoutMicroseconds = 1000000
+	};
+
+	Platform::Mutex mutex;
+	Platform::Event wakeEvent;
+	Platform::Event idleEvent;
+	std::vector<std::function<void()>> jobs;
+	Uptr numPendingJobs;
+	Platform::Thread* thread;
+	bool isThreadRunning;
+	bool isShuttingDown;
+
+	static I64 threadEntry(void* compileThreadVoid)
+	{
+		CompileThread* compileThread = (CompileThread*)compileThreadVoid;
+
+		LLVMThreadState threadState;
+		LLVMThreadStateScope threadStateScope(threadState);
+		U64 idleStartClock = Platform::getMonotonicClock();
+		while(true)
+		{
+			std::function<void()> job;
+			{
+				Lock<Platform::Mutex> lock(compileThread->mutex);
+				const U64 idleEndClock = idleStartClock + idleTimeoutMicroseconds;
+				if(compileThread->jobs.size())
+				{
+					job = std::move(compileThread->jobs.front());
+					compileThread->jobs.erase(compileThread->jobs.begin());
+				}
+				else if(compileThread->isShuttingDown
+						|| Platform::getMonotonicClock() >= idleEndClock)
+				{
+					compileThread->isThreadRunning = false;
+					return 0;
+				}
+			}
+
+			if(!job)
+			{
+				compileThread->wakeEvent.wait(Platform::getMonotonicClock() + pollMicroseconds);
+				continue;
+			}
+
+			job();
+			{
+				Lock<Platform::Mutex> lock(compileThread->mutex);
+				--compileThread->numPendingJobs;
+			}
+			compileThread->idleEvent.signal();
+			idleStartClock = Platform::getMonotonicClock();
+		}
+	}
+
+	CompileThread(const CompileThread&) = delete;
+	void operator=(const CompileThread&) = delete;
+};
+
+// The thread that recompiles functions at the optimized tier, and the number of functions it has
+// recompiled. The thread is never deleted, so it outlives any jobs still running when the process
+// exits.
+static CompileThread* const tierUpThread = new CompileThread();
+static std::atomic<Uptr> numTieredUpFunctions(0);
+
+// The thread that lazily compiles functions. WebAssembly code that calls a function that hasn't
+// been compiled may not have enough stack left for LLVM, so it waits while this thread compiles
+// the function.
+static CompileThread* const lazyCompileThread = new CompileThread();
 
 // Information about a JIT symbol, used to map instruction pointers to descriptive names.
 struct JITSymbol
@@ -111,69 +404,208 @@ struct JITSymbol
 	};
 	Uptr baseAddress;
 	Uptr numBytes;
-	std::map<U32, U32> offsetToOpIndexMap;
+	OffsetToOpIndexTable offsetToOpIndexTable;
 
 	JITSymbol(FunctionInstance* inFunctionInstance,
 			  Uptr inBaseAddress,
 			  Uptr inNumBytes,
-			  std::map<U32, U32>&& inOffsetToOpIndexMap)
+			  OffsetToOpIndexTable&& inOffsetToOpIndexTable)
 	: type(Type::functionInstance)
 	, functionInstance(inFunctionInstance)
 	, baseAddress(inBaseAddress)
 	, numBytes(inNumBytes)
-	, offsetToOpIndexMap(inOffsetToOpIndexMap)
+	, offsetToOpIndexTable(std::move(inOffsetToOpIndexTable))
 	{
 	}
 
 	JITSymbol(FunctionType inInvokeThunkType,
 			  Uptr inBaseAddress,
 			  Uptr inNumBytes,
-			  std::map<U32, U32>&& inOffsetToOpIndexMap)
+			  OffsetToOpIndexTable&& inOffsetToOpIndexTable)
 	: type(Type::invokeThunk)
 	, invokeThunkType(inInvokeThunkType)
 	, baseAddress(inBaseAddress)
 	, numBytes(inNumBytes)
-	, offsetToOpIndexMap(inOffsetToOpIndexMap)
+	, offsetToOpIndexTable(std::move(inOffsetToOpIndexTable))
 	{
 	}
 };
 
-// Allocates memory for the LLVM object loader.
-struct UnitMemoryManager : llvm::RTDyldMemoryManager
+// Whether to write a perf map file, which the Linux perf tool uses to name JIT compiled code.
+static std::atomic<bool> isPerfMapEnabled(false);
+
+// Guards the perf map file, which is opened when the first symbols are written to it. If opening
+// or writing the file fails, the perf map is disabled for the rest of the process.
+static Platform::Mutex perfMapMutex;
+static Platform::File* perfMapFile = nullptr;
+static bool hasPerfMapFailed       = false;
+
+// Returns the name that a JIT symbol is given in the perf map.
+static std::string getPerfMapSymbolName(const JITSymbol* symbol)
+{
+	switch(symbol->type)
+	{
+	case JITSymbol::Type::functionInstance:
+		return "wasm!" + symbol->functionInstance->moduleInstance->debugName + '!'
+			   + symbol->functionInstance->debugName;
+	case JITSymbol::Type::invokeThunk: return "thnk!" + asString(symbol->invokeThunkType);
+	default: Errors::unreachable();
+	};
+}
+
+// Appends a line for each of a batch of JIT symbols to /tmp/perf-<pid>.map, with a single write.
+// perf only reads the file after the process exits, so the writes aren't flushed to disk. The perf
+// map format can't express that a symbol was unloaded, so if its address range is reused, perf may
+// use either symbol's name for it.
+static void writePerfMapSymbols(const std::vector<JITSymbol*>& symbols)
+{
+	std::string lines;
+	for(const JITSymbol* symbol : symbols)
+	{
+		char addressRange[64];
+		snprintf(addressRange,
+				 sizeof(addressRange),
+				 "%" PRIxPTR " %" PRIxPTR " ",
+				 symbol->baseAddress,
+				 symbol->numBytes);
+		lines += addressRange;
+		lines += getPerfMapSymbolName(symbol);
+		lines += '\n';
+	}
+
+	Lock<Platform::Mutex> perfMapLock(perfMapMutex);
+	if(hasPerfMapFailed) { return; }
+
+	const std::string perfMapPath
+		= "/tmp/perf-" + std::to_string(Platform::getProcessId()) + ".map";
+	if(!perfMapFile)
+	{
+		perfMapFile = Platform::openFile(perfMapPath,
+										 Platform::FileAccessMode::writeOnly,
+										 Platform::FileCreateMode::createAlways);
+		if(!perfMapFile)
+		{
+			Log::printf(Log::error, "Couldn't create perf map file %s\n", perfMapPath.c_str());
+			hasPerfMapFailed = true;
+			return;
+		}
+	}
+
+	if(!Platform::writeFile(perfMapFile, (const U8*)lines.data(), lines.size()))
+	{
+		Log::printf(Log::error,
+					"Couldn't write to perf map file %s; no more symbols will be written to it\n",
+					perfMapPath.c_str());
+		Platform::closeFile(perfMapFile);
+		perfMapFile      = nullptr;
+		hasPerfMapFailed = true;
+	}
+}
+
+// Gives the current thread access to the JIT symbol table for the lifetime of the scope. The table
+// won't be freed until the scope ends, even if it is replaced.
+struct JITSymbolTableReadScope
+{
+	const std::vector<JITSymbolTableEntry>* table;
+
+	JITSymbolTableReadScope()
+	{
+		while(true)
+		{
+			epochIndex = jitSymbolTableEpoch.load() & 1;
+			++jitSymbolTableNumReaders[epochIndex];
+
+			// If the epoch changed before this reader was counted, the writer may not be waiting
+			// for it, so retry with the new epoch.
+			if((jitSymbolTableEpoch.load() & 1) == epochIndex) { break; }
+			--jitSymbolTableNumReaders[epochIndex];
+		}
+
+		table = jitSymbolTable.load();
+	}
+
+	~JITSymbolTableReadScope() { --jitSymbolTableNumReaders[epochIndex]; }
+
+	JITSymbolTableReadScope(const JITSymbolTableReadScope&) = delete;
+	void operator=(const JITSymbolTableReadScope&) = delete;
+
+private:
+	Uptr epochIndex;
+};
+
+// Publishes a new JIT symbol table with some symbols added and removed. Once it returns, no thread
+// is using the removed symbols, so they may be deleted.
+static void updateJITSymbolTable(const std::vector<JITSymbol*>& addedSymbols,
+								 const std::vector<JITSymbol*>& removedSymbols)
 {
-	UnitMemoryManager()
-	: imageBaseAddress(nullptr)
-	, isFinalized(false)
-	, codeSection({0})
-	, readOnlySection({0})
-	, readWriteSection({0})
-	, hasRegisteredEHFrames(false)
+	if(!addedSymbols.size() && !removedSymbols.size()) { return; }
+
+	Lock<Platform::Mutex> updateLock(jitSymbolTableUpdateMutex);
+
+	// Copy the old table, minus the removed symbols, and plus the added symbols.
+	const std::vector<JITSymbolTableEntry>* oldTable = jitSymbolTable.load();
+	auto newTable = new std::vector<JITSymbolTableEntry>;
+	newTable->reserve((oldTable ? oldTable->size() : 0) + addedSymbols.size());
+	if(oldTable)
 	{
+		HashSet<JITSymbol*> removedSymbolSet;
+		for(JITSymbol* symbol : removedSymbols) { removedSymbolSet.add(symbol); }
+		for(const JITSymbolTableEntry& entry : *oldTable)
+		{
+			if(!removedSymbolSet.contains(entry.symbol)) { newTable->push_back(entry); }
+		}
 	}
+	for(JITSymbol* symbol : addedSymbols)
+	{ newTable->push_back({symbol->baseAddress + symbol->numBytes, symbol}); }
+	std::sort(newTable->begin(),
+			  newTable->end(),
+			  [](const JITSymbolTableEntry& a, const JITSymbolTableEntry& b) {
+				  return a.endAddress < b.endAddress;
+			  });
+
+	// Publish the new table, and advance the epoch so new readers are counted separately from
+	// those that may be using the old table.
+	jitSymbolTable.store(newTable);
+	const Uptr oldEpochIndex = jitSymbolTableEpoch++ & 1;
+
+	// Wait until there are no readers that may be using the old table, and free it.
+	while(jitSymbolTableNumReaders[oldEpochIndex].load()) { Platform::yieldToAnotherThread(); }
+	delete oldTable;
+}
+
+// Adds JIT symbols to the global symbol table, and to the perf map if it is enabled.
+static void addJITSymbols(const std::vector<JITSymbol*>& symbols)
+{
+	updateJITSymbolTable(symbols, {});
+
+	if(isPerfMapEnabled && symbols.size()) { writePerfMapSymbols(symbols); }
+}
+static void addJITSymbol(JITSymbol* symbol) { addJITSymbols({symbol}); }
+
+// Allocates memory for the LLVM object loader. Each object loaded by a unit reserves its own image,
+// so a unit may be made up of several objects that were compiled independently.
+struct UnitMemoryManager : llvm::RTDyldMemoryManager
+{
+	UnitMemoryManager() : isFinalized(false) {}
 	virtual ~UnitMemoryManager() override
 	{
 		// Deregister the exception handling frame info.
 		deregisterEHFrames();
 
-		// Decommit the image pages, but leave them reserved to catch any references to them that
-		// might erroneously remain.
-		Platform::decommitVirtualPages(imageBaseAddress, numAllocatedImagePages);
+		// Free the image memory.
+		for(const Image& image : images) { freeJITMemory(image.reservation); }
 	}
 
 	void registerEHFrames(U8* addr, U64 loadAddr, uintptr_t numBytes) override
 	{
 		Platform::registerEHFrames(addr, numBytes);
-		hasRegisteredEHFrames = true;
-		ehFramesAddr          = addr;
-		ehFramesNumBytes      = numBytes;
+		registeredEHFrames.push_back({addr, Uptr(numBytes)});
 	}
 	void deregisterEHFrames() override
 	{
-		if(hasRegisteredEHFrames)
-		{
-			hasRegisteredEHFrames = false;
-			Platform::deregisterEHFrames(ehFramesAddr, ehFramesNumBytes);
-		}
+		for(const EHFrames& ehFrames : registeredEHFrames)
+		{ Platform::deregisterEHFrames(ehFrames.address, ehFrames.numBytes); }
+		registeredEHFrames.clear();
 	}
 
 	virtual bool needsToReserveAllocationSpace() override { return true; }
@@ -184,36 +616,32 @@ struct UnitMemoryManager : llvm::RTDyldMemoryManager
 										uintptr_t numReadWriteBytes,
 										U32 readWriteAlignment) override
 	{
+		wavmAssert(!isFinalized);
+
 		// Pad the code section to allow for the SEH trampoline.
 		numCodeBytes += 32;
 
-		// Calculate the number of pages to be used by each section.
-		codeSection.numPages      = shrAndRoundUp(numCodeBytes, Platform::getPageSizeLog2());
-		readOnlySection.numPages  = shrAndRoundUp(numReadOnlyBytes, Platform::getPageSizeLog2());
-		readWriteSection.numPages = shrAndRoundUp(numReadWriteBytes, Platform::getPageSizeLog2());
-		numAllocatedImagePages
-			= codeSection.numPages + readOnlySection.numPages + readWriteSection.numPages;
-		if(numAllocatedImagePages)
-		{
-			// Reserve enough contiguous pages for all sections.
-			imageBaseAddress = Platform::allocateVirtualPages(numAllocatedImagePages);
-			if(!imageBaseAddress
-			   || !Platform::commitVirtualPages(imageBaseAddress, numAllocatedImagePages))
-			{ Errors::fatal("memory allocation for JIT code failed"); }
-			codeSection.baseAddress = imageBaseAddress;
-			readOnlySection.baseAddress
-				= codeSection.baseAddress + (codeSection.numPages << Platform::getPageSizeLog2());
-			readWriteSection.baseAddress
-				= readOnlySection.baseAddress
-				  + (readOnlySection.numPages << Platform::getPageSizeLog2());
-		}
+		// Reserve memory for all the sections from the JIT's shared code regions.
+		Image image;
+		image.reservation = reserveJITMemory(openPages,
+											 numCodeBytes,
+											 codeAlignment,
+											 numReadOnlyBytes,
+											 readOnlyAlignment,
+											 numReadWriteBytes,
+											 readWriteAlignment);
+		image.codeSection      = {image.reservation.codeAddress, numCodeBytes, 0};
+		image.readOnlySection  = {image.reservation.readOnlyAddress, numReadOnlyBytes, 0};
+		image.readWriteSection = {image.reservation.readWriteAddress, numReadWriteBytes, 0};
+		images.push_back(image);
 	}
 	virtual U8* allocateCodeSection(uintptr_t numBytes,
 									U32 alignment,
 									U32 sectionID,
 									llvm::StringRef sectionName) override
 	{
-		return allocateBytes((Uptr)numBytes, alignment, codeSection);
+		wavmAssert(images.size());
+		return allocateBytes((Uptr)numBytes, alignment, images.back().codeSection);
 	}
 	virtual U8* allocateDataSection(uintptr_t numBytes,
 									U32 alignment,
@@ -221,8 +649,11 @@ struct UnitMemoryManager : llvm::RTDyldMemoryManager
 									llvm::StringRef SectionName,
 									bool isReadOnly) override
 	{
-		return allocateBytes(
-			(Uptr)numBytes, alignment, isReadOnly ? readOnlySection : readWriteSection);
+		wavmAssert(images.size());
+		return allocateBytes((Uptr)numBytes,
+							 alignment,
+							 isReadOnly ? images.back().readOnlySection
+										: images.back().readWriteSection);
 	}
 	virtual bool finalizeMemory(std::string* ErrMsg = nullptr) override
 	{
@@ -234,56 +665,55 @@ struct UnitMemoryManager : llvm::RTDyldMemoryManager
 	void reallyFinalizeMemory()
 	{
 		wavmAssert(!isFinalized);
-		isFinalized                             = true;
-		const Platform::MemoryAccess codeAccess = USE_WRITEABLE_JIT_CODE_PAGES
-													  ? Platform::MemoryAccess::readWriteExecute
-													  : Platform::MemoryAccess::execute;
-		if(codeSection.numPages)
-		{
-			errorUnless(Platform::setVirtualPageAccess(
-				codeSection.baseAddress, codeSection.numPages, codeAccess));
-		}
-		if(readOnlySection.numPages)
-		{
-			errorUnless(Platform::setVirtualPageAccess(readOnlySection.baseAddress,
-													   readOnlySection.numPages,
-													   Platform::MemoryAccess::readOnly));
-		}
-		if(readWriteSection.numPages)
-		{
-			errorUnless(Platform::setVirtualPageAccess(readWriteSection.baseAddress,
-													   readWriteSection.numPages,
-													   Platform::MemoryAccess::readWrite));
-		}
+		isFinalized = true;
+		for(const Image& image : images)
+		{ finalizeJITMemory(image.reservation, USE_WRITEABLE_JIT_CODE_PAGES); }
 	}
 	virtual void invalidateInstructionCache()
 	{
-		// Invalidate the instruction cache for the whole image.
-		llvm::sys::Memory::InvalidateInstructionCache(
-			imageBaseAddress, numAllocatedImagePages << Platform::getPageSizeLog2());
+		// Invalidate the instruction cache for all the images' code.
+		for(const Image& image : images)
+		{
+			llvm::sys::Memory::InvalidateInstructionCache(image.reservation.codeAddress,
+														  image.reservation.numCodeBytes);
+		}
 	}
 
-	U8* getImageBaseAddress() const { return imageBaseAddress; }
+	// Returns the base address of the image reserved for the most recently loaded object. The
+	// object's sections are all within the code region that starts at the returned address.
+	U8* getImageBaseAddress() const
+	{
+		return images.size() ? getJITMemoryRegionBaseAddress(images.back().reservation) : nullptr;
+	}
 
 private:
 	struct Section
 	{
 		U8* baseAddress;
-		Uptr numPages;
+		Uptr numBytes;
 		Uptr numCommittedBytes;
 	};
 
-	U8* imageBaseAddress;
-	Uptr numAllocatedImagePages;
-	bool isFinalized;
+	struct Image
+	{
+		JITMemoryReservation reservation;
+
+		Section codeSection;
+		Section readOnlySection;
+		Section readWriteSection;
+	};
+
+	struct EHFrames
+	{
+		U8* address;
+		Uptr numBytes;
+	};
 
-	Section codeSection;
-	Section readOnlySection;
-	Section readWriteSection;
+	std::vector<Image> images;
+	JITMemoryOpenPages openPages;
+	bool isFinalized;
 
-	bool hasRegisteredEHFrames;
-	U8* ehFramesAddr;
-	Uptr ehFramesNumBytes;
+	std::vector<EHFrames> registeredEHFrames;
 
 	U8* allocateBytes(Uptr numBytes, Uptr alignment, Section& section)
 	{
@@ -299,7 +729,7 @@ private:
 			= align(section.numCommittedBytes, alignment) + align(numBytes, alignment);
 
 		// Check that enough space was reserved in the section.
-		if(section.numCommittedBytes > (section.numPages << Platform::getPageSizeLog2()))
+		if(section.numCommittedBytes > section.numBytes)
 		{ Errors::fatal("didn't reserve enough space in section"); }
 
 		return allocationBaseAddress;
@@ -309,10 +739,6 @@ private:
 	{
 		return (size + alignment - 1) & ~(alignment - 1);
 	}
-	static Uptr shrAndRoundUp(Uptr value, Uptr shift)
-	{
-		return (value + (Uptr(1) << shift) - 1) >> shift;
-	}
 
 	UnitMemoryManager(const UnitMemoryManager&) = delete;
 	void operator=(const UnitMemoryManager&) = delete;
@@ -324,85 +750,78 @@ private:
 struct JITUnit
 {
 	JITUnit(bool inShouldLogMetrics = true)
-	: shouldLogMetrics(inShouldLogMetrics)
-#ifdef _WIN32
-	, pdataCopy(nullptr)
-	, xdataCopy(nullptr)
-#endif
+	: memoryManager(new UnitMemoryManager()), shouldLogMetrics(inShouldLogMetrics)
 	{
-		memoryManager = std::make_shared<UnitMemoryManager>();
-		objectLayer   = llvm::make_unique<ObjectLayer>([this]() { return this->memoryManager; },
-                                                     NotifyLoadedFunctor(this),
-                                                     NotifyFinalizedFunctor(this));
-#ifndef _WIN64
-		objectLayer->setProcessAllSections(true);
-#endif
-		compileLayer = llvm::make_unique<CompileLayer>(*objectLayer,
-													   llvm::orc::SimpleCompiler(*targetMachine));
 	}
-	~JITUnit()
+	virtual ~JITUnit()
 	{
-		cantFail(compileLayer->removeModule(handle));
 #ifdef _WIN64
-		if(pdataCopy) { Platform::deregisterSEHUnwindInfo(reinterpret_cast<Uptr>(pdataCopy)); }
+		for(Uptr functionTableAddress : sehFunctionTableAddresses)
+		{ Platform::deregisterSEHUnwindInfo(functionTableAddress); }
 #endif
 	}
 
+	// Optimizes and compiles a LLVM module, and loads the resulting object code.
 	void compile(const std::shared_ptr<llvm::Module>& llvmModule);
 
+	// Loads object code into the unit's memory. Symbols referenced by one object may be defined by
+	// any of the other objects, and other symbols are looked up in the resolver.
+	void load(const std::vector<ObjectBinary>& objects, llvm::JITSymbolResolver& resolver);
+
 	virtual void notifySymbolLoaded(const char* name,
 									Uptr baseAddress,
 									Uptr numBytes,
-									std::map<U32, U32>&& offsetToOpIndexMap)
+									OffsetToOpIndexTable&& offsetToOpIndexTable)
 		= 0;
 
 private:
-	// Functor that receives notifications when an object produced by the JIT is loaded.
-	struct NotifyLoadedFunctor
-	{
-		JITUnit* jitUnit;
-		NotifyLoadedFunctor(JITUnit* inJITUnit) : jitUnit(inJITUnit) {}
-		void operator()(
-			llvm::orc::RTDyldObjectLinkingLayer::ObjHandleT objectHandle,
-			const std::shared_ptr<llvm::object::OwningBinary<llvm::object::ObjectFile>>& object,
-			const llvm::RuntimeDyld::LoadedObjectInfo& loadedObject);
-	};
-
-	// Functor that receives notifications when an object produced by the JIT is finalized.
-	struct NotifyFinalizedFunctor
+	struct LoadedObject
 	{
-		JITUnit* jitUnit;
-		NotifyFinalizedFunctor(JITUnit* inJITUnit) : jitUnit(inJITUnit) {}
-		void operator()(const llvm::orc::RTDyldObjectLinkingLayerBase::ObjHandleT& objectHandle);
-	};
-	typedef llvm::orc::RTDyldObjectLinkingLayer ObjectLayer;
-	typedef llvm::orc::IRCompileLayer<ObjectLayer, llvm::orc::SimpleCompiler> CompileLayer;
+		const llvm::object::ObjectFile* object;
+		std::unique_ptr<llvm::RuntimeDyld::LoadedObjectInfo> loadedObject;
 
-	std::shared_ptr<UnitMemoryManager> memoryManager;
-	std::unique_ptr<ObjectLayer> objectLayer;
-	std::unique_ptr<CompileLayer> compileLayer;
-	CompileLayer::ModuleHandleT handle;
-	bool shouldLogMetrics;
+#ifdef _WIN32
+		U8* imageBaseAddress;
 
-	struct LoadedObject
-	{
-		llvm::object::ObjectFile* object;
-		const llvm::RuntimeDyld::LoadedObjectInfo* loadedObject;
-	};
+		llvm::object::SectionRef pdataSection;
+		U8* pdataCopy;
+		Uptr pdataNumBytes;
 
-	std::vector<LoadedObject> loadedObjects;
+		llvm::object::SectionRef xdataSection;
+		U8* xdataCopy;
+		Uptr xdataNumBytes;
 
-#ifdef _WIN32
-	llvm::object::SectionRef pdataSection;
-	U8* pdataCopy;
-	Uptr pdataNumBytes;
+		Uptr sehTrampolineAddress;
+#endif
+	};
 
-	llvm::object::SectionRef xdataSection;
-	U8* xdataCopy;
-	Uptr xdataNumBytes;
+	std::unique_ptr<UnitMemoryManager> memoryManager;
+	bool shouldLogMetrics;
 
-	Uptr sehTrampolineAddress;
+#ifdef _WIN64
+	// The addresses of the SEH function tables registered for the unit's objects.
+	std::vector<Uptr> sehFunctionTableAddresses;
 #endif
+
+	void notifyObjectLoaded(LoadedObject& loadedObject);
+	void notifyObjectFinalized(LoadedObject& loadedObject);
+};
+
+// The object code compiled for a module, which is linked into each instance of the module.
+struct CompiledModule
+{
+	ObjectCacheKey key;
+	std::unique_ptr<llvm::MemoryBuffer> cachedObjectBuffer;
+	std::vector<ObjectBinary> objects;
+	Uptr numObjectBytes;
+
+	// The optimization level that the module's functions are compiled with at the optimized tier,
+	// or when they are lazily compiled.
+	OptimizationLevel optimizationLevel;
+
+	// A copy of the module's IR, kept with baseline tier or lazy compilation stub object code to
+	// compile the module's functions after it is instantiated.
+	std::unique_ptr<IR::Module> module;
 };
 
 // The JIT compilation unit for a WebAssembly module instance.
@@ -412,23 +831,37 @@ struct JITModule : JITUnit, JITModuleBase
 
 	std::vector<JITSymbol*> functionDefSymbols;
 
+	// The state used to compile the module instance's functions after it is instantiated, by lazy
+	// compilation or tier-up. Only set for the JITModule created by instantiating a module.
+	std::shared_ptr<CompiledModule> compiledModule;
+	std::unique_ptr<std::atomic<I32>[]> tierUpCounters;
+
+	// Which functions have been queued for tier-up. Baseline code that keeps running after tier-up
+	// is requested keeps decrementing the function's counter, which may wrap around and reach zero
+	// again, so this ensures each function is only tiered up once.
+	std::unique_ptr<std::atomic<bool>[]> isTierUpRequested;
+
+	// Which functions have been lazily compiled. Guarded by lazyCompileMutex, which is held while a
+	// function of the module is lazily compiled.
+	Platform::Mutex lazyCompileMutex;
+	std::vector<bool> isLazyFunctionDefCompiled;
+
+	// The units holding the code compiled for individual functions after instantiation.
+	Platform::Mutex functionUnitsMutex;
+	std::vector<std::unique_ptr<JITModule>> functionUnits;
+
 	JITModule(ModuleInstance* inModuleInstance) : moduleInstance(inModuleInstance) {}
 	~JITModule() override
 	{
-		// Delete the module's symbols, and remove them from the global address-to-symbol map.
-		Lock<Platform::Mutex> addressToSymbolMapLock(addressToSymbolMapMutex);
-		for(auto symbol : functionDefSymbols)
-		{
-			addressToSymbolMap.erase(
-				addressToSymbolMap.find(symbol->baseAddress + symbol->numBytes));
-			delete symbol;
-		}
+		// Remove the module's symbols from the global symbol table, and delete them.
+		updateJITSymbolTable({}, functionDefSymbols);
+		for(auto symbol : functionDefSymbols) { delete symbol; }
 	}
 
 	void notifySymbolLoaded(const char* name,
 							Uptr baseAddress,
 							Uptr numBytes,
-							std::map<U32, U32>&& offsetToOpIndexMap) override
+							OffsetToOpIndexTable&& offsetToOpIndexTable) override
 	{
 		// Save the address range this function was loaded at for future address->symbol lookups.
 		Uptr functionDefIndex;
@@ -438,14 +871,20 @@ struct JITModule : JITUnit, JITModuleBase
 			wavmAssert(functionDefIndex < moduleInstance->functionDefs.size());
 			FunctionInstance* functionInstance = moduleInstance->functionDefs[functionDefIndex];
 			auto symbol                        = new JITSymbol(
-                functionInstance, baseAddress, numBytes, std::move(offsetToOpIndexMap));
+                functionInstance, baseAddress, numBytes, std::move(offsetToOpIndexTable));
 			functionDefSymbols.push_back(symbol);
-			functionInstance->nativeFunction = reinterpret_cast<void*>(baseAddress);
+		}
+	}
 
-			{
-				Lock<Platform::Mutex> addressToSymbolMapLock(addressToSymbolMapMutex);
-				addressToSymbolMap[baseAddress + numBytes] = symbol;
-			}
+	// Makes the module instance's functions use the code loaded by this unit. This must be called
+	// after the unit is loaded, so the code is executable before any thread can call it.
+	void publishFunctionDefs()
+	{
+		addJITSymbols(functionDefSymbols);
+		for(JITSymbol* symbol : functionDefSymbols)
+		{
+			symbol->functionInstance->nativeFunction
+				= reinterpret_cast<void*>(symbol->baseAddress);
 		}
 	}
 };
@@ -465,14 +904,49 @@ struct JITThunkUnit : JITUnit
 	void notifySymbolLoaded(const char* name,
 							Uptr baseAddress,
 							Uptr numBytes,
-							std::map<U32, U32>&& offsetToOpIndexMap) override
+							OffsetToOpIndexTable&& offsetToOpIndexTable) override
 	{
 #if(defined(_WIN32) && !defined(_WIN64))
 		wavmAssert(!strcmp(name, "_thunk"));
 #else
 		wavmAssert(!strcmp(name, "thunk"));
 #endif
-		symbol = new JITSymbol(functionType, baseAddress, numBytes, std::move(offsetToOpIndexMap));
+		symbol = new JITSymbol(
+			functionType, baseAddress, numBytes, std::move(offsetToOpIndexTable));
+	}
+};
+
+// The JIT compilation unit for a batch of intrinsic thunks, named "thunk0", "thunk1", etc.
+struct JITIntrinsicThunkUnit : JITUnit
+{
+	std::vector<FunctionType> functionTypes;
+
+	std::vector<JITSymbol*> symbols;
+
+	JITIntrinsicThunkUnit(std::vector<FunctionType>&& inFunctionTypes)
+	: JITUnit(false)
+	, functionTypes(std::move(inFunctionTypes))
+	, symbols(functionTypes.size(), nullptr)
+	{
+	}
+
+	void notifySymbolLoaded(const char* name,
+							Uptr baseAddress,
+							Uptr numBytes,
+							OffsetToOpIndexTable&& offsetToOpIndexTable) override
+	{
+#if(defined(_WIN32) && !defined(_WIN64))
+		const char thunkPrefix[] = "_thunk";
+#else
+		const char thunkPrefix[] = "thunk";
+#endif
+		const Uptr numPrefixChars = sizeof(thunkPrefix) - 1;
+		wavmAssert(!strncmp(name, thunkPrefix, numPrefixChars));
+
+		const Uptr thunkIndex = Uptr(std::strtoull(name + numPrefixChars, nullptr, 10));
+		wavmAssert(thunkIndex < symbols.size());
+		symbols[thunkIndex] = new JITSymbol(
+			functionTypes[thunkIndex], baseAddress, numBytes, std::move(offsetToOpIndexTable));
 	}
 };
 
@@ -536,67 +1010,92 @@ llvm::JITSymbol NullResolver::findSymbolInLogicalDylib(const std::string& name)
 	return llvm::JITSymbol(nullptr);
 }
 
-void JITUnit::NotifyLoadedFunctor::operator()(
-	llvm::orc::RTDyldObjectLinkingLayerBase::ObjHandleT objectHandle,
-	const std::shared_ptr<llvm::object::OwningBinary<llvm::object::ObjectFile>>& object,
-	const llvm::RuntimeDyld::LoadedObjectInfo& loadedObject)
+// Resolves the symbols that a module's object code uses to reference values of a module instance.
+struct ModuleInstanceResolver : llvm::JITSymbolResolver
 {
-	// Make a copy of the loaded object info for use by the finalizer.
-	jitUnit->loadedObjects.push_back(LoadedObject{object.get()->getBinary(), &loadedObject});
+	ModuleInstanceResolver(const IR::Module& inModule, ModuleInstance* inModuleInstance)
+	: module(inModule), moduleInstance(inModuleInstance)
+	{
+	}
+
+	virtual llvm::JITSymbol findSymbol(const std::string& name) override
+	{
+		Uptr value;
+		if(resolveBoundSymbol(module, moduleInstance, name.c_str(), value))
+		{ return llvm::JITSymbol(value, llvm::JITSymbolFlags::None); }
+		return NullResolver::singleton->findSymbol(name);
+	}
+	virtual llvm::JITSymbol findSymbolInLogicalDylib(const std::string& name) override
+	{
+		return llvm::JITSymbol(nullptr);
+	}
+
+private:
+	const IR::Module& module;
+	ModuleInstance* moduleInstance;
+};
+
+void JITUnit::notifyObjectLoaded(LoadedObject& loadedObject)
+{
+	const llvm::object::ObjectFile* object = loadedObject.object;
 
-	if(jitUnit->shouldLogMetrics && DUMP_OBJECT)
+	if(shouldLogMetrics && DUMP_OBJECT)
 	{
 		// Dump the object file.
 		std::error_code errorCode;
-		static Uptr dumpedObjectId = 0;
+		static std::atomic<Uptr> dumpedObjectId(0);
 		std::string augmentedFilename
 			= std::string("jitObject") + std::to_string(dumpedObjectId++) + ".o";
 		llvm::raw_fd_ostream dumpFileStream(
 			augmentedFilename, errorCode, llvm::sys::fs::OpenFlags::F_None);
-		dumpFileStream.write((const char*)object->getBinary()->getData().bytes_begin(),
-							 object->getBinary()->getData().size());
+		dumpFileStream.write((const char*)object->getData().bytes_begin(),
+							 object->getData().size());
 		Log::printf(Log::debug, "Dumped object file to: %s\n", augmentedFilename.c_str());
 	}
 
 #ifdef _WIN64
+	loadedObject.imageBaseAddress = memoryManager->getImageBaseAddress();
+	loadedObject.pdataCopy        = nullptr;
+	loadedObject.xdataCopy        = nullptr;
+
 	// The LLVM dynamic loader doesn't correctly apply the IMAGE_REL_AMD64_ADDR32NB relocations in
 	// the pdata and xdata sections
 	// (https://github.com/llvm-mirror/llvm/blob/e84d8c12d5157a926db15976389f703809c49aa5/lib/ExecutionEngine/RuntimeDyld/Targets/RuntimeDyldCOFFX86_64.h#L96)
 	// Make a copy of those sections before they are clobbered, so we can do the fixup ourselves
 	// later.
-	for(auto section : object->getBinary()->sections())
+	for(auto section : object->sections())
 	{
 		llvm::StringRef sectionName;
 		if(!section.getName(sectionName))
 		{
-			const U8* loadedSection
-				= reinterpret_cast<U8*>(Uptr(loadedObject.getSectionLoadAddress(section)));
+			const U8* loadedSection = reinterpret_cast<U8*>(
+				Uptr(loadedObject.loadedObject->getSectionLoadAddress(section)));
 			if(sectionName == ".pdata")
 			{
-				jitUnit->pdataCopy     = new U8[section.getSize()];
-				jitUnit->pdataNumBytes = section.getSize();
-				jitUnit->pdataSection  = section;
-				memcpy(jitUnit->pdataCopy, loadedSection, section.getSize());
+				loadedObject.pdataCopy     = new U8[section.getSize()];
+				loadedObject.pdataNumBytes = section.getSize();
+				loadedObject.pdataSection  = section;
+				memcpy(loadedObject.pdataCopy, loadedSection, section.getSize());
 			}
 			else if(sectionName == ".xdata")
 			{
-				jitUnit->xdataCopy     = new U8[section.getSize()];
-				jitUnit->xdataNumBytes = section.getSize();
-				jitUnit->xdataSection  = section;
-				memcpy(jitUnit->xdataCopy, loadedSection, section.getSize());
+				loadedObject.xdataCopy     = new U8[section.getSize()];
+				loadedObject.xdataNumBytes = section.getSize();
+				loadedObject.xdataSection  = section;
+				memcpy(loadedObject.xdataCopy, loadedSection, section.getSize());
 			}
 		}
 	}
 
 	// Create a trampoline within the image's 2GB address space that jumps to __C_specific_handler.
 	// jmp [rip+0] <64-bit address>
-	U8* trampolineBytes = jitUnit->memoryManager->allocateCodeSection(16, 16, 0, "seh_trampoline");
+	U8* trampolineBytes = memoryManager->allocateCodeSection(16, 16, 0, "seh_trampoline");
 	trampolineBytes[0]  = 0xff;
 	trampolineBytes[1]  = 0x25;
 	*(U32*)&trampolineBytes[2] = 0;
 	*(U64*)&trampolineBytes[6]
 		= U64(cantFail(NullResolver::singleton->findSymbol("__C_specific_handler").getAddress()));
-	jitUnit->sehTrampolineAddress = reinterpret_cast<Uptr>(trampolineBytes);
+	loadedObject.sehTrampolineAddress = reinterpret_cast<Uptr>(trampolineBytes);
 #endif
 }
 
@@ -632,101 +1131,131 @@ static void disassembleFunction(U8* bytes, Uptr numBytes)
 }
 #endif
 
-void JITUnit::NotifyFinalizedFunctor::operator()(
-	const llvm::orc::RTDyldObjectLinkingLayerBase::ObjHandleT& objectHandle)
+// Returns whether an object contains a DWARF line table.
+static bool hasDebugLineInfo(const llvm::object::ObjectFile& object)
 {
-	for(Uptr objectIndex = 0; objectIndex < jitUnit->loadedObjects.size(); ++objectIndex)
+	for(const llvm::object::SectionRef& section : object.sections())
 	{
-		llvm::object::ObjectFile* object = jitUnit->loadedObjects[objectIndex].object;
-		const llvm::RuntimeDyld::LoadedObjectInfo* loadedObject
-			= jitUnit->loadedObjects[objectIndex].loadedObject;
+		llvm::StringRef sectionName;
+		if(section.getName(sectionName)) { continue; }
+		if(sectionName == ".debug_line" || sectionName == "__debug_line") { return true; }
+	}
+	return false;
+}
+
+void JITUnit::notifyObjectFinalized(LoadedObject& loadedObjectRef)
+{
+	const llvm::object::ObjectFile* object = loadedObjectRef.object;
+	const llvm::RuntimeDyld::LoadedObjectInfo* loadedObject = loadedObjectRef.loadedObject.get();
 
-		// Notify GDB of the new object.
-		gdbRegistrationListener->NotifyObjectEmitted(*object, *loadedObject);
+	// Notify GDB of the new object.
+	if(isGDBRegistrationEnabled)
+	{ gdbRegistrationListener->NotifyObjectEmitted(*object, *loadedObject); }
 
-		// Create a DWARF context to interpret the debug information in this compilation unit.
+	// If the object has debug info, create a DWARF context to interpret it. Objects that were
+	// compiled without debug info skip the cost of creating the context and looking up line info.
 #if LLVM_VERSION_MAJOR < 6
-		auto dwarfContext = llvm::make_unique<llvm::DWARFContextInMemory>(*object, loadedObject);
+	std::unique_ptr<llvm::DWARFContextInMemory> dwarfContext;
+	if(hasDebugLineInfo(*object))
+	{ dwarfContext = llvm::make_unique<llvm::DWARFContextInMemory>(*object, loadedObject); }
 #else
-		auto dwarfContext = llvm::DWARFContext::create(*object, loadedObject);
+	std::unique_ptr<llvm::DWARFContext> dwarfContext;
+	if(hasDebugLineInfo(*object))
+	{ dwarfContext = llvm::DWARFContext::create(*object, loadedObject); }
 #endif
 
-		// Iterate over the functions in the loaded object.
-		for(auto symbolSizePair : llvm::object::computeSymbolSizes(*object))
+	// Iterate over the functions in the loaded object.
+	for(auto symbolSizePair : llvm::object::computeSymbolSizes(*object))
+	{
+		auto symbol = symbolSizePair.first;
+
+		// Get the type, name, and address of the symbol. Need to be careful not to get the
+		// Expected<T> for each value unless it will be checked for success before continuing.
+		auto type = symbol.getType();
+		if(!type || *type != llvm::object::SymbolRef::ST_Function) { continue; }
+		auto name = symbol.getName();
+		if(!name) { continue; }
+		auto address = symbol.getAddress();
+		if(!address) { continue; }
+
+		// Compute the address the functions was loaded at.
+		wavmAssert(*address <= UINTPTR_MAX);
+		Uptr loadedAddress = Uptr(*address);
+		auto symbolSection = symbol.getSection();
+		if(symbolSection)
+		{ loadedAddress += (Uptr)loadedObject->getSectionLoadAddress(*symbolSection.get()); }
+
+		// Get the DWARF line info for this symbol, which maps machine code addresses to
+		// WebAssembly op indices.
+		OffsetToOpIndexTable offsetToOpIndexTable;
+		if(dwarfContext)
 		{
-			auto symbol = symbolSizePair.first;
-
-			// Get the type, name, and address of the symbol. Need to be careful not to get the
-			// Expected<T> for each value unless it will be checked for success before continuing.
-			auto type = symbol.getType();
-			if(!type || *type != llvm::object::SymbolRef::ST_Function) { continue; }
-			auto name = symbol.getName();
-			if(!name) { continue; }
-			auto address = symbol.getAddress();
-			if(!address) { continue; }
-
-			// Compute the address the functions was loaded at.
-			wavmAssert(*address <= UINTPTR_MAX);
-			Uptr loadedAddress = Uptr(*address);
-			auto symbolSection = symbol.getSection();
-			if(symbolSection)
-			{ loadedAddress += (Uptr)loadedObject->getSectionLoadAddress(*symbolSection.get()); }
-
-			// Get the DWARF line info for this symbol, which maps machine code addresses to
-			// WebAssembly op indices.
 			llvm::DILineInfoTable lineInfoTable
 				= dwarfContext->getLineInfoForAddressRange(loadedAddress, symbolSizePair.second);
-			std::map<U32, U32> offsetToOpIndexMap;
 			for(auto lineInfo : lineInfoTable)
 			{
-				offsetToOpIndexMap.emplace(U32(lineInfo.first - loadedAddress),
-										   lineInfo.second.Line);
-			}
-
-#if PRINT_DISASSEMBLY
-			if(jitUnit->shouldLogMetrics)
-			{
-				Log::printf(Log::error, "Disassembly for function %s\n", name.get().data());
-				disassembleFunction(reinterpret_cast<U8*>(loadedAddress),
-									Uptr(symbolSizePair.second));
+				offsetToOpIndexTable.push_back(
+					{U32(lineInfo.first - loadedAddress), U32(lineInfo.second.Line)});
 			}
-#endif
 
-			// Notify the JIT unit that the symbol was loaded.
-			wavmAssert(symbolSizePair.second <= UINTPTR_MAX);
-			jitUnit->notifySymbolLoaded(name->data(),
-										loadedAddress,
-										Uptr(symbolSizePair.second),
-										std::move(offsetToOpIndexMap));
+			// Sort the table by offset, and only keep the first op index for each offset.
+			std::stable_sort(offsetToOpIndexTable.begin(),
+							 offsetToOpIndexTable.end(),
+							 [](const std::pair<U32, U32>& a, const std::pair<U32, U32>& b) {
+								 return a.first < b.first;
+							 });
+			offsetToOpIndexTable.erase(
+				std::unique(offsetToOpIndexTable.begin(),
+							offsetToOpIndexTable.end(),
+							[](const std::pair<U32, U32>& a, const std::pair<U32, U32>& b) {
+								return a.first == b.first;
+							}),
+				offsetToOpIndexTable.end());
+			offsetToOpIndexTable.shrink_to_fit();
 		}
 
-#ifdef _WIN64
-		processSEHTables(reinterpret_cast<Uptr>(jitUnit->memoryManager->getImageBaseAddress()),
-						 loadedObject,
-						 jitUnit->pdataSection,
-						 jitUnit->pdataCopy,
-						 jitUnit->pdataNumBytes,
-						 jitUnit->xdataSection,
-						 jitUnit->xdataCopy,
-						 jitUnit->sehTrampolineAddress);
-		if(jitUnit->pdataCopy)
-		{
-			delete[] jitUnit->pdataCopy;
-			jitUnit->pdataCopy = nullptr;
-		}
-		if(jitUnit->xdataCopy)
+#if PRINT_DISASSEMBLY
+		if(shouldLogMetrics)
 		{
-			delete[] jitUnit->xdataCopy;
-			jitUnit->xdataCopy = nullptr;
+			Log::printf(Log::error, "Disassembly for function %s\n", name.get().data());
+			disassembleFunction(reinterpret_cast<U8*>(loadedAddress),
+								Uptr(symbolSizePair.second));
 		}
 #endif
-	}
 
-	jitUnit->memoryManager->reallyFinalizeMemory();
-	jitUnit->loadedObjects.clear();
-}
+		// Notify the JIT unit that the symbol was loaded.
+		wavmAssert(symbolSizePair.second <= UINTPTR_MAX);
+		notifySymbolLoaded(name->data(),
+						   loadedAddress,
+						   Uptr(symbolSizePair.second),
+						   std::move(offsetToOpIndexTable));
+	}
 
-static Uptr printedModuleId = 0;
+#ifdef _WIN64
+	processSEHTables(reinterpret_cast<Uptr>(loadedObjectRef.imageBaseAddress),
+					 loadedObject,
+					 loadedObjectRef.pdataSection,
+					 loadedObjectRef.pdataCopy,
+					 loadedObjectRef.pdataNumBytes,
+					 loadedObjectRef.xdataSection,
+					 loadedObjectRef.xdataCopy,
+					 loadedObjectRef.sehTrampolineAddress);
+	if(loadedObjectRef.pdataCopy)
+	{
+		sehFunctionTableAddresses.push_back(
+			Uptr(loadedObject->getSectionLoadAddress(loadedObjectRef.pdataSection)));
+		delete[] loadedObjectRef.pdataCopy;
+		loadedObjectRef.pdataCopy = nullptr;
+	}
+	if(loadedObjectRef.xdataCopy)
+	{
+		delete[] loadedObjectRef.xdataCopy;
+		loadedObjectRef.xdataCopy = nullptr;
+	}
+#endif
+}
+
+static std::atomic<Uptr> printedModuleId(0);
 
 static void printModule(const llvm::Module* llvmModule, const char* filename)
 {
@@ -739,18 +1268,50 @@ static void printModule(const llvm::Module* llvmModule, const char* filename)
 	Log::printf(Log::debug, "Dumped LLVM module to: %s\n", augmentedFilename.c_str());
 }
 
-void JITUnit::compile(const std::shared_ptr<llvm::Module>& llvmModule)
+// Runs a full -O3 style optimization pipeline on a LLVM module, tuned for the current thread's
+// target machine.
+static void runFullOptimizationPasses(llvm::Module& llvmModule)
+{
+	llvm::PassManagerBuilder passManagerBuilder;
+	passManagerBuilder.OptLevel      = 3;
+	passManagerBuilder.Inliner       = llvm::createFunctionInliningPass(3, 0, false);
+	passManagerBuilder.LoopVectorize = true;
+	passManagerBuilder.SLPVectorize  = true;
+	targetMachine->adjustPassManager(passManagerBuilder);
+
+	llvm::legacy::FunctionPassManager fpm(&llvmModule);
+	llvm::legacy::PassManager mpm;
+	fpm.add(llvm::createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+	mpm.add(llvm::createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+	passManagerBuilder.populateFunctionPassManager(fpm);
+	passManagerBuilder.populateModulePassManager(mpm);
+
+	fpm.doInitialization();
+	for(auto functionIt = llvmModule.begin(); functionIt != llvmModule.end(); ++functionIt)
+	{ fpm.run(*functionIt); }
+	fpm.doFinalization();
+	mpm.run(llvmModule);
+}
+
+// Optimizes a LLVM module and compiles it to object code using the current thread's target machine.
+// Baseline tier code isn't optimized, regardless of the optimization level.
+static ObjectBinary compileModule(llvm::Module& llvmModule,
+								  bool shouldLogMetrics,
+								  CodeTier tier,
+								  OptimizationLevel optimizationLevel)
 {
+	if(tier == CodeTier::baseline) { optimizationLevel = OptimizationLevel::none; }
+
 	// Get a target machine object for this host, and set the module to use its data layout.
-	llvmModule->setDataLayout(targetMachine->createDataLayout());
+	llvmModule.setDataLayout(targetMachine->createDataLayout());
 
 	// Verify the module.
-	if(shouldLogMetrics && DUMP_UNOPTIMIZED_MODULE) { printModule(llvmModule.get(), "llvmDump"); }
+	if(shouldLogMetrics && DUMP_UNOPTIMIZED_MODULE) { printModule(&llvmModule, "llvmDump"); }
 	if(shouldLogMetrics && VERIFY_MODULE)
 	{
 		std::string verifyOutputString;
 		llvm::raw_string_ostream verifyOutputStream(verifyOutputString);
-		if(llvm::verifyModule(*llvmModule, &verifyOutputStream))
+		if(llvm::verifyModule(llvmModule, &verifyOutputStream))
 		{
 			verifyOutputStream.flush();
 			Errors::fatalf("LLVM verification errors:\n%s\n", verifyOutputString.c_str());
@@ -758,56 +1319,534 @@ void JITUnit::compile(const std::shared_ptr<llvm::Module>& llvmModule)
 		Log::printf(Log::debug, "Verified LLVM module\n");
 	}
 
-	// Run some optimization on the module's functions.
-	Timing::Timer optimizationTimer;
+	if(optimizationLevel != OptimizationLevel::none)
+	{
+		// Run some optimization on the module's functions.
+		Timing::Timer optimizationTimer;
+
+		if(optimizationLevel == OptimizationLevel::full) { runFullOptimizationPasses(llvmModule); }
+		else
+		{
+			auto fpm = new llvm::legacy::FunctionPassManager(&llvmModule);
+			fpm->add(llvm::createPromoteMemoryToRegisterPass());
+			fpm->add(llvm::createInstructionCombiningPass());
+			fpm->add(llvm::createCFGSimplificationPass());
+			fpm->add(llvm::createJumpThreadingPass());
+			fpm->add(llvm::createConstantPropagationPass());
+			fpm->doInitialization();
+			for(auto functionIt = llvmModule.begin(); functionIt != llvmModule.end(); ++functionIt)
+			{ fpm->run(*functionIt); }
+			delete fpm;
+		}
+
+		if(shouldLogMetrics)
+		{
+			Timing::logRatePerSecond(
+				"Optimized LLVM module", optimizationTimer, (F64)llvmModule.size(), "functions");
+		}
+
+		if(shouldLogMetrics && DUMP_OPTIMIZED_MODULE)
+		{ printModule(&llvmModule, "llvmOptimizedDump"); }
+	}
 
-	auto fpm = new llvm::legacy::FunctionPassManager(llvmModule.get());
-	fpm->add(llvm::createPromoteMemoryToRegisterPass());
-	fpm->add(llvm::createInstructionCombiningPass());
-	fpm->add(llvm::createCFGSimplificationPass());
-	fpm->add(llvm::createJumpThreadingPass());
-	fpm->add(llvm::createConstantPropagationPass());
-	fpm->doInitialization();
-	for(auto functionIt = llvmModule->begin(); functionIt != llvmModule->end(); ++functionIt)
-	{ fpm->run(*functionIt); }
-	delete fpm;
+	// Generate machine code for the module. Unoptimized code is generated by the fast instruction
+	// selector without any machine code optimization.
+	Timing::Timer machineCodeTimer;
+	switch(optimizationLevel)
+	{
+	case OptimizationLevel::none: targetMachine->setOptLevel(llvm::CodeGenOpt::None); break;
+	case OptimizationLevel::basic: targetMachine->setOptLevel(llvm::CodeGenOpt::Default); break;
+	case OptimizationLevel::full: targetMachine->setOptLevel(llvm::CodeGenOpt::Aggressive); break;
+	default: Errors::unreachable();
+	};
+	targetMachine->setFastISel(optimizationLevel == OptimizationLevel::none);
+	ObjectBinary object = llvm::orc::SimpleCompiler(*targetMachine)(llvmModule);
+	if(!object.getBinary()) { Errors::fatal("LLVM failed to generate machine code"); }
 
 	if(shouldLogMetrics)
 	{
 		Timing::logRatePerSecond(
-			"Optimized LLVM module", optimizationTimer, (F64)llvmModule->size(), "functions");
+			"Generated machine code", machineCodeTimer, (F64)llvmModule.size(), "functions");
 	}
 
-	if(shouldLogMetrics && DUMP_OPTIMIZED_MODULE)
-	{ printModule(llvmModule.get(), "llvmOptimizedDump"); }
+	return object;
+}
 
-	// Pass the module to the JIT compiler.
-	Timing::Timer machineCodeTimer;
-	handle = cantFail(compileLayer->addModule(llvmModule, NullResolver::singleton));
-	cantFail(compileLayer->emitAndFinalize(handle));
+void JITUnit::compile(const std::shared_ptr<llvm::Module>& llvmModule)
+{
+	std::vector<ObjectBinary> objects;
+	objects.push_back(
+		compileModule(*llvmModule, shouldLogMetrics, CodeTier::untiered, OptimizationLevel::basic));
+	load(objects, *NullResolver::singleton);
+}
+
+void JITUnit::load(const std::vector<ObjectBinary>& objects, llvm::JITSymbolResolver& resolver)
+{
+	Timing::Timer loadTimer;
+
+	// Load all the objects with a single dynamic loader, so it can resolve references between them.
+	llvm::RuntimeDyld loader(*memoryManager, resolver);
+#ifndef _WIN64
+	loader.setProcessAllSections(true);
+#endif
+
+	std::vector<LoadedObject> loadedObjects(objects.size());
+	for(Uptr objectIndex = 0; objectIndex < objects.size(); ++objectIndex)
+	{
+		LoadedObject& loadedObject = loadedObjects[objectIndex];
+		loadedObject.object        = objects[objectIndex].getBinary();
+		loadedObject.loadedObject  = loader.loadObject(*loadedObject.object);
+		if(loader.hasError())
+		{ Errors::fatalf("Failed to load JIT object: %s\n", loader.getErrorString().str().c_str()); }
+		notifyObjectLoaded(loadedObject);
+	}
+
+	// Apply the relocations and register the EH frames for all the objects.
+	loader.finalizeWithMemoryManagerLocking();
+	if(loader.hasError())
+	{ Errors::fatalf("Failed to link JIT objects: %s\n", loader.getErrorString().str().c_str()); }
+
+	for(LoadedObject& loadedObject : loadedObjects) { notifyObjectFinalized(loadedObject); }
+
+	memoryManager->reallyFinalizeMemory();
 
 	if(shouldLogMetrics)
+	{ Timing::logRatePerSecond("Loaded object code", loadTimer, (F64)objects.size(), "objects"); }
+}
+
+// A range of a module's function definitions that is emitted and compiled independently of the
+// rest of the module.
+struct ModulePartition
+{
+	Uptr beginFunctionDefIndex;
+	Uptr endFunctionDefIndex;
+};
+
+// The state shared by the threads compiling a module's partitions.
+struct ModuleCompileJob
+{
+	const IR::Module& module;
+	ModuleInstance* moduleInstance;
+	CodeTier tier;
+	OptimizationLevel optimizationLevel;
+	std::vector<ModulePartition> partitions;
+	std::vector<ObjectBinary> objects;
+	std::atomic<Uptr> nextPartitionIndex;
+
+	ModuleCompileJob(const IR::Module& inModule,
+					 ModuleInstance* inModuleInstance,
+					 CodeTier inTier,
+					 OptimizationLevel inOptimizationLevel)
+	: module(inModule)
+	, moduleInstance(inModuleInstance)
+	, tier(inTier)
+	, optimizationLevel(inOptimizationLevel)
+	, nextPartitionIndex(0)
 	{
-		Timing::logRatePerSecond(
-			"Generated machine code", machineCodeTimer, (F64)llvmModule->size(), "functions");
 	}
+};
+
+// Splits a module's function definitions into at most maxPartitions contiguous ranges that have
+// roughly equal amounts of code.
+static std::vector<ModulePartition> partitionModule(const IR::Module& module, Uptr maxPartitions)
+{
+	const Uptr numFunctionDefs = module.functions.defs.size();
+	Uptr numPartitions = std::min(maxPartitions, numFunctionDefs / minFunctionDefsPerPartition);
+	if(numPartitions < 1) { numPartitions = 1; }
+
+	Uptr numTotalCodeBytes = 0;
+	for(const FunctionDef& functionDef : module.functions.defs)
+	{ numTotalCodeBytes += functionDef.code.size(); }
+
+	std::vector<ModulePartition> partitions;
+	Uptr beginFunctionDefIndex = 0;
+	Uptr numPartitionCodeBytes = 0;
+	for(Uptr functionDefIndex = 0; functionDefIndex < numFunctionDefs; ++functionDefIndex)
+	{
+		numPartitionCodeBytes += module.functions.defs[functionDefIndex].code.size();
+		if(partitions.size() + 1 < numPartitions
+		   && numPartitionCodeBytes * numPartitions >= numTotalCodeBytes)
+		{
+			partitions.push_back({beginFunctionDefIndex, functionDefIndex + 1});
+			beginFunctionDefIndex = functionDefIndex + 1;
+			numPartitionCodeBytes = 0;
+		}
+	}
+	partitions.push_back({beginFunctionDefIndex, numFunctionDefs});
+	return partitions;
 }
 
-void LLVMJIT::instantiateModule(const IR::Module& module, ModuleInstance* moduleInstance)
+// Emits and compiles partitions from a ModuleCompileJob until there are none left.
+static I64 compileThreadEntry(void* jobVoid)
 {
-	Lock<Platform::Mutex> llvmLock(llvmMutex);
+	ModuleCompileJob* job = (ModuleCompileJob*)jobVoid;
 
-	initLLVM();
+	LLVMThreadState threadState;
+	LLVMThreadStateScope threadStateScope(threadState);
+	while(true)
+	{
+		const Uptr partitionIndex = job->nextPartitionIndex++;
+		if(partitionIndex >= job->partitions.size()) { break; }
+
+		const ModulePartition& partition = job->partitions[partitionIndex];
+		auto llvmModule                  = emitModule(job->module,
+													  job->moduleInstance,
+													  partition.beginFunctionDefIndex,
+													  partition.endFunctionDefIndex,
+													  job->tier);
+		job->objects[partitionIndex]
+			= compileModule(*llvmModule, true, job->tier, job->optimizationLevel);
+	}
 
-	// Emit LLVM IR for the module.
-	auto llvmModule = emitModule(module, moduleInstance);
+	return 0;
+}
+
+// Emits and compiles a module's code, and returns the resulting objects.
+static std::vector<ObjectBinary> compileModuleObjects(const IR::Module& module,
+													  ModuleInstance* moduleInstance,
+													  CodeTier tier,
+													  OptimizationLevel optimizationLevel)
+{
+	Timing::Timer compileTimer;
+
+	Uptr numThreads = maxCompileThreads;
+	if(!numThreads) { numThreads = Platform::getNumberOfHardwareThreads(); }
+
+	// Split the module into partitions that can be emitted and compiled in parallel.
+	ModuleCompileJob job(module, moduleInstance, tier, optimizationLevel);
+	job.partitions = partitionModule(module, numThreads);
+	job.objects.resize(job.partitions.size());
+
+	// Compile the partitions on a pool of threads that includes the calling thread.
+	std::vector<Platform::Thread*> threads;
+	const Uptr numWorkerThreads = std::min(numThreads, job.partitions.size()) - 1;
+	for(Uptr threadIndex = 0; threadIndex < numWorkerThreads; ++threadIndex)
+	{
+		threads.push_back(
+			Platform::createThread(compileThreadNumStackBytes, compileThreadEntry, &job));
+	}
+	compileThreadEntry(&job);
+	for(Platform::Thread* thread : threads) { Platform::joinThread(thread); }
+
+	Timing::logRatePerSecond(tier == CodeTier::baseline ? "Compiled module at baseline tier"
+														: "Compiled module",
+							 compileTimer,
+							 (F64)module.functions.defs.size(),
+							 "functions");
+
+	return std::move(job.objects);
+}
+
+// Finds the object code compiled for a module in the in-memory cache, and marks it as most recently
+// used. Returns null if it isn't in the cache.
+static std::shared_ptr<CompiledModule> findCompiledModule(const ObjectCacheKey& key)
+{
+	Lock<Platform::Mutex> compiledModuleCacheLock(compiledModuleCacheMutex);
+	for(auto it = compiledModuleCache.begin(); it != compiledModuleCache.end(); ++it)
+	{
+		if((*it)->key == key)
+		{
+			std::shared_ptr<CompiledModule> compiledModule = *it;
+			compiledModuleCache.erase(it);
+			compiledModuleCache.push_back(compiledModule);
+			return compiledModule;
+		}
+	}
+	return nullptr;
+}
+
+// Adds the object code compiled for a module to the in-memory cache, and evicts the least recently
+// used object code until the cache is no larger than maxCompiledModuleCacheBytes.
+static void addCompiledModule(const std::shared_ptr<CompiledModule>& compiledModule)
+{
+	compiledModule->numObjectBytes = 0;
+	for(const ObjectBinary& object : compiledModule->objects)
+	{ compiledModule->numObjectBytes += object.getBinary()->getData().size(); }
+
+	Lock<Platform::Mutex> compiledModuleCacheLock(compiledModuleCacheMutex);
+
+	// If another thread compiled the same module concurrently, keep the object code it added.
+	for(const std::shared_ptr<CompiledModule>& cachedModule : compiledModuleCache)
+	{
+		if(cachedModule->key == compiledModule->key) { return; }
+	}
+
+	compiledModuleCache.push_back(compiledModule);
+	numCompiledModuleCacheBytes += compiledModule->numObjectBytes;
+	while(numCompiledModuleCacheBytes > maxCompiledModuleCacheBytes)
+	{
+		numCompiledModuleCacheBytes -= compiledModuleCache.front()->numObjectBytes;
+		compiledModuleCache.erase(compiledModuleCache.begin());
+	}
+}
+
+// Emits and compiles the lazy compilation stubs for a module's functions.
+static std::vector<ObjectBinary> compileLazyCompileStubs(const IR::Module& module,
+														 ModuleInstance* moduleInstance)
+{
+	Timing::Timer compileTimer;
+
+	LLVMThreadState threadState;
+	LLVMThreadStateScope threadStateScope(threadState);
+	auto llvmModule = emitLazyCompileStubs(module, moduleInstance);
+	std::vector<ObjectBinary> objects;
+	objects.push_back(
+		compileModule(*llvmModule, true, CodeTier::baseline, OptimizationLevel::none));
+
+	Timing::logRatePerSecond("Compiled lazy compilation stubs",
+							 compileTimer,
+							 (F64)module.functions.defs.size(),
+							 "functions");
+
+	return objects;
+}
+
+void LLVMJIT::instantiateModule(const IR::Module& module,
+								ModuleInstance* moduleInstance,
+								OptimizationLevel optimizationLevel)
+{
+	const CodeTier tier = isTieredCompilationEnabled ? CodeTier::baseline : CodeTier::untiered;
+	const bool isLazy   = isLazyCompilationEnabled;
+
+	// The object code doesn't depend on the values bound to the module instance, so reuse the
+	// object code compiled for an earlier instance of the module if possible. Otherwise, try to
+	// load it from the object cache before compiling it.
+	const ObjectCacheKey key = getObjectCacheKey(
+		module, moduleInstance, tier, optimizationLevel, isLazy, isDebugInfoEnabled());
+	std::shared_ptr<CompiledModule> compiledModule = findCompiledModule(key);
+	if(compiledModule) { Log::printf(Log::metrics, "Reused compiled module object code\n"); }
+	else
+	{
+		compiledModule                     = std::make_shared<CompiledModule>();
+		compiledModule->key                = key;
+		compiledModule->optimizationLevel  = optimizationLevel;
+		compiledModule->cachedObjectBuffer = loadCachedObjects(key, compiledModule->objects);
+		if(!compiledModule->cachedObjectBuffer)
+		{
+			compiledModule->objects
+				= isLazy ? compileLazyCompileStubs(module, moduleInstance)
+						 : compileModuleObjects(module, moduleInstance, tier, optimizationLevel);
+			storeCachedObjects(key, compiledModule->objects);
+		}
+		if(isLazy || tier == CodeTier::baseline)
+		{ compiledModule->module = llvm::make_unique<IR::Module>(module); }
+		addCompiledModule(compiledModule);
+	}
 
-	// Construct the JIT compilation pipeline for this module.
 	auto jitModule            = new JITModule(moduleInstance);
 	moduleInstance->jitModule = jitModule;
+	jitModule->compiledModule = compiledModule;
+
+	const Uptr numFunctionDefs = module.functions.defs.size();
+	if(tier == CodeTier::baseline)
+	{
+		// Initialize the counters that the baseline tier code uses to detect hot functions.
+		jitModule->tierUpCounters.reset(new std::atomic<I32>[numFunctionDefs]);
+		jitModule->isTierUpRequested.reset(new std::atomic<bool>[numFunctionDefs]);
+		for(Uptr functionDefIndex = 0; functionDefIndex < numFunctionDefs; ++functionDefIndex)
+		{
+			jitModule->tierUpCounters[functionDefIndex].store(tierUpThreshold);
+			jitModule->isTierUpRequested[functionDefIndex].store(false);
+		}
+	}
+	if(isLazy) { jitModule->isLazyFunctionDefCompiled.assign(numFunctionDefs, false); }
+
+	// Link the object code into a single JIT unit for the module, binding the symbols it uses to
+	// reference the module instance. Each instance gets its own copy of the code, with the module
+	// instance's memories, tables, globals, and functions bound as relocated constants. Sharing one
+	// copy of the code between instances would need a table of those bindings for each instance,
+	// and a pointer to the table passed to every function: the context pointer that is already
+	// passed can't be used to find it, since a compartment's contexts are shared by all the module
+	// instances in the compartment.
+	ModuleInstanceResolver resolver(module, moduleInstance);
+	jitModule->load(compiledModule->objects, resolver);
+	jitModule->publishFunctionDefs();
+}
+
+struct Runtime::PrecompiledModule
+{
+	IR::Module module;
+	std::shared_ptr<CompiledModule> compiledModule;
+};
 
-	// Compile the module.
-	jitModule->compile(llvmModule);
+bool Runtime::savePrecompiledModule(ModuleInstance* moduleInstance,
+									const IR::Module& module,
+									const std::string& filename)
+{
+	JITModule* jitModule = static_cast<JITModule*>(moduleInstance->jitModule);
+	if(jitModule->tierUpCounters || jitModule->isLazyFunctionDefCompiled.size())
+	{
+		Log::printf(Log::error,
+					"Can't save a precompiled module for a module instance that was compiled with "
+					"tiered or lazy compilation\n");
+		return false;
+	}
+
+	const CompiledModule& compiledModule = *jitModule->compiledModule;
+	return writePrecompiledModuleFile(filename,
+									  module,
+									  compiledModule.key,
+									  compiledModule.optimizationLevel,
+									  compiledModule.objects);
+}
+
+PrecompiledModule* Runtime::loadPrecompiledModule(const std::string& filename)
+{
+	auto precompiledModule            = new PrecompiledModule;
+	precompiledModule->compiledModule = std::make_shared<CompiledModule>();
+	CompiledModule& compiledModule    = *precompiledModule->compiledModule;
+	compiledModule.cachedObjectBuffer = readPrecompiledModuleFile(filename,
+																  precompiledModule->module,
+																  compiledModule.key,
+																  compiledModule.optimizationLevel,
+																  compiledModule.objects);
+	if(!compiledModule.cachedObjectBuffer)
+	{
+		delete precompiledModule;
+		return nullptr;
+	}
+	return precompiledModule;
+}
+
+void Runtime::deletePrecompiledModule(PrecompiledModule* precompiledModule)
+{
+	delete precompiledModule;
+}
+
+const IR::Module& Runtime::getPrecompiledModuleIR(PrecompiledModule* precompiledModule)
+{
+	return precompiledModule->module;
+}
+
+bool LLVMJIT::instantiatePrecompiledModule(ModuleInstance* moduleInstance,
+											PrecompiledModule* precompiledModule)
+{
+	Timing::Timer loadTimer;
+
+	// The object code was checked against the host's target when it was loaded, but also depends
+	// on the calling conventions of the functions the instance's imports are bound to, and on
+	// whether debug info is enabled.
+	const IR::Module& module                       = precompiledModule->module;
+	std::shared_ptr<CompiledModule> compiledModule = precompiledModule->compiledModule;
+
+	const OptimizationLevel optimizationLevel = compiledModule->optimizationLevel;
+	const bool hasDebugInfo                   = isDebugInfoEnabled();
+
+	const ObjectCacheKey key = getObjectCacheKey(
+		module, moduleInstance, CodeTier::untiered, optimizationLevel, false, hasDebugInfo);
+	if(!(key == compiledModule->key))
+	{
+		// Check whether the key matches with the debug info setting reversed to report which of
+		// them differs.
+		if(getObjectCacheKey(
+			   module, moduleInstance, CodeTier::untiered, optimizationLevel, false, !hasDebugInfo)
+		   == compiledModule->key)
+		{
+			Log::printf(Log::error,
+						"Precompiled module was compiled with debug info %s\n",
+						hasDebugInfo ? "disabled" : "enabled");
+		}
+		else
+		{
+			Log::printf(Log::error,
+						"Precompiled module was compiled for imports with different calling "
+						"conventions\n");
+		}
+		return false;
+	}
+
+	auto jitModule            = new JITModule(moduleInstance);
+	moduleInstance->jitModule = jitModule;
+	jitModule->compiledModule = compiledModule;
+
+	ModuleInstanceResolver resolver(module, moduleInstance);
+	jitModule->load(compiledModule->objects, resolver);
+	jitModule->publishFunctionDefs();
+
+	Timing::logTimer("Instantiated precompiled module", loadTimer);
+	return true;
+}
+
+std::atomic<I32>* LLVMJIT::getTierUpCounter(ModuleInstance* moduleInstance, Uptr functionDefIndex)
+{
+	JITModule* jitModule = static_cast<JITModule*>(moduleInstance->jitModule);
+	wavmAssert(jitModule && jitModule->tierUpCounters);
+	wavmAssert(functionDefIndex < moduleInstance->functionDefs.size());
+	return &jitModule->tierUpCounters[functionDefIndex];
+}
+
+// Compiles a function of an instantiated module using the current thread's LLVM state, and replaces
+// the function's current code with the compiled code.
+static void compileFunction(FunctionInstance* function,
+							Uptr functionDefIndex,
+							CodeTier tier,
+							const char* metricName)
+{
+	Timing::Timer compileTimer;
+
+	ModuleInstance* moduleInstance = function->moduleInstance;
+	JITModule* jitModule           = static_cast<JITModule*>(moduleInstance->jitModule);
+	const IR::Module& module       = *jitModule->compiledModule->module;
+	wavmAssert(functionDefIndex < moduleInstance->functionDefs.size());
+	wavmAssert(moduleInstance->functionDefs[functionDefIndex] == function);
+
+	auto llvmModule
+		= emitModule(module, moduleInstance, functionDefIndex, functionDefIndex + 1, tier);
+	std::vector<ObjectBinary> objects;
+	objects.push_back(
+		compileModule(*llvmModule, false, tier, jitModule->compiledModule->optimizationLevel));
+
+	// Load the compiled code, and switch calls to the function and the table elements that
+	// reference it to the compiled code. The replaced code is kept until the module instance is
+	// deleted, since other threads may still be executing it.
+	auto functionUnit = llvm::make_unique<JITModule>(moduleInstance);
+	ModuleInstanceResolver resolver(module, moduleInstance);
+	functionUnit->load(objects, resolver);
+	functionUnit->publishFunctionDefs();
+	{
+		Lock<Platform::Mutex> functionUnitsLock(jitModule->functionUnitsMutex);
+		jitModule->functionUnits.push_back(std::move(functionUnit));
+	}
+	updateTableElementsForFunction(function);
+
+	Timing::logTimer(metricName, compileTimer);
+}
+
+void LLVMJIT::requestTierUp(FunctionInstance* function, Uptr functionDefIndex)
+{
+	// Ignore the request if the function was already queued for tier-up.
+	JITModule* jitModule = static_cast<JITModule*>(function->moduleInstance->jitModule);
+	wavmAssert(jitModule->isTierUpRequested);
+	wavmAssert(functionDefIndex < function->moduleInstance->functionDefs.size());
+	if(jitModule->isTierUpRequested[functionDefIndex].exchange(true)) { return; }
+
+	// Keep the function and its module instance alive until it has been recompiled.
+	addGCRoot(function);
+
+	tierUpThread->queueJob([function, functionDefIndex]() {
+		compileFunction(
+			function, functionDefIndex, CodeTier::optimized, "Compiled function at optimized tier");
+		removeGCRoot(function);
+		++numTieredUpFunctions;
+	});
+}
+
+void LLVMJIT::compileLazyFunction(FunctionInstance* function, Uptr functionDefIndex)
+{
+	ModuleInstance* moduleInstance = function->moduleInstance;
+	JITModule* jitModule           = static_cast<JITModule*>(moduleInstance->jitModule);
+	wavmAssert(functionDefIndex < jitModule->isLazyFunctionDefCompiled.size());
+	const CodeTier tier = jitModule->tierUpCounters ? CodeTier::baseline : CodeTier::optimized;
+
+	// Another thread may have compiled the function while this thread waited for the lock.
+	Lock<Platform::Mutex> lazyCompileLock(jitModule->lazyCompileMutex);
+	if(jitModule->isLazyFunctionDefCompiled[functionDefIndex]) { return; }
+
+	lazyCompileThread->runJob([function, functionDefIndex, tier]() {
+		compileFunction(function, functionDefIndex, tier, "Lazily compiled function");
+	});
+
+	jitModule->isLazyFunctionDefCompiled[functionDefIndex] = true;
 }
 
 std::string LLVMJIT::getExternalFunctionName(ModuleInstance* moduleInstance, Uptr functionDefIndex)
@@ -841,13 +1880,17 @@ bool LLVMJIT::getFunctionIndexFromExternalName(const char* externalName, Uptr& o
 
 bool LLVMJIT::describeInstructionPointer(Uptr ip, std::string& outDescription)
 {
-	JITSymbol* symbol;
-	{
-		Lock<Platform::Mutex> addressToSymbolMapLock(addressToSymbolMapMutex);
-		auto symbolIt = addressToSymbolMap.upper_bound(ip);
-		if(symbolIt == addressToSymbolMap.end()) { return false; }
-		symbol = symbolIt->second;
-	}
+	// Find the first symbol that ends after the IP.
+	JITSymbolTableReadScope readScope;
+	if(!readScope.table) { return false; }
+	auto entryIt = std::upper_bound(
+		readScope.table->begin(),
+		readScope.table->end(),
+		ip,
+		[](Uptr ip, const JITSymbolTableEntry& entry) { return ip < entry.endAddress; });
+	if(entryIt == readScope.table->end()) { return false; }
+
+	const JITSymbol* symbol = entryIt->symbol;
 	if(ip < symbol->baseAddress || ip >= symbol->baseAddress + symbol->numBytes) { return false; }
 
 	switch(symbol->type)
@@ -858,21 +1901,23 @@ bool LLVMJIT::describeInstructionPointer(Uptr ip, std::string& outDescription)
 		outDescription += symbol->functionInstance->moduleInstance->debugName;
 		outDescription += '!';
 		outDescription += symbol->functionInstance->debugName;
-		outDescription += '+';
 
-		// Find the highest entry in the offsetToOpIndexMap whose offset is <= the symbol-relative
+		// The offsetToOpIndexTable is only generated with debug info, so without it, the op that
+		// the IP is in is unknown.
+		if(symbol->offsetToOpIndexTable.empty()) { return true; }
+
+		// Find the last entry in the offsetToOpIndexTable whose offset is <= the symbol-relative
 		// IP.
-		U32 ipOffset = (U32)(ip - symbol->baseAddress);
-		Iptr opIndex = -1;
-		for(auto offsetMapIt : symbol->offsetToOpIndexMap)
-		{
-			if(offsetMapIt.first <= ipOffset) { opIndex = offsetMapIt.second; }
-			else
-			{
-				break;
-			}
-		}
-		outDescription += std::to_string(opIndex >= 0 ? opIndex : 0);
+		const U32 ipOffset = (U32)(ip - symbol->baseAddress);
+		auto offsetIt      = std::upper_bound(
+            symbol->offsetToOpIndexTable.begin(),
+            symbol->offsetToOpIndexTable.end(),
+            ipOffset,
+            [](U32 ipOffset, const std::pair<U32, U32>& entry) { return ipOffset < entry.first; });
+		const U32 opIndex
+			= offsetIt == symbol->offsetToOpIndexTable.begin() ? 0 : (offsetIt - 1)->second;
+		outDescription += '+';
+		outDescription += std::to_string(opIndex);
 
 		return true;
 	}
@@ -889,15 +1934,17 @@ bool LLVMJIT::describeInstructionPointer(Uptr ip, std::string& outDescription)
 InvokeFunctionPointer LLVMJIT::getInvokeThunk(FunctionType functionType,
 											  CallingConvention callingConvention)
 {
-	Lock<Platform::Mutex> llvmLock(llvmMutex);
-
-	initLLVM();
+	Lock<Platform::Mutex> thunkLock(thunkMutex);
 
 	// Reuse cached invoke thunks for the same function type.
 	JITSymbol*& invokeThunkSymbol = invokeThunkTypeToSymbolMap.getOrAdd(functionType, nullptr);
 	if(invokeThunkSymbol)
 	{ return reinterpret_cast<InvokeFunctionPointer>(invokeThunkSymbol->baseAddress); }
 
+	// Compile the thunk with the LLVM state reserved for thunks.
+	if(!thunkLLVMState) { thunkLLVMState = new LLVMThreadState(); }
+	LLVMThreadStateScope thunkLLVMStateScope(*thunkLLVMState);
+
 	auto llvmModuleSharedPtr = std::make_shared<llvm::Module>("", *llvmContext);
 	auto llvmModule          = llvmModuleSharedPtr.get();
 	auto llvmFunctionType    = llvm::FunctionType::get(
@@ -971,41 +2018,212 @@ InvokeFunctionPointer LLVMJIT::getInvokeThunk(FunctionType functionType,
 
 	wavmAssert(jitUnit->symbol);
 	invokeThunkSymbol = jitUnit->symbol;
-
-	{
-		Lock<Platform::Mutex> addressToSymbolMapLock(addressToSymbolMapMutex);
-		addressToSymbolMap[jitUnit->symbol->baseAddress + jitUnit->symbol->numBytes]
-			= jitUnit->symbol;
-	}
+	addJITSymbol(jitUnit->symbol);
 
 	return reinterpret_cast<InvokeFunctionPointer>(invokeThunkSymbol->baseAddress);
 }
 
-void* LLVMJIT::getIntrinsicThunk(void* nativeFunction,
-								 FunctionType functionType,
-								 CallingConvention callingConvention)
+InvokeBatchFunctionPointer LLVMJIT::getInvokeBatchThunk(FunctionType functionType,
+														CallingConvention callingConvention)
 {
-	wavmAssert(callingConvention == CallingConvention::intrinsic
-			   || callingConvention == CallingConvention::intrinsicWithContextSwitch
-			   || callingConvention == CallingConvention::intrinsicWithMemAndTable);
+	Lock<Platform::Mutex> thunkLock(thunkMutex);
 
-	Lock<Platform::Mutex> llvmLock(llvmMutex);
+	// Reuse cached batch invoke thunks for the same function type and calling convention.
+	JITSymbol*& invokeBatchThunkSymbol = invokeBatchThunkTypeToSymbolMap[std::make_pair(
+		functionType.getEncoding().impl, callingConvention)];
+	if(invokeBatchThunkSymbol)
+	{ return reinterpret_cast<InvokeBatchFunctionPointer>(invokeBatchThunkSymbol->baseAddress); }
 
-	initLLVM();
+	// Compile the thunk with the LLVM state reserved for thunks.
+	if(!thunkLLVMState) { thunkLLVMState = new LLVMThreadState(); }
+	LLVMThreadStateScope thunkLLVMStateScope(*thunkLLVMState);
 
-	// Reuse cached intrinsic thunks for the same function type.
-	JITSymbol*& intrinsicThunkSymbol
-		= intrinsicFunctionToThunkSymbolMap.getOrAdd(nativeFunction, nullptr);
-	if(intrinsicThunkSymbol) { return reinterpret_cast<void*>(intrinsicThunkSymbol->baseAddress); }
+	auto llvmModuleSharedPtr = std::make_shared<llvm::Module>("", *llvmContext);
+	auto llvmModule          = llvmModuleSharedPtr.get();
+	auto llvmFunctionType    = llvm::FunctionType::get(
+        llvmI8PtrType,
+        {asLLVMType(functionType, callingConvention)->getPointerTo(),
+         llvmI8PtrType,
+         llvmI8PtrType,
+         llvmI8PtrType,
+         llvmI64Type,
+         llvmI64Type->getPointerTo()},
+        false);
+	auto llvmFunction = llvm::Function::Create(
+		llvmFunctionType, llvm::Function::ExternalLinkage, "thunk", llvmModule);
+	llvm::Value* functionPointer    = &*(llvmFunction->args().begin() + 0);
+	llvm::Value* contextPointer     = &*(llvmFunction->args().begin() + 1);
+	llvm::Value* argumentsPointer   = &*(llvmFunction->args().begin() + 2);
+	llvm::Value* resultsPointer     = &*(llvmFunction->args().begin() + 3);
+	llvm::Value* numInvokes         = &*(llvmFunction->args().begin() + 4);
+	llvm::Value* invokeIndexPointer = &*(llvmFunction->args().begin() + 5);
+
+	EmitContext emitContext(nullptr, nullptr);
+	llvm::IRBuilder<>& irBuilder = emitContext.irBuilder;
+	auto entryBlock = llvm::BasicBlock::Create(*llvmContext, "entry", llvmFunction);
+	auto loopBlock  = llvm::BasicBlock::Create(*llvmContext, "loop", llvmFunction);
+	auto bodyBlock  = llvm::BasicBlock::Create(*llvmContext, "body", llvmFunction);
+	auto exitBlock  = llvm::BasicBlock::Create(*llvmContext, "exit", llvmFunction);
+	irBuilder.SetInsertPoint(entryBlock);
+
+	emitContext.contextPointerVariable = irBuilder.CreateAlloca(llvmI8PtrType);
+	irBuilder.CreateStore(contextPointer, emitContext.contextPointerVariable);
+	irBuilder.CreateBr(loopBlock);
+
+	// Loop over the invokes in the batch.
+	irBuilder.SetInsertPoint(loopBlock);
+	llvm::PHINode* invokeIndex = irBuilder.CreatePHI(llvmI64Type, 2);
+	invokeIndex->addIncoming(emitLiteral(U64(0)), entryBlock);
+	irBuilder.CreateCondBr(irBuilder.CreateICmpULT(invokeIndex, numInvokes), bodyBlock, exitBlock);
+
+	// Before each invoke, write its index to memory provided by the caller, so the caller can
+	// tell which invoke a trap occurred in, and resume the batch after it.
+	irBuilder.SetInsertPoint(bodyBlock);
+	irBuilder.CreateStore(invokeIndex, invokeIndexPointer);
+
+	// Load the invoke's arguments from the caller's array of UntaggedValues: each invoke's
+	// arguments follow those of the previous invoke.
+	const Uptr numParams                = functionType.params().size();
+	const Uptr numResults               = functionType.results().size();
+	llvm::Value* invokeArgumentsPointer = irBuilder.CreateInBoundsGEP(
+		argumentsPointer,
+		{irBuilder.CreateMul(invokeIndex, emitLiteral(U64(numParams * sizeof(UntaggedValue))))});
+	std::vector<llvm::Value*> arguments;
+	for(Uptr paramIndex = 0; paramIndex < numParams; ++paramIndex)
+	{
+		llvm::LoadInst* argument = irBuilder.CreateLoad(irBuilder.CreatePointerCast(
+			irBuilder.CreateInBoundsGEP(invokeArgumentsPointer,
+										{emitLiteral(U64(paramIndex * sizeof(UntaggedValue)))}),
+			asLLVMType(functionType.params()[paramIndex])->getPointerTo()));
+		argument->setAlignment(alignof(UntaggedValue));
+		arguments.push_back(argument);
+	}
+
+	// Call the function.
+	ValueVector results
+		= emitContext.emitCallOrInvoke(functionPointer, arguments, functionType, callingConvention);
+
+	// Write the invoke's results to the caller's array of UntaggedValues.
+	wavmAssert(results.size() == numResults);
+	llvm::Value* invokeResultsPointer = irBuilder.CreateInBoundsGEP(
+		resultsPointer,
+		{irBuilder.CreateMul(invokeIndex, emitLiteral(U64(numResults * sizeof(UntaggedValue))))});
+	for(Uptr resultIndex = 0; resultIndex < numResults; ++resultIndex)
+	{
+		llvm::StoreInst* store = irBuilder.CreateStore(
+			results[resultIndex],
+			irBuilder.CreatePointerCast(
+				irBuilder.CreateInBoundsGEP(
+					invokeResultsPointer, {emitLiteral(U64(resultIndex * sizeof(UntaggedValue)))}),
+				asLLVMType(functionType.results()[resultIndex])->getPointerTo()));
+		store->setAlignment(alignof(UntaggedValue));
+	}
+
+	invokeIndex->addIncoming(irBuilder.CreateAdd(invokeIndex, emitLiteral(U64(1))),
+							 irBuilder.GetInsertBlock());
+	irBuilder.CreateBr(loopBlock);
+
+	irBuilder.SetInsertPoint(exitBlock);
+	irBuilder.CreateRet(irBuilder.CreateLoad(emitContext.contextPointerVariable));
+
+	// Compile the batch invoke thunk.
+	auto jitUnit = new JITThunkUnit(functionType);
+	jitUnit->compile(llvmModuleSharedPtr);
+
+	wavmAssert(jitUnit->symbol);
+	invokeBatchThunkSymbol = jitUnit->symbol;
+	addJITSymbol(jitUnit->symbol);
+
+	return reinterpret_cast<InvokeBatchFunctionPointer>(invokeBatchThunkSymbol->baseAddress);
+}
+
+void* LLVMJIT::getTypedInvokeThunk(FunctionType functionType, CallingConvention callingConvention)
+{
+	Lock<Platform::Mutex> thunkLock(thunkMutex);
+
+	// Reuse cached typed invoke thunks for the same function type and calling convention.
+	JITSymbol*& typedInvokeThunkSymbol = typedInvokeThunkTypeToSymbolMap[std::make_pair(
+		functionType.getEncoding().impl, callingConvention)];
+	if(typedInvokeThunkSymbol)
+	{ return reinterpret_cast<void*>(typedInvokeThunkSymbol->baseAddress); }
+
+	// Compile the thunk with the LLVM state reserved for thunks.
+	if(!thunkLLVMState) { thunkLLVMState = new LLVMThreadState(); }
+	LLVMThreadStateScope thunkLLVMStateScope(*thunkLLVMState);
+
+	// The thunk returns at most one result directly with the C calling convention.
+	wavmAssert(functionType.results().size() <= 1);
+	llvm::Type* llvmResultType = functionType.results().size()
+									 ? asLLVMType(functionType.results()[0])
+									 : llvmVoidType;
+
+	std::vector<llvm::Type*> llvmParamTypes;
+	llvmParamTypes.push_back(llvmI8PtrType->getPointerTo());
+	llvmParamTypes.push_back(llvmI8PtrType);
+	for(ValueType paramType : functionType.params())
+	{ llvmParamTypes.push_back(asLLVMType(paramType)); }
 
-	// Create a LLVM module containing a single function with the same signature as the native
-	// function, but with the WASM calling convention.
 	auto llvmModuleSharedPtr = std::make_shared<llvm::Module>("", *llvmContext);
 	auto llvmModule          = llvmModuleSharedPtr.get();
-	auto llvmFunctionType    = asLLVMType(functionType, CallingConvention::wasm);
+	auto llvmFunctionType    = llvm::FunctionType::get(llvmResultType, llvmParamTypes, false);
 	auto llvmFunction        = llvm::Function::Create(
-        llvmFunctionType, llvm::Function::ExternalLinkage, "thunk", llvmModule);
-	llvmFunction->setCallingConv(asLLVMCallingConv(callingConvention));
+		llvmFunctionType, llvm::Function::ExternalLinkage, "thunk", llvmModule);
+	auto argIt                         = llvmFunction->args().begin();
+	llvm::Value* nativeFunctionPointer = &*argIt++;
+	llvm::Value* contextPointer        = &*argIt++;
+	std::vector<llvm::Value*> arguments;
+	while(argIt != llvmFunction->args().end()) { arguments.push_back(&*argIt++); }
+
+	EmitContext emitContext(nullptr, nullptr);
+	emitContext.irBuilder.SetInsertPoint(
+		llvm::BasicBlock::Create(*llvmContext, "entry", llvmFunction));
+
+	emitContext.contextPointerVariable = emitContext.irBuilder.CreateAlloca(llvmI8PtrType);
+	emitContext.irBuilder.CreateStore(contextPointer, emitContext.contextPointerVariable);
+
+	// Load the function's current code pointer, and call it with the thunk's arguments.
+	llvm::Value* functionPointer = emitContext.irBuilder.CreatePointerCast(
+		emitContext.irBuilder.CreateLoad(nativeFunctionPointer),
+		asLLVMType(functionType, callingConvention)->getPointerTo());
+	ValueVector results
+		= emitContext.emitCallOrInvoke(functionPointer, arguments, functionType, callingConvention);
+
+	// Return the function's result directly.
+	wavmAssert(results.size() == functionType.results().size());
+	if(results.size()) { emitContext.irBuilder.CreateRet(results[0]); }
+	else
+	{
+		emitContext.irBuilder.CreateRetVoid();
+	}
+
+	// Compile the typed invoke thunk.
+	auto jitUnit = new JITThunkUnit(functionType);
+	jitUnit->compile(llvmModuleSharedPtr);
+
+	wavmAssert(jitUnit->symbol);
+	typedInvokeThunkSymbol = jitUnit->symbol;
+	addJITSymbol(jitUnit->symbol);
+
+	return reinterpret_cast<void*>(typedInvokeThunkSymbol->baseAddress);
+}
+
+// Emits a thunk with the WASM calling convention that calls a native function.
+static void emitIntrinsicThunk(llvm::Module* llvmModule,
+							   const std::string& name,
+							   void* nativeFunction,
+							   FunctionType functionType,
+							   CallingConvention callingConvention)
+{
+	wavmAssert(callingConvention == CallingConvention::intrinsic
+			   || callingConvention == CallingConvention::intrinsicWithContextSwitch
+			   || callingConvention == CallingConvention::intrinsicWithMemAndTable);
+
+	// Create a function with the same signature as the native function, but with the WASM calling
+	// convention.
+	auto llvmFunctionType = asLLVMType(functionType, CallingConvention::wasm);
+	auto llvmFunction     = llvm::Function::Create(
+        llvmFunctionType, llvm::Function::ExternalLinkage, name, llvmModule);
+	llvmFunction->setCallingConv(asLLVMCallingConv(CallingConvention::wasm));
 
 	EmitContext emitContext(nullptr, nullptr);
 	emitContext.irBuilder.SetInsertPoint(
@@ -1027,27 +2245,87 @@ void* LLVMJIT::getIntrinsicThunk(void* nativeFunction,
 
 	// Emit the function return.
 	emitContext.emitReturn(functionType.results(), results);
+}
+
+// Compiles the thunks for any of the given native functions that don't already have a cached thunk
+// in a single JIT unit. The caller must hold thunkMutex.
+static void compileIntrinsicThunksLocked(const std::vector<FunctionInstance*>& functions)
+{
+	// Find the native functions that don't have a thunk yet.
+	std::vector<FunctionInstance*> uncachedFunctions;
+	std::vector<FunctionType> uncachedFunctionTypes;
+	for(FunctionInstance* function : functions)
+	{
+		if(function->callingConvention != CallingConvention::wasm
+		   && intrinsicFunctionToThunkSymbolMap.add(function->nativeFunction, nullptr))
+		{
+			uncachedFunctions.push_back(function);
+			uncachedFunctionTypes.push_back(function->type);
+		}
+	}
+	if(!uncachedFunctions.size()) { return; }
+
+	// Compile the thunks with the LLVM state reserved for thunks.
+	if(!thunkLLVMState) { thunkLLVMState = new LLVMThreadState(); }
+	LLVMThreadStateScope thunkLLVMStateScope(*thunkLLVMState);
+
+	// Create a LLVM module containing a thunk for each native function.
+	auto llvmModuleSharedPtr = std::make_shared<llvm::Module>("", *llvmContext);
+	for(Uptr thunkIndex = 0; thunkIndex < uncachedFunctions.size(); ++thunkIndex)
+	{
+		FunctionInstance* function = uncachedFunctions[thunkIndex];
+		emitIntrinsicThunk(llvmModuleSharedPtr.get(),
+						   "thunk" + std::to_string(thunkIndex),
+						   function->nativeFunction,
+						   function->type,
+						   function->callingConvention);
+	}
 
 	// Compile the LLVM IR to machine code.
-	auto jitUnit = new JITThunkUnit(functionType);
+	auto jitUnit = new JITIntrinsicThunkUnit(std::move(uncachedFunctionTypes));
 	jitUnit->compile(llvmModuleSharedPtr);
 
-	wavmAssert(jitUnit->symbol);
-	intrinsicThunkSymbol = jitUnit->symbol;
+	for(Uptr thunkIndex = 0; thunkIndex < uncachedFunctions.size(); ++thunkIndex)
+	{
+		JITSymbol* symbol = jitUnit->symbols[thunkIndex];
+		wavmAssert(symbol);
+		intrinsicFunctionToThunkSymbolMap.set(uncachedFunctions[thunkIndex]->nativeFunction,
+											  symbol);
+		addJITSymbol(symbol);
+	}
+}
+
+void LLVMJIT::compileIntrinsicThunks(const std::vector<FunctionInstance*>& functions)
+{
+	Lock<Platform::Mutex> thunkLock(thunkMutex);
+	compileIntrinsicThunksLocked(functions);
+}
 
+void* LLVMJIT::getIntrinsicThunk(FunctionInstance* function)
+{
+	wavmAssert(function->callingConvention != CallingConvention::wasm);
+
+	Lock<Platform::Mutex> thunkLock(thunkMutex);
+
+	// Reuse the cached thunk for the native function, which is usually compiled when the intrinsic
+	// module that defines the function is instantiated.
+	JITSymbol* const* intrinsicThunkSymbol
+		= intrinsicFunctionToThunkSymbolMap.get(function->nativeFunction);
+	if(!intrinsicThunkSymbol)
 	{
-		Lock<Platform::Mutex> addressToSymbolMapLock(addressToSymbolMapMutex);
-		addressToSymbolMap[jitUnit->symbol->baseAddress + jitUnit->symbol->numBytes]
-			= jitUnit->symbol;
+		compileIntrinsicThunksLocked({function});
+		intrinsicThunkSymbol = intrinsicFunctionToThunkSymbolMap.get(function->nativeFunction);
 	}
 
-	return reinterpret_cast<void*>(intrinsicThunkSymbol->baseAddress);
+	wavmAssert(intrinsicThunkSymbol && *intrinsicThunkSymbol);
+	return reinterpret_cast<void*>((*intrinsicThunkSymbol)->baseAddress);
 }
 
 static void initLLVM()
 {
-	if(llvmContext) { return; }
-	llvmContext = new llvm::LLVMContext();
+	Lock<Platform::Mutex> llvmInitLock(llvmInitMutex);
+	if(isLLVMInitialized) { return; }
+	isLLVMInitialized = true;
 
 	llvm::InitializeNativeTarget();
 	llvm::InitializeNativeTargetAsmPrinter();
@@ -1055,15 +2333,77 @@ static void initLLVM()
 	llvm::InitializeNativeTargetDisassembler();
 	llvm::sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
 
+	if(!gdbRegistrationListener)
+	{ gdbRegistrationListener = llvm::JITEventListener::createGDBRegistrationListener(); }
+}
+
+std::vector<std::string> LLVMJIT::getTargetAttributes()
+{
+	// Enable all the features that the host CPU supports. The CPU name alone doesn't account for
+	// features that are disabled by the OS or missing from a virtualized CPU, and doesn't enable
+	// features of CPUs that LLVM doesn't know the name of.
+	std::vector<std::string> attributes;
+	llvm::StringMap<bool> hostFeatures;
+	if(llvm::sys::getHostCPUFeatures(hostFeatures))
+	{
+		for(const auto& feature : hostFeatures)
+		{ attributes.push_back((feature.second ? "+" : "-") + feature.first().str()); }
+		std::sort(attributes.begin(), attributes.end());
+	}
+
+	// Add the attributes the build was configured with after the host features so they override
+	// them.
+	for(const std::string& attribute : std::vector<std::string>{LLVM_TARGET_ATTRIBUTES})
+	{ attributes.push_back(attribute); }
+
+	return attributes;
+}
+
+static llvm::TargetMachine* createTargetMachine()
+{
 	auto targetTriple = llvm::sys::getProcessTriple();
 #ifdef __APPLE__
 	// Didn't figure out exactly why, but this works around a problem with the MacOS dynamic loader.
 	// Without it, our symbols can't be found in the JITed object file.
 	targetTriple += "-elf";
 #endif
-	llvm::SmallVector<std::string, 0> machineAttrs = {LLVM_TARGET_ATTRIBUTES};
-	targetMachine                                  = llvm::EngineBuilder().selectTarget(
-        llvm::Triple(targetTriple), "", llvm::sys::getHostCPUName(), machineAttrs);
+	const std::vector<std::string> targetAttributes = getTargetAttributes();
+	llvm::SmallVector<std::string, 0> machineAttrs(targetAttributes.begin(),
+												   targetAttributes.end());
+	return llvm::EngineBuilder().selectTarget(
+		llvm::Triple(targetTriple), "", llvm::sys::getHostCPUName(), machineAttrs);
+}
+
+LLVMThreadState::LLVMThreadState()
+{
+	initLLVM();
+	context       = new llvm::LLVMContext();
+	targetMachine = createTargetMachine();
+}
+
+LLVMThreadState::~LLVMThreadState()
+{
+	delete targetMachine;
+	delete context;
+}
+
+static void initLLVMTypes()
+{
+	if(!llvmContext)
+	{
+		llvmI8Type = llvmI16Type = llvmI32Type = llvmI64Type = nullptr;
+		llvmF32Type = llvmF64Type = nullptr;
+		llvmVoidType = llvmBoolType = llvmI8PtrType = nullptr;
+#if defined(_WIN64)
+		llvmExceptionPointersStructType = nullptr;
+#endif
+		llvmI8x16Type = llvmI16x8Type = llvmI32x4Type = llvmI64x2Type = nullptr;
+		llvmF32x4Type = llvmF64x2Type = nullptr;
+
+		memset(llvmValueTypes, 0, sizeof(llvmValueTypes));
+		memset(typedZeroConstants, 0, sizeof(typedZeroConstants));
+		return;
+	}
 
 	llvmI8Type    = llvm::Type::getInt8Ty(*llvmContext);
 	llvmI16Type   = llvm::Type::getInt16Ty(*llvmContext);
@@ -1110,35 +2450,49 @@ static void initLLVM()
 	typedZeroConstants[(Uptr)ValueType::f64]  = emitLiteral((F64)0.0);
 	typedZeroConstants[(Uptr)ValueType::v128] = llvm::ConstantVector::get(
 		{typedZeroConstants[(Uptr)ValueType::i64], typedZeroConstants[(Uptr)ValueType::i64]});
-
-	if(!gdbRegistrationListener)
-	{ gdbRegistrationListener = llvm::JITEventListener::createGDBRegistrationListener(); }
 }
 
+void Runtime::setMaxCompileThreads(Uptr numThreads) { maxCompileThreads = numThreads; }
+
+void Runtime::setTieredCompilation(bool enable) { isTieredCompilationEnabled = enable; }
+
+void Runtime::setLazyCompilation(bool enable) { isLazyCompilationEnabled = enable; }
+
+Uptr Runtime::getNumTieredUpFunctions() { return numTieredUpFunctions; }
+
+void Runtime::waitForTierUp() { tierUpThread->waitUntilIdle(); }
+
+void Runtime::setDebugInfo(bool enable) { isDebugInfoEnabledFlag = enable; }
+
+void Runtime::setRelaxedMemoryTraps(bool enable) { areMemoryTrapsRelaxedFlag = enable; }
+
+void Runtime::setPerfMapEnabled(bool enable) { isPerfMapEnabled = enable; }
+
+void Runtime::setGDBRegistration(bool enable) { isGDBRegistrationEnabled = enable; }
+
+bool LLVMJIT::isDebugInfoEnabled() { return isDebugInfoEnabledFlag; }
+
+bool LLVMJIT::areMemoryTrapsRelaxed() { return areMemoryTrapsRelaxedFlag; }
+
 namespace LLVMJIT
 {
 	RUNTIME_API void deinit()
 	{
-		Lock<Platform::Mutex> llvmLock(llvmMutex);
+		// Finish the running background instantiations, and wait for the instantiation threads to
+		// exit.
+		Runtime::shutdownAsyncInstantiationThreads();
 
-		if(llvmContext)
-		{
-			delete llvmContext;
-			llvmContext = nullptr;
+		// Finish recompiling the functions queued for tier-up, and wait for the compile threads to
+		// exit.
+		tierUpThread->shutdown();
+		lazyCompileThread->shutdown();
 
-			delete targetMachine;
-			targetMachine = nullptr;
+		Lock<Platform::Mutex> thunkLock(thunkMutex);
 
-			llvmI8Type = llvmI16Type = llvmI32Type = llvmI64Type = nullptr;
-			llvmF32Type = llvmF64Type = nullptr;
-			llvmVoidType = llvmBoolType = llvmI8PtrType = nullptr;
-#if defined(_WIN64)
-			llvmExceptionPointersStructType = nullptr;
-#endif
-			llvmI8x16Type = llvmI16x8Type = llvmI32x4Type = llvmI64x2Type = nullptr;
-
-			memset(llvmValueTypes, 0, sizeof(llvmValueTypes));
-			memset(typedZeroConstants, 0, sizeof(typedZeroConstants));
+		if(thunkLLVMState)
+		{
+			delete thunkLLVMState;
+			thunkLLVMState = nullptr;
 		}
 	}
 }
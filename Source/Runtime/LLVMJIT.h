@@ -19,6 +19,7 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
+#include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/DataTypes.h"
 
 #include "LLVMPostInclude.h"
@@ -26,6 +27,7 @@
 namespace llvm
 {
 	class LoadedObjectInfo;
+	class MemoryBuffer;
 
 	namespace object
 	{
@@ -38,35 +40,36 @@ namespace LLVMJIT
 	typedef llvm::SmallVector<llvm::Value*, 1> ValueVector;
 	typedef llvm::SmallVector<llvm::PHINode*, 1> PHIVector;
 
-	// The global LLVM context.
-	extern llvm::LLVMContext* llvmContext;
+	// The LLVM context used by the current thread. Each compile thread uses its own context, so the
+	// LLVM types and constants below are also per-thread.
+	extern thread_local llvm::LLVMContext* llvmContext;
 
 	// Maps a type ID to the corresponding LLVM type.
-	extern llvm::Type* llvmValueTypes[Uptr(ValueType::num)];
-
-	extern llvm::Type* llvmI8Type;
-	extern llvm::Type* llvmI16Type;
-	extern llvm::Type* llvmI32Type;
-	extern llvm::Type* llvmI64Type;
-	extern llvm::Type* llvmF32Type;
-	extern llvm::Type* llvmF64Type;
-	extern llvm::Type* llvmVoidType;
-	extern llvm::Type* llvmBoolType;
-	extern llvm::Type* llvmI8PtrType;
-
-	extern llvm::Type* llvmI8x16Type;
-	extern llvm::Type* llvmI16x8Type;
-	extern llvm::Type* llvmI32x4Type;
-	extern llvm::Type* llvmI64x2Type;
-	extern llvm::Type* llvmF32x4Type;
-	extern llvm::Type* llvmF64x2Type;
+	extern thread_local llvm::Type* llvmValueTypes[Uptr(ValueType::num)];
+
+	extern thread_local llvm::Type* llvmI8Type;
+	extern thread_local llvm::Type* llvmI16Type;
+	extern thread_local llvm::Type* llvmI32Type;
+	extern thread_local llvm::Type* llvmI64Type;
+	extern thread_local llvm::Type* llvmF32Type;
+	extern thread_local llvm::Type* llvmF64Type;
+	extern thread_local llvm::Type* llvmVoidType;
+	extern thread_local llvm::Type* llvmBoolType;
+	extern thread_local llvm::Type* llvmI8PtrType;
+
+	extern thread_local llvm::Type* llvmI8x16Type;
+	extern thread_local llvm::Type* llvmI16x8Type;
+	extern thread_local llvm::Type* llvmI32x4Type;
+	extern thread_local llvm::Type* llvmI64x2Type;
+	extern thread_local llvm::Type* llvmF32x4Type;
+	extern thread_local llvm::Type* llvmF64x2Type;
 
 #if defined(_WIN64)
-	extern llvm::Type* llvmExceptionPointersStructType;
+	extern thread_local llvm::Type* llvmExceptionPointersStructType;
 #endif
 
 	// Zero constants of each type.
-	extern llvm::Constant* typedZeroConstants[(Uptr)ValueType::num];
+	extern thread_local llvm::Constant* typedZeroConstants[(Uptr)ValueType::num];
 
 	// Overloaded functions that compile a literal value to a LLVM constant of the right type.
 	inline llvm::ConstantInt* emitLiteral(U32 value)
@@ -237,14 +240,34 @@ namespace LLVMJIT
 		llvm::Value* memoryBasePointerVariable;
 		llvm::Value* tableBasePointerVariable;
 
-		EmitContext(MemoryInstance* inDefaultMemory, TableInstance* inDefaultTable)
+		// The offsets of the default memory and table base pointers in the CompartmentRuntimeData,
+		// and the corresponding memory and table IDs. Null if there is no default memory or table.
+		llvm::Constant* defaultMemoryOffset;
+		llvm::Constant* defaultMemoryId;
+		llvm::Constant* defaultTableOffset;
+		llvm::Constant* defaultTableId;
+
+		EmitContext(llvm::Constant* inDefaultMemoryOffset, llvm::Constant* inDefaultTableOffset)
 		: irBuilder(*llvmContext)
 		, contextPointerVariable(nullptr)
 		, memoryBasePointerVariable(nullptr)
 		, tableBasePointerVariable(nullptr)
-		, defaultMemory(inDefaultMemory)
-		, defaultTable(inDefaultTable)
+		, defaultMemoryOffset(inDefaultMemoryOffset)
+		, defaultMemoryId(nullptr)
+		, defaultTableOffset(inDefaultTableOffset)
+		, defaultTableId(nullptr)
 		{
+			if(defaultMemoryOffset)
+			{
+				defaultMemoryId = getIdFromOffset(
+					defaultMemoryOffset, offsetof(CompartmentRuntimeData, memories), sizeof(U8*));
+			}
+			if(defaultTableOffset)
+			{
+				defaultTableId = getIdFromOffset(defaultTableOffset,
+												 offsetof(CompartmentRuntimeData, tables),
+												 sizeof(TableInstance::FunctionElement*));
+			}
 		}
 
 		llvm::Value* loadFromUntypedPointer(llvm::Value* pointer, llvm::Type* valueType)
@@ -253,40 +276,38 @@ namespace LLVMJIT
 				irBuilder.CreatePointerCast(pointer, valueType->getPointerTo()));
 		}
 
-		void reloadMemoryAndTableBase()
+		// Derives the compartment runtime data from the context address by masking off the lower 32
+		// bits.
+		llvm::Value* getCompartmentAddress()
 		{
-			// Derive the compartment runtime data from the context address by masking off the lower
-			// 32 bits.
-			llvm::Value* compartmentAddress = irBuilder.CreateIntToPtr(
+			return irBuilder.CreateIntToPtr(
 				irBuilder.CreateAnd(irBuilder.CreatePtrToInt(
 										irBuilder.CreateLoad(contextPointerVariable), llvmI64Type),
 									emitLiteral(~((U64(1) << 32) - 1))),
 				llvmI8PtrType);
+		}
+
+		void reloadMemoryAndTableBase()
+		{
+			llvm::Value* compartmentAddress = getCompartmentAddress();
 
 			// Load the defaultMemoryBase and defaultTableBase values from the runtime data for this
 			// module instance.
 
-			if(defaultMemory)
+			if(defaultMemoryOffset)
 			{
-				const Uptr defaultMemoryBaseOffset
-					= offsetof(CompartmentRuntimeData, memories) + sizeof(U8*) * defaultMemory->id;
 				irBuilder.CreateStore(
 					loadFromUntypedPointer(
-						irBuilder.CreateInBoundsGEP(compartmentAddress,
-													{emitLiteral(defaultMemoryBaseOffset)}),
+						irBuilder.CreateInBoundsGEP(compartmentAddress, {defaultMemoryOffset}),
 						llvmI8PtrType),
 					memoryBasePointerVariable);
 			}
 
-			if(defaultTable)
+			if(defaultTableOffset)
 			{
-				const Uptr defaultTableBaseOffset
-					= offsetof(CompartmentRuntimeData, tables)
-					  + sizeof(TableInstance::FunctionElement*) * defaultTable->id;
 				irBuilder.CreateStore(
 					loadFromUntypedPointer(
-						irBuilder.CreateInBoundsGEP(compartmentAddress,
-													{emitLiteral(defaultTableBaseOffset)}),
+						irBuilder.CreateInBoundsGEP(compartmentAddress, {defaultTableOffset}),
 						llvmI8PtrType),
 					tableBasePointerVariable);
 			}
@@ -309,10 +330,8 @@ namespace LLVMJIT
 					= (llvm::Value**)alloca(sizeof(llvm::Value*) * (args.size() + 3));
 				augmentedArgs = llvm::ArrayRef<llvm::Value*>(augmentedArgsAlloca, args.size() + 3);
 				augmentedArgsAlloca[0] = irBuilder.CreateLoad(contextPointerVariable);
-				augmentedArgsAlloca[1]
-					= defaultMemory ? emitLiteral(I64(defaultMemory->id)) : emitLiteral(I64(-1));
-				augmentedArgsAlloca[2]
-					= defaultTable ? emitLiteral(I64(defaultTable->id)) : emitLiteral(I64(-1));
+				augmentedArgsAlloca[1] = defaultMemoryId ? defaultMemoryId : emitLiteral(I64(-1));
+				augmentedArgsAlloca[2] = defaultTableId ? defaultTableId : emitLiteral(I64(-1));
 				for(Uptr argIndex = 0; argIndex < args.size(); ++argIndex)
 				{ augmentedArgsAlloca[3 + argIndex] = args[argIndex]; }
 			}
@@ -468,17 +487,177 @@ namespace LLVMJIT
 		}
 
 	private:
-		MemoryInstance* defaultMemory;
-		TableInstance* defaultTable;
+		// Converts an offset in one of the CompartmentRuntimeData arrays to an index in the array.
+		static llvm::Constant* getIdFromOffset(llvm::Constant* offset,
+											   Uptr arrayOffset,
+											   Uptr numElementBytes)
+		{
+			return llvm::ConstantExpr::getUDiv(
+				llvm::ConstantExpr::getSub(offset, emitLiteral(U64(arrayOffset))),
+				emitLiteral(U64(numElementBytes)));
+		}
 	};
 
 	// Functions that map between the symbols used for externally visible functions and the function
 	std::string getExternalFunctionName(ModuleInstance* moduleInstance, Uptr functionDefIndex);
 	bool getFunctionIndexFromExternalName(const char* externalName, Uptr& outFunctionDefIndex);
 
-	// Emits LLVM IR for a module.
+	// The tiers of code that may be compiled for a module's functions.
+	enum class CodeTier : U8
+	{
+		// Optimized code that calls the module's functions directly. This is the only tier used
+		// when tiered compilation is disabled.
+		untiered,
+
+		// Unoptimized code that is quick to compile, and counts calls and loop iterations to
+		// request that hot functions be recompiled at the optimized tier.
+		baseline,
+
+		// Optimized code compiled in the background to replace the baseline code of a hot
+		// function.
+		optimized
+	};
+
+	// Returns whether emitted code includes DWARF debug info, as set by Runtime::setDebugInfo.
+	bool isDebugInfoEnabled();
+
+	// Returns whether accesses to unshared memories are emitted as non-volatile loads and stores.
+	bool areMemoryTrapsRelaxed();
+
+	// Emits LLVM IR for a range of a module's function definitions. The other function definitions
+	// are declared as external symbols in the resulting LLVM module.
 	std::shared_ptr<llvm::Module> emitModule(const IR::Module& module,
-											 ModuleInstance* moduleInstance);
+											 ModuleInstance* moduleInstance,
+											 Uptr beginFunctionDefIndex,
+											 Uptr endFunctionDefIndex,
+											 CodeTier tier);
+
+	// Emits a lazy compilation stub for each of a module's function definitions. The stub for a
+	// function is called by the function's symbol until the function is compiled: it compiles the
+	// function, and then calls the compiled code.
+	std::shared_ptr<llvm::Module> emitLazyCompileStubs(const IR::Module& module,
+													   ModuleInstance* moduleInstance);
+
+	// Returns the counter that baseline code for a function counts down to request that the
+	// function be recompiled at the optimized tier.
+	std::atomic<I32>* getTierUpCounter(ModuleInstance* moduleInstance, Uptr functionDefIndex);
+
+	// Resolves a symbol that code emitted for a module uses to reference a value of the module
+	// instance. Returns false if the name isn't one of the symbols bound to module instances.
+	bool resolveBoundSymbol(const IR::Module& module,
+							ModuleInstance* moduleInstance,
+							const char* name,
+							Uptr& outValue);
+
+	typedef llvm::object::OwningBinary<llvm::object::ObjectFile> ObjectBinary;
+
+	// Identifies the object code compiled for a module. Instances of modules with the same key can
+	// share the same object code.
+	struct ObjectCacheKey
+	{
+		U64 hashes[2];
+
+		friend bool operator==(const ObjectCacheKey& left, const ObjectCacheKey& right)
+		{
+			return left.hashes[0] == right.hashes[0] && left.hashes[1] == right.hashes[1];
+		}
+	};
+
+	// Returns the attributes that JIT code is compiled for: the features of the host CPU, followed
+	// by the LLVM_TARGET_ATTRIBUTES the build was configured with.
+	std::vector<std::string> getTargetAttributes();
+
+	// Returns a string that identifies the target that JIT code is compiled for, and the version of
+	// the compiler.
+	std::string getTargetString();
+
+	// Computes the key that identifies the object code compiled for a module instance.
+	ObjectCacheKey getObjectCacheKey(const IR::Module& module,
+									 ModuleInstance* moduleInstance,
+									 CodeTier tier,
+									 OptimizationLevel optimizationLevel,
+									 bool isLazy,
+									 bool hasDebugInfo);
+
+	// Loads a module's object code from the object cache. Returns null if the object cache is
+	// disabled, or the object code isn't in the cache. Otherwise, returns the buffer holding the
+	// cached objects, which must outlive them.
+	std::unique_ptr<llvm::MemoryBuffer> loadCachedObjects(const ObjectCacheKey& key,
+														  std::vector<ObjectBinary>& outObjects);
+
+	// Stores a module's object code in the object cache.
+	void storeCachedObjects(const ObjectCacheKey& key, const std::vector<ObjectBinary>& objects);
+
+	// Writes a precompiled module file containing a module's WebAssembly binary, and the object code
+	// compiled for it. Returns false if the file couldn't be written.
+	bool writePrecompiledModuleFile(const std::string& path,
+									const IR::Module& module,
+									const ObjectCacheKey& key,
+									OptimizationLevel optimizationLevel,
+									const std::vector<ObjectBinary>& objects);
+
+	// Maps a precompiled module file into memory, and decodes its module and objects. The objects
+	// reference the returned buffer. Returns null if the file couldn't be read, is invalid, or was
+	// compiled for a different target.
+	std::unique_ptr<llvm::MemoryBuffer> readPrecompiledModuleFile(
+		const std::string& path,
+		IR::Module& outModule,
+		ObjectCacheKey& outKey,
+		OptimizationLevel& outOptimizationLevel,
+		std::vector<ObjectBinary>& outObjects);
+
+	// The memory reserved for the code and data sections of an object loaded by the JIT. The
+	// sections are allocated from the same code region, so they are within range of each other's
+	// relative relocations, but may share pages with the sections of other objects.
+	struct JITMemoryReservation
+	{
+		struct CodeRegion* region;
+		U8* codeAddress;
+		Uptr numCodeBytes;
+		U8* readOnlyAddress;
+		Uptr numReadOnlyBytes;
+		U8* readWriteAddress;
+		Uptr numReadWriteBytes;
+	};
+
+	// The partially filled code and read-only pages that a JIT unit may allocate its next object's
+	// sections in. These pages are only shared between the objects of one unit, which are finalized
+	// together before any of their code can be executed.
+	struct JITMemoryOpenPages
+	{
+		struct CodeRegion* region;
+		Uptr codePageIndex;
+		Uptr codePageNumBytes;
+		Uptr readOnlyPageIndex;
+		Uptr readOnlyPageNumBytes;
+
+		JITMemoryOpenPages() : region(nullptr) {}
+	};
+
+	// Reserves writable memory for an object's sections from the pool of code regions shared by all
+	// JIT units. The code and read-only sections are packed into the unit's open pages, and the
+	// read-write section may share a page with other units' read-write sections.
+	JITMemoryReservation reserveJITMemory(JITMemoryOpenPages& openPages,
+										  Uptr numCodeBytes,
+										  Uptr codeAlignment,
+										  Uptr numReadOnlyBytes,
+										  Uptr readOnlyAlignment,
+										  Uptr numReadWriteBytes,
+										  Uptr readWriteAlignment);
+
+	// Returns the base address of the code region a reservation was allocated from.
+	U8* getJITMemoryRegionBaseAddress(const JITMemoryReservation& reservation);
+
+	// Makes a reservation's code executable and its read-only data read-only, once it has been
+	// written. Pages shared with the unit's other reservations that are still being written remain
+	// writable and not executable until those reservations are also finalized. Code is only made
+	// writable and executable if isCodeWriteable is true.
+	void finalizeJITMemory(const JITMemoryReservation& reservation, bool isCodeWriteable);
+
+	// Frees a reservation. Pages that no longer contain any reservations are decommitted, but remain
+	// reserved to catch any references to them that might erroneously remain, until all the pages
+	// in their code region are free.
+	void freeJITMemory(const JITMemoryReservation& reservation);
 
 #ifdef _WIN64
 	extern void processSEHTables(Uptr imageBaseAddress,
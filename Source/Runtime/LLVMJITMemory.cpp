@@ -0,0 +1,395 @@
+#include "Inline/Assert.h"
+#include "Inline/BasicTypes.h"
+#include "Inline/Lock.h"
+#include "LLVMJIT.h"
+#include "Logging/Logging.h"
+#include "Platform/Platform.h"
+#include "RuntimePrivate.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace LLVMJIT;
+using namespace Runtime;
+
+// The sections of the objects loaded by the JIT are allocated from a pool of large code regions.
+// Sections of the same kind are packed into shared pages, so small objects like thunks don't each
+// need their own set of pages. Code and read-only sections are only packed into the open pages of
+// the JIT unit that is loading them, and all of a unit's objects are finalized together, so a page
+// is never made writable again once it has been finalized, and code pages are never writable and
+// executable at the same time. Read-write sections don't change access when they are finalized, so
+// they are packed into pages shared by all the units that allocate from a region.
+
+enum
+{
+	// The number of bytes of virtual address space reserved for each code region. All the sections
+	// of an object are allocated from one region, so this must be small enough for the relative
+	// relocations between them.
+	codeRegionNumBytesLog2 = 26
+};
+
+enum class SectionKind
+{
+	code,
+	readOnly,
+	readWrite,
+	num
+};
+
+struct CodePage
+{
+	// The number of reservations with sections in the page.
+	U32 numReservations;
+
+	// The number of reservations with sections in the page that haven't been finalized. While
+	// this is non-zero, the page is writable and not executable.
+	U32 numWriters;
+};
+
+struct LLVMJIT::CodeRegion
+{
+	U8* baseAddress;
+	Uptr numPages;
+	Uptr numUsedPages;
+	Uptr numReservations;
+	std::vector<CodePage> pages;
+
+	// The region's partially filled page that the next read-write section may be allocated in, and
+	// the number of bytes already allocated in the page.
+	Uptr openReadWritePageIndex;
+	Uptr openReadWritePageNumBytes;
+};
+
+static Platform::Mutex jitMemoryMutex;
+static std::vector<CodeRegion*> codeRegions;
+static Uptr numCommittedPages = 0;
+static Uptr numReservations   = 0;
+static Uptr numSectionBytes[Uptr(SectionKind::num)];
+
+static Uptr alignUp(Uptr value, Uptr alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static Uptr getNumPages(Uptr numBytes)
+{
+	return (numBytes + (Uptr(1) << Platform::getPageSizeLog2()) - 1) >> Platform::getPageSizeLog2();
+}
+
+static U8* getPageAddress(CodeRegion* region, Uptr pageIndex)
+{
+	return region->baseAddress + (pageIndex << Platform::getPageSizeLog2());
+}
+
+static Platform::MemoryAccess getFinalAccess(SectionKind kind, bool isCodeWriteable)
+{
+	switch(kind)
+	{
+	case SectionKind::code:
+		return isCodeWriteable ? Platform::MemoryAccess::readWriteExecute
+							   : Platform::MemoryAccess::execute;
+	case SectionKind::readOnly: return Platform::MemoryAccess::readOnly;
+	case SectionKind::readWrite: return Platform::MemoryAccess::readWrite;
+	default: Errors::unreachable();
+	};
+}
+
+static CodeRegion* createCodeRegion(Uptr minPages)
+{
+	const Uptr defaultNumPages = Uptr(1) << (codeRegionNumBytesLog2 - Platform::getPageSizeLog2());
+
+	CodeRegion* region  = new CodeRegion;
+	region->numPages    = std::max(defaultNumPages, minPages);
+	region->baseAddress = Platform::allocateVirtualPages(region->numPages);
+	if(!region->baseAddress) { Errors::fatal("memory allocation for JIT code failed"); }
+	region->numUsedPages    = 0;
+	region->numReservations = 0;
+	region->pages.resize(region->numPages, CodePage{0, 0});
+	region->openReadWritePageIndex    = UINTPTR_MAX;
+	region->openReadWritePageNumBytes = 0;
+	return region;
+}
+
+static void freeCodeRegion(CodeRegion* region)
+{
+	// All the region's committed pages were decommitted when the last reservation in them was
+	// freed, so the region's virtual addresses can just be freed.
+	wavmAssert(!region->numReservations);
+	Platform::freeVirtualPages(region->baseAddress, region->numPages);
+	codeRegions.erase(std::find(codeRegions.begin(), codeRegions.end(), region));
+	delete region;
+}
+
+static U8* allocateSection(CodeRegion* region,
+						   SectionKind kind,
+						   Uptr numBytes,
+						   Uptr alignment,
+						   Uptr& openPageIndex,
+						   Uptr& openPageNumBytes)
+{
+	const Uptr pageSize = Uptr(1) << Platform::getPageSizeLog2();
+	alignment           = std::max(alignment, Uptr(1));
+	wavmAssert(!(alignment & (alignment - 1)));
+	wavmAssert(alignment <= pageSize);
+
+	if(!numBytes) { return nullptr; }
+	numSectionBytes[Uptr(kind)] += numBytes;
+
+	// If the section fits in the open page for its kind, allocate it there. Only read-write pages
+	// may have been finalized, and finalizing them doesn't change their access, so the page is
+	// still writable.
+	if(openPageIndex != UINTPTR_MAX && alignUp(openPageNumBytes, alignment) + numBytes <= pageSize)
+	{
+		const Uptr offset = alignUp(openPageNumBytes, alignment);
+		openPageNumBytes  = offset + numBytes;
+
+		CodePage& page = region->pages[openPageIndex];
+		wavmAssert(page.numWriters || kind == SectionKind::readWrite);
+		++page.numReservations;
+		++page.numWriters;
+
+		return getPageAddress(region, openPageIndex) + offset;
+	}
+
+	// Otherwise, commit new pages for the section.
+	const Uptr numPages       = getNumPages(numBytes);
+	const Uptr firstPageIndex = region->numUsedPages;
+	wavmAssert(firstPageIndex + numPages <= region->numPages);
+	region->numUsedPages += numPages;
+
+	U8* address = getPageAddress(region, firstPageIndex);
+	if(!Platform::commitVirtualPages(address, numPages))
+	{ Errors::fatal("memory allocation for JIT code failed"); }
+	numCommittedPages += numPages;
+
+	for(Uptr pageIndex = firstPageIndex; pageIndex < firstPageIndex + numPages; ++pageIndex)
+	{
+		++region->pages[pageIndex].numReservations;
+		++region->pages[pageIndex].numWriters;
+	}
+
+	// If the section's last page isn't full, subsequent sections of the same kind may be
+	// allocated in it.
+	const Uptr numLastPageBytes = numBytes - ((numPages - 1) << Platform::getPageSizeLog2());
+	if(numLastPageBytes < pageSize)
+	{
+		openPageIndex    = firstPageIndex + numPages - 1;
+		openPageNumBytes = numLastPageBytes;
+	}
+	else
+	{
+		openPageIndex = UINTPTR_MAX;
+	}
+
+	return address;
+}
+
+// Calls visitPage for each page that a section occupies, and calls visitRun for each run of
+// consecutive pages that visitPage returned true for. This is used to change the state of many
+// pages with a single call to the platform.
+template<typename VisitPage, typename VisitRun>
+static void visitSectionPages(CodeRegion* region,
+							  U8* address,
+							  Uptr numBytes,
+							  VisitPage&& visitPage,
+							  VisitRun&& visitRun)
+{
+	if(!numBytes) { return; }
+
+	const Uptr firstPageIndex = Uptr(address - region->baseAddress) >> Platform::getPageSizeLog2();
+	const Uptr endPageIndex
+		= ((Uptr(address - region->baseAddress) + numBytes - 1) >> Platform::getPageSizeLog2()) + 1;
+	Uptr runBeginPageIndex = UINTPTR_MAX;
+	for(Uptr pageIndex = firstPageIndex; pageIndex < endPageIndex; ++pageIndex)
+	{
+		if(visitPage(pageIndex))
+		{
+			if(runBeginPageIndex == UINTPTR_MAX) { runBeginPageIndex = pageIndex; }
+		}
+		else if(runBeginPageIndex != UINTPTR_MAX)
+		{
+			visitRun(runBeginPageIndex, pageIndex - runBeginPageIndex);
+			runBeginPageIndex = UINTPTR_MAX;
+		}
+	}
+	if(runBeginPageIndex != UINTPTR_MAX)
+	{ visitRun(runBeginPageIndex, endPageIndex - runBeginPageIndex); }
+}
+
+static void finalizeSection(CodeRegion* region,
+							SectionKind kind,
+							U8* address,
+							Uptr numBytes,
+							bool isCodeWriteable)
+{
+	// Pages that are shared with reservations that haven't been finalized yet must remain
+	// writable, so only set the final access of the pages without any other writers. The other
+	// writers are in the same unit, so nothing can execute the pages before they're finalized too.
+	visitSectionPages(
+		region,
+		address,
+		numBytes,
+		[&](Uptr pageIndex) {
+			CodePage& page = region->pages[pageIndex];
+			wavmAssert(page.numWriters);
+			return --page.numWriters == 0;
+		},
+		[&](Uptr runBeginPageIndex, Uptr numRunPages) {
+			if(kind == SectionKind::readWrite) { return; }
+			errorUnless(Platform::setVirtualPageAccess(getPageAddress(region, runBeginPageIndex),
+													   numRunPages,
+													   getFinalAccess(kind, isCodeWriteable)));
+		});
+}
+
+static void freeSection(CodeRegion* region, SectionKind kind, U8* address, Uptr numBytes)
+{
+	numSectionBytes[Uptr(kind)] -= numBytes;
+
+	// Decommit the pages that no longer contain any reservations.
+	visitSectionPages(
+		region,
+		address,
+		numBytes,
+		[&](Uptr pageIndex) {
+			CodePage& page = region->pages[pageIndex];
+			wavmAssert(page.numReservations);
+			if(--page.numReservations) { return false; }
+
+			// Don't allocate any more sections in the page. Code and read-only pages are only open
+			// to the unit that is freeing them.
+			if(region->openReadWritePageIndex == pageIndex)
+			{ region->openReadWritePageIndex = UINTPTR_MAX; }
+			return true;
+		},
+		[&](Uptr runBeginPageIndex, Uptr numRunPages) {
+			Platform::decommitVirtualPages(getPageAddress(region, runBeginPageIndex), numRunPages);
+			numCommittedPages -= numRunPages;
+		});
+}
+
+JITMemoryReservation LLVMJIT::reserveJITMemory(JITMemoryOpenPages& openPages,
+											   Uptr numCodeBytes,
+											   Uptr codeAlignment,
+											   Uptr numReadOnlyBytes,
+											   Uptr readOnlyAlignment,
+											   Uptr numReadWriteBytes,
+											   Uptr readWriteAlignment)
+{
+	Lock<Platform::Mutex> jitMemoryLock(jitMemoryMutex);
+
+	// If the current region doesn't have enough pages left for the sections, even if none of them
+	// fit in the region's open pages, create a new region.
+	const Uptr maxNewPages = getNumPages(numCodeBytes) + getNumPages(numReadOnlyBytes)
+							 + getNumPages(numReadWriteBytes);
+	CodeRegion* region = codeRegions.size() ? codeRegions.back() : nullptr;
+	if(!region || region->numUsedPages + maxNewPages > region->numPages)
+	{
+		// If the previous region has no reservations left, free it.
+		if(region && !region->numReservations) { freeCodeRegion(region); }
+
+		region = createCodeRegion(maxNewPages);
+		codeRegions.push_back(region);
+	}
+
+	// The unit's open pages can only be used for sections allocated from the same region.
+	if(openPages.region != region)
+	{
+		openPages.region            = region;
+		openPages.codePageIndex     = UINTPTR_MAX;
+		openPages.readOnlyPageIndex = UINTPTR_MAX;
+	}
+
+	JITMemoryReservation reservation;
+	reservation.region            = region;
+	reservation.numCodeBytes      = numCodeBytes;
+	reservation.numReadOnlyBytes  = numReadOnlyBytes;
+	reservation.numReadWriteBytes = numReadWriteBytes;
+	reservation.codeAddress       = allocateSection(region,
+													SectionKind::code,
+													numCodeBytes,
+													codeAlignment,
+													openPages.codePageIndex,
+													openPages.codePageNumBytes);
+	reservation.readOnlyAddress   = allocateSection(region,
+													SectionKind::readOnly,
+													numReadOnlyBytes,
+													readOnlyAlignment,
+													openPages.readOnlyPageIndex,
+													openPages.readOnlyPageNumBytes);
+	reservation.readWriteAddress  = allocateSection(region,
+													SectionKind::readWrite,
+													numReadWriteBytes,
+													readWriteAlignment,
+													region->openReadWritePageIndex,
+													region->openReadWritePageNumBytes);
+
+	++region->numReservations;
+	++numReservations;
+
+	return reservation;
+}
+
+U8* LLVMJIT::getJITMemoryRegionBaseAddress(const JITMemoryReservation& reservation)
+{
+	return reservation.region->baseAddress;
+}
+
+void LLVMJIT::finalizeJITMemory(const JITMemoryReservation& reservation, bool isCodeWriteable)
+{
+	Lock<Platform::Mutex> jitMemoryLock(jitMemoryMutex);
+	finalizeSection(reservation.region,
+					SectionKind::code,
+					reservation.codeAddress,
+					reservation.numCodeBytes,
+					isCodeWriteable);
+	finalizeSection(reservation.region,
+					SectionKind::readOnly,
+					reservation.readOnlyAddress,
+					reservation.numReadOnlyBytes,
+					isCodeWriteable);
+	finalizeSection(reservation.region,
+					SectionKind::readWrite,
+					reservation.readWriteAddress,
+					reservation.numReadWriteBytes,
+					isCodeWriteable);
+}
+
+void LLVMJIT::freeJITMemory(const JITMemoryReservation& reservation)
+{
+	Lock<Platform::Mutex> jitMemoryLock(jitMemoryMutex);
+
+	CodeRegion* region = reservation.region;
+	freeSection(region, SectionKind::code, reservation.codeAddress, reservation.numCodeBytes);
+	freeSection(
+		region, SectionKind::readOnly, reservation.readOnlyAddress, reservation.numReadOnlyBytes);
+	freeSection(region,
+				SectionKind::readWrite,
+				reservation.readWriteAddress,
+				reservation.numReadWriteBytes);
+
+	wavmAssert(region->numReservations);
+	--region->numReservations;
+	--numReservations;
+
+	// If the region has no reservations left, and new reservations aren't being allocated from it,
+	// free it.
+	if(!region->numReservations && region != codeRegions.back()) { freeCodeRegion(region); }
+}
+
+JITMemoryStats Runtime::getJITMemoryStats()
+{
+	Lock<Platform::Mutex> jitMemoryLock(jitMemoryMutex);
+
+	JITMemoryStats stats;
+	stats.numRegions       = codeRegions.size();
+	stats.numReservedBytes = 0;
+	for(CodeRegion* region : codeRegions)
+	{ stats.numReservedBytes += region->numPages << Platform::getPageSizeLog2(); }
+	stats.numCommittedBytes = numCommittedPages << Platform::getPageSizeLog2();
+	stats.numCodeBytes      = numSectionBytes[Uptr(SectionKind::code)];
+	stats.numReadOnlyBytes  = numSectionBytes[Uptr(SectionKind::readOnly)];
+	stats.numReadWriteBytes = numSectionBytes[Uptr(SectionKind::readWrite)];
+	stats.numReservations   = numReservations;
+	return stats;
+}
@@ -0,0 +1,547 @@
+#include "IR/Module.h"
+#include "IR/Validate.h"
+#include "Inline/Assert.h"
+#include "Inline/BasicTypes.h"
+#include "Inline/Hash.h"
+#include "Inline/Lock.h"
+#include "Inline/Serialization.h"
+#include "Inline/Timing.h"
+#include "LLVMJIT.h"
+#include "Logging/Logging.h"
+#include "RuntimePrivate.h"
+#include "WASM/WASM.h"
+
+#include <inttypes.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+#include "LLVMPreInclude.h"
+
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "LLVMPostInclude.h"
+
+using namespace IR;
+using namespace LLVMJIT;
+
+// Increment this whenever a change to the compiler or the cache file format invalidates the object
+// code in existing cache files.
+enum
+{
+	objectCacheVersion = 7
+};
+
+// A cache file starts with this header, followed by the size of each object, and then the object
+// code, with each object aligned to objectCacheAlignment bytes.
+struct ObjectCacheFileHeader
+{
+	U32 magic;
+	U32 version;
+	U64 key[2];
+	U64 numObjects;
+};
+
+// A precompiled module file starts with this header, followed by the target string, the module's
+// WebAssembly binary, and then the objects in the same layout as a cache file.
+struct PrecompiledModuleFileHeader
+{
+	U32 magic;
+	U32 version;
+	U64 key[2];
+	IR::FeatureSpec featureSpec;
+	U8 optimizationLevel;
+	U64 numTargetBytes;
+	U64 numWASMBytes;
+	U64 numObjects;
+};
+
+enum
+{
+	objectCacheMagic       = 0x4f4d5657, // "WVMO"
+	precompiledModuleMagic = 0x504d5657, // "WVMP"
+	objectCacheAlignment   = 16
+};
+
+static const char objectCacheFileExtension[] = ".wavmobj";
+
+static Platform::Mutex objectCacheConfigMutex;
+static std::string objectCacheDirectory;
+static U64 objectCacheMaxBytes = 0;
+
+static std::atomic<U64> numObjectCacheHits(0);
+static std::atomic<U64> numObjectCacheMisses(0);
+
+static Uptr alignObjectOffset(Uptr offset)
+{
+	return (offset + objectCacheAlignment - 1) & ~Uptr(objectCacheAlignment - 1);
+}
+
+// Writes the size of each object, followed by the object code, with each object aligned to
+// objectCacheAlignment bytes from the start of the file.
+static void writeObjects(llvm::raw_fd_ostream& stream, const std::vector<ObjectBinary>& objects)
+{
+	for(const ObjectBinary& object : objects)
+	{
+		const U64 numObjectBytes = object.getBinary()->getData().size();
+		stream.write((const char*)&numObjectBytes, sizeof(U64));
+	}
+
+	static const char zeroes[objectCacheAlignment] = {0};
+	for(const ObjectBinary& object : objects)
+	{
+		const Uptr offset = Uptr(stream.tell());
+		stream.write(zeroes, alignObjectOffset(offset) - offset);
+
+		const llvm::StringRef objectData = object.getBinary()->getData();
+		stream.write(objectData.data(), objectData.size());
+	}
+}
+
+// Reads objects written by writeObjects at an offset in a mapped file. The objects reference the
+// file's memory. Returns false if the objects are truncated or invalid.
+static bool readObjects(const U8* fileBytes,
+						Uptr numFileBytes,
+						Uptr offset,
+						U64 numObjects,
+						std::vector<ObjectBinary>& outObjects)
+{
+	if(offset > numFileBytes || numObjects > (numFileBytes - offset) / sizeof(U64))
+	{ return false; }
+
+	Uptr objectOffset = alignObjectOffset(offset + Uptr(numObjects) * sizeof(U64));
+	for(U64 objectIndex = 0; objectIndex < numObjects; ++objectIndex)
+	{
+		U64 numObjectBytes;
+		memcpy(&numObjectBytes, fileBytes + offset + objectIndex * sizeof(U64), sizeof(U64));
+		if(objectOffset > numFileBytes || numObjectBytes > numFileBytes - objectOffset)
+		{ return false; }
+
+		auto objectBuffer = llvm::MemoryBuffer::getMemBuffer(
+			llvm::StringRef((const char*)fileBytes + objectOffset, Uptr(numObjectBytes)),
+			"",
+			false);
+		auto object = llvm::object::ObjectFile::createObjectFile(objectBuffer->getMemBufferRef());
+		if(!object)
+		{
+			llvm::consumeError(object.takeError());
+			return false;
+		}
+		outObjects.emplace_back(std::move(*object), std::move(objectBuffer));
+
+		objectOffset = alignObjectOffset(objectOffset + Uptr(numObjectBytes));
+	}
+	return true;
+}
+
+static std::unique_ptr<llvm::MemoryBuffer> invalidPrecompiledModuleFile(const std::string& path)
+{
+	Log::printf(Log::error, "Invalid precompiled module file: %s\n", path.c_str());
+	return nullptr;
+}
+
+static std::string getCacheFilePath(const std::string& directory, const ObjectCacheKey& key)
+{
+	char keyString[33];
+	snprintf(keyString,
+			 sizeof(keyString),
+			 "%016" PRIx64 "%016" PRIx64,
+			 U64(key.hashes[0]),
+			 U64(key.hashes[1]));
+
+	llvm::SmallString<256> path(directory);
+	llvm::sys::path::append(path, std::string(keyString) + objectCacheFileExtension);
+	return path.str().str();
+}
+
+// Deletes the least recently used cache files until the cache is no larger than maxBytes.
+static void trimObjectCache(const std::string& directory, U64 maxBytes)
+{
+	struct CacheFile
+	{
+		std::string path;
+		U64 numBytes;
+		llvm::sys::TimePoint<> lastModificationTime;
+	};
+
+	std::vector<CacheFile> cacheFiles;
+	U64 numTotalBytes = 0;
+	std::error_code errorCode;
+	for(llvm::sys::fs::directory_iterator fileIt(directory, errorCode), endIt;
+		!errorCode && fileIt != endIt;
+		fileIt.increment(errorCode))
+	{
+		if(llvm::sys::path::extension(fileIt->path()) != objectCacheFileExtension) { continue; }
+
+		llvm::sys::fs::file_status status;
+		if(llvm::sys::fs::status(fileIt->path(), status)) { continue; }
+
+		cacheFiles.push_back({fileIt->path(), status.getSize(), status.getLastModificationTime()});
+		numTotalBytes += status.getSize();
+	}
+
+	if(numTotalBytes <= maxBytes) { return; }
+
+	std::sort(cacheFiles.begin(), cacheFiles.end(), [](const CacheFile& a, const CacheFile& b) {
+		return a.lastModificationTime < b.lastModificationTime;
+	});
+	for(const CacheFile& cacheFile : cacheFiles)
+	{
+		if(numTotalBytes <= maxBytes) { break; }
+		if(!llvm::sys::fs::remove(cacheFile.path)) { numTotalBytes -= cacheFile.numBytes; }
+	}
+}
+
+// Updates the modification time of a cache file, so it is evicted as a recently used file.
+static void touchCacheFile(const std::string& path)
+{
+	int fd;
+	if(llvm::sys::fs::openFileForRead(path, fd)) { return; }
+	llvm::sys::fs::setLastModificationAndAccessTime(fd, std::chrono::system_clock::now());
+	llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+}
+
+std::string LLVMJIT::getTargetString()
+{
+	// The target doesn't change while the process is running, so only compute the string once.
+	static const std::string cachedTargetString = []() {
+		std::string targetString = std::to_string(objectCacheVersion);
+		targetString += ' ';
+		targetString += LLVM_VERSION_STRING;
+		targetString += ' ';
+		targetString += llvm::sys::getProcessTriple();
+		targetString += ' ';
+		targetString += llvm::sys::getHostCPUName();
+		for(const std::string& attribute : getTargetAttributes())
+		{
+			targetString += ' ';
+			targetString += attribute;
+		}
+		return targetString;
+	}();
+	return cachedTargetString;
+}
+
+// Returns the hash of a module's WebAssembly binary encoding. Serializing and hashing a large
+// module is expensive, so the hash is cached with the module for later instances of it.
+static void getModuleHashes(const IR::Module& module, U64 outHashes[2])
+{
+	if(module.hashCache.get(outHashes)) { return; }
+
+	Serialization::ArrayOutputStream moduleStream;
+	WASM::serialize(moduleStream, module);
+	const std::vector<U8> moduleBytes = moduleStream.getBytes();
+	outHashes[0]                      = XXH<U64>(moduleBytes.data(), moduleBytes.size(), 0);
+	outHashes[1]                      = XXH<U64>(moduleBytes.data(), moduleBytes.size(), 1);
+	module.hashCache.set(outHashes);
+}
+
+ObjectCacheKey LLVMJIT::getObjectCacheKey(const IR::Module& module,
+										  ModuleInstance* moduleInstance,
+										  CodeTier tier,
+										  OptimizationLevel optimizationLevel,
+										  bool isLazy,
+										  bool hasDebugInfo)
+{
+	// Hash everything that the object code depends on: the module, the target, the compiler, the
+	// code tier and optimization level, whether it is lazy compilation stubs, whether it has debug
+	// info, whether its memory traps are relaxed, and the calling conventions of the module's
+	// function imports.
+	Serialization::ArrayOutputStream keyStream;
+	U64 moduleHashes[2];
+	getModuleHashes(module, moduleHashes);
+	Serialization::serializeBytes(keyStream, (const U8*)moduleHashes, sizeof(moduleHashes));
+
+	const std::string targetString = getTargetString();
+	Serialization::serializeBytes(keyStream, (const U8*)targetString.data(), targetString.size());
+	Serialization::serializeBytes(
+		keyStream, (const U8*)&module.featureSpec, sizeof(module.featureSpec));
+
+	Serialization::serializeBytes(keyStream, (const U8*)&tier, sizeof(tier));
+	Serialization::serializeBytes(
+		keyStream, (const U8*)&optimizationLevel, sizeof(optimizationLevel));
+	const U8 isLazyByte = isLazy ? 1 : 0;
+	Serialization::serializeBytes(keyStream, &isLazyByte, 1);
+	const U8 hasDebugInfoByte = hasDebugInfo ? 1 : 0;
+	Serialization::serializeBytes(keyStream, &hasDebugInfoByte, 1);
+	const U8 areMemoryTrapsRelaxedByte = areMemoryTrapsRelaxed() ? 1 : 0;
+	Serialization::serializeBytes(keyStream, &areMemoryTrapsRelaxedByte, 1);
+
+	for(Uptr importIndex = 0; importIndex < module.functions.imports.size(); ++importIndex)
+	{
+		U8 callingConvention = U8(moduleInstance->functions[importIndex]->callingConvention);
+		Serialization::serializeBytes(keyStream, &callingConvention, 1);
+	}
+
+	const std::vector<U8> keyBytes = keyStream.getBytes();
+	ObjectCacheKey key;
+	key.hashes[0] = XXH<U64>(keyBytes.data(), keyBytes.size(), 0);
+	key.hashes[1] = XXH<U64>(keyBytes.data(), keyBytes.size(), 1);
+	return key;
+}
+
+std::unique_ptr<llvm::MemoryBuffer> LLVMJIT::loadCachedObjects(
+	const ObjectCacheKey& key,
+	std::vector<ObjectBinary>& outObjects)
+{
+	std::string path;
+	{
+		Lock<Platform::Mutex> configLock(objectCacheConfigMutex);
+		if(objectCacheDirectory.empty()) { return nullptr; }
+		path = getCacheFilePath(objectCacheDirectory, key);
+	}
+
+	Timing::Timer loadTimer;
+
+	// Map the cache file into memory. The loaded objects reference the mapped file, so the caller
+	// must keep the returned buffer alive while it uses them.
+	auto fileBufferOrError = llvm::MemoryBuffer::getFile(path, -1, false);
+	if(!fileBufferOrError)
+	{
+		Log::printf(Log::metrics,
+					"Object cache miss (%" PRIu64 " hits, %" PRIu64 " misses)\n",
+					numObjectCacheHits.load(),
+					++numObjectCacheMisses);
+		return nullptr;
+	}
+	std::unique_ptr<llvm::MemoryBuffer> fileBuffer = std::move(*fileBufferOrError);
+
+	// Validate the file's header, and compute the location of each object in the file.
+	const U8* fileBytes     = (const U8*)fileBuffer->getBufferStart();
+	const Uptr numFileBytes = fileBuffer->getBufferSize();
+	ObjectCacheFileHeader header;
+	bool isValid = numFileBytes >= sizeof(header);
+	if(isValid)
+	{
+		memcpy(&header, fileBytes, sizeof(header));
+		isValid = header.magic == objectCacheMagic && header.version == objectCacheVersion
+				  && header.key[0] == key.hashes[0] && header.key[1] == key.hashes[1];
+	}
+
+	std::vector<ObjectBinary> objects;
+	isValid = isValid
+			  && readObjects(fileBytes, numFileBytes, sizeof(header), header.numObjects, objects);
+
+	if(!isValid)
+	{
+		// Delete the invalid cache file, so it's replaced by the newly compiled object code.
+		Log::printf(Log::debug, "Ignoring invalid object cache file: %s\n", path.c_str());
+		llvm::sys::fs::remove(path);
+		Log::printf(Log::metrics,
+					"Object cache miss (%" PRIu64 " hits, %" PRIu64 " misses)\n",
+					numObjectCacheHits.load(),
+					++numObjectCacheMisses);
+		return nullptr;
+	}
+
+	touchCacheFile(path);
+
+	outObjects = std::move(objects);
+	Timing::logTimer("Loaded cached object code", loadTimer);
+	Log::printf(Log::metrics,
+				"Object cache hit (%" PRIu64 " hits, %" PRIu64 " misses)\n",
+				++numObjectCacheHits,
+				numObjectCacheMisses.load());
+	return fileBuffer;
+}
+
+void LLVMJIT::storeCachedObjects(const ObjectCacheKey& key,
+								 const std::vector<ObjectBinary>& objects)
+{
+	std::string directory;
+	U64 maxBytes;
+	{
+		Lock<Platform::Mutex> configLock(objectCacheConfigMutex);
+		if(objectCacheDirectory.empty()) { return; }
+		directory = objectCacheDirectory;
+		maxBytes  = objectCacheMaxBytes;
+	}
+	const std::string path = getCacheFilePath(directory, key);
+
+	Timing::Timer storeTimer;
+
+	if(llvm::sys::fs::create_directories(directory))
+	{
+		Log::printf(Log::error, "Couldn't create object cache directory: %s\n", directory.c_str());
+		return;
+	}
+
+	// Write the cache file to a uniquely named temporary file, and then rename it to the cache
+	// file's name. Renaming is atomic, so other processes never see a partially written file.
+	int fd;
+	llvm::SmallString<256> tempPath;
+	if(llvm::sys::fs::createUniqueFile(path + ".%%%%%%%%.tmp", fd, tempPath))
+	{
+		Log::printf(Log::error, "Couldn't create object cache file in %s\n", directory.c_str());
+		return;
+	}
+
+	bool writeFailed;
+	{
+		llvm::raw_fd_ostream stream(fd, true);
+
+		ObjectCacheFileHeader header;
+		memset(&header, 0, sizeof(header));
+		header.magic      = objectCacheMagic;
+		header.version    = objectCacheVersion;
+		header.key[0]     = key.hashes[0];
+		header.key[1]     = key.hashes[1];
+		header.numObjects = objects.size();
+		stream.write((const char*)&header, sizeof(header));
+		writeObjects(stream, objects);
+
+		stream.close();
+		writeFailed = stream.has_error();
+		stream.clear_error();
+	}
+
+	if(writeFailed || llvm::sys::fs::rename(tempPath, path))
+	{
+		Log::printf(Log::error, "Couldn't write object cache file: %s\n", path.c_str());
+		llvm::sys::fs::remove(tempPath);
+		return;
+	}
+
+	if(maxBytes) { trimObjectCache(directory, maxBytes); }
+
+	Timing::logTimer("Stored object code in cache", storeTimer);
+}
+
+bool LLVMJIT::writePrecompiledModuleFile(const std::string& path,
+										 const IR::Module& module,
+										 const ObjectCacheKey& key,
+										 OptimizationLevel optimizationLevel,
+										 const std::vector<ObjectBinary>& objects)
+{
+	Timing::Timer writeTimer;
+
+	Serialization::ArrayOutputStream wasmStream;
+	WASM::serialize(wasmStream, module);
+	const std::vector<U8> wasmBytes = wasmStream.getBytes();
+	const std::string targetString  = getTargetString();
+
+	std::error_code errorCode;
+	llvm::raw_fd_ostream stream(path, errorCode, llvm::sys::fs::F_None);
+	if(errorCode)
+	{
+		Log::printf(Log::error, "Couldn't create precompiled module file: %s\n", path.c_str());
+		return false;
+	}
+
+	PrecompiledModuleFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic             = precompiledModuleMagic;
+	header.version           = objectCacheVersion;
+	header.key[0]            = key.hashes[0];
+	header.key[1]            = key.hashes[1];
+	header.featureSpec       = module.featureSpec;
+	header.optimizationLevel = U8(optimizationLevel);
+	header.numTargetBytes    = targetString.size();
+	header.numWASMBytes      = wasmBytes.size();
+	header.numObjects        = objects.size();
+	stream.write((const char*)&header, sizeof(header));
+	stream.write(targetString.data(), targetString.size());
+	stream.write((const char*)wasmBytes.data(), wasmBytes.size());
+	writeObjects(stream, objects);
+
+	stream.close();
+	if(stream.has_error())
+	{
+		stream.clear_error();
+		Log::printf(Log::error, "Couldn't write precompiled module file: %s\n", path.c_str());
+		return false;
+	}
+
+	Timing::logTimer("Wrote precompiled module", writeTimer);
+	return true;
+}
+
+std::unique_ptr<llvm::MemoryBuffer> LLVMJIT::readPrecompiledModuleFile(
+	const std::string& path,
+	IR::Module& outModule,
+	ObjectCacheKey& outKey,
+	OptimizationLevel& outOptimizationLevel,
+	std::vector<ObjectBinary>& outObjects)
+{
+	Timing::Timer readTimer;
+
+	// Map the file into memory. The loaded objects reference the mapped file, so the caller must
+	// keep the returned buffer alive while it uses them.
+	auto fileBufferOrError = llvm::MemoryBuffer::getFile(path, -1, false);
+	if(!fileBufferOrError)
+	{
+		Log::printf(Log::error, "Couldn't read precompiled module file: %s\n", path.c_str());
+		return nullptr;
+	}
+	std::unique_ptr<llvm::MemoryBuffer> fileBuffer = std::move(*fileBufferOrError);
+	const U8* fileBytes                            = (const U8*)fileBuffer->getBufferStart();
+	const Uptr numFileBytes                        = fileBuffer->getBufferSize();
+
+	PrecompiledModuleFileHeader header;
+	if(numFileBytes < sizeof(header)) { return invalidPrecompiledModuleFile(path); }
+	memcpy(&header, fileBytes, sizeof(header));
+	if(header.magic != precompiledModuleMagic || header.version != objectCacheVersion
+	   || header.optimizationLevel > U8(OptimizationLevel::full)
+	   || header.numTargetBytes > numFileBytes - sizeof(header)
+	   || header.numWASMBytes > numFileBytes - sizeof(header) - header.numTargetBytes)
+	{ return invalidPrecompiledModuleFile(path); }
+
+	// Check that the object code was compiled for this host before doing anything else with it.
+	const std::string targetString = getTargetString();
+	const U8* fileTargetBytes      = fileBytes + sizeof(header);
+	if(header.numTargetBytes != targetString.size()
+	   || memcmp(fileTargetBytes, targetString.data(), targetString.size()))
+	{
+		Log::printf(Log::error,
+					"Precompiled module %s was compiled for a different target:\n"
+					"  compiled for: %.*s\n"
+					"  host:         %s\n",
+					path.c_str(),
+					int(header.numTargetBytes),
+					(const char*)fileTargetBytes,
+					targetString.c_str());
+		return nullptr;
+	}
+
+	// Decode the module's WebAssembly binary.
+	const U8* wasmBytes   = fileTargetBytes + header.numTargetBytes;
+	outModule.featureSpec = header.featureSpec;
+	try
+	{
+		Serialization::MemoryInputStream wasmStream(wasmBytes, Uptr(header.numWASMBytes));
+		WASM::serialize(wasmStream, outModule);
+	}
+	catch(Serialization::FatalSerializationException exception)
+	{
+		return invalidPrecompiledModuleFile(path);
+	}
+	catch(IR::ValidationException exception)
+	{
+		return invalidPrecompiledModuleFile(path);
+	}
+
+	const Uptr objectsOffset = Uptr(wasmBytes + header.numWASMBytes - fileBytes);
+	if(!readObjects(fileBytes, numFileBytes, objectsOffset, header.numObjects, outObjects))
+	{ return invalidPrecompiledModuleFile(path); }
+
+	outKey.hashes[0]     = header.key[0];
+	outKey.hashes[1]     = header.key[1];
+	outOptimizationLevel = OptimizationLevel(header.optimizationLevel);
+
+	Timing::logTimer("Read precompiled module", readTimer);
+	return fileBuffer;
+}
+
+void Runtime::setObjectCacheDirectory(const std::string& directory, U64 maxBytes)
+{
+	Lock<Platform::Mutex> configLock(objectCacheConfigMutex);
+	objectCacheDirectory = directory;
+	objectCacheMaxBytes  = maxBytes;
+}
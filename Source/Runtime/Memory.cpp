@@ -4,6 +4,11 @@
 #include "Runtime.h"
 #include "RuntimePrivate.h"
 
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
 using namespace Runtime;
 
 // Global lists of memories; used to query whether an address is reserved by one of them.
@@ -12,43 +17,203 @@ static std::vector<MemoryInstance*> memories;
 
 enum
 {
-	numGuardPages = 1
+	numGuardPages                      = 1,
+	defaultMaxPooledMemoryReservations = 16
+};
+
+// The address space reserved for a memory that has been freed, kept to be reused by a new memory
+// instead of being unmapped. All its pages are decommitted. If the freed memory wrote to a page
+// file, the page file stays mapped to the reservation, with all its pages reset to zero.
+struct PooledMemoryReservation
+{
+	U8* baseAddress;
+	std::shared_ptr<Platform::PageFile> pageFile;
 };
 
+// Guarded by memoriesMutex.
+static std::vector<PooledMemoryReservation> pooledMemoryReservations;
+static Uptr maxPooledMemoryReservations    = defaultMaxPooledMemoryReservations;
+static Uptr numAllocatedMemoryReservations = 0;
+static Uptr numReusedMemoryReservations    = 0;
+static Uptr numFreedMemoryReservations     = 0;
+
 static Uptr getPlatformPagesPerWebAssemblyPageLog2()
 {
 	errorUnless(Platform::getPageSizeLog2() <= IR::numBytesPerPageLog2);
 	return IR::numBytesPerPageLog2 - Platform::getPageSizeLog2();
 }
 
-MemoryInstance* Runtime::createMemory(Compartment* compartment, MemoryType type)
+// Copies a memory's number of pages to its compartment's runtime data for generated code to read.
+static void updateRuntimeDataNumPages(MemoryInstance* memory)
 {
-	MemoryInstance* memory = new MemoryInstance(compartment, type);
+	if(memory->compartment && memory->id != UINTPTR_MAX)
+	{ memory->compartment->runtimeData->memoryNumPages[memory->id].store(memory->numPages); }
+}
 
-	// On a 64-bit runtime, allocate 8GB of address space for the memory.
-	// This allows eliding bounds checks on memory accesses, since a 32-bit index + 32-bit offset
-	// will always be within the reserved address-space.
-	const Uptr pageBytesLog2  = Platform::getPageSizeLog2();
-	const Uptr memoryMaxBytes = Uptr(8ull * 1024 * 1024 * 1024);
-	const Uptr memoryMaxPages = memoryMaxBytes >> pageBytesLog2;
+// On a 64-bit runtime, allocate 8GB of address space for each memory.
+// This allows eliding bounds checks on memory accesses, since a 32-bit index + 32-bit offset
+// will always be within the reserved address-space.
+static const Uptr memoryMaxBytes = Uptr(8ull * 1024 * 1024 * 1024);
 
-	memory->baseAddress = Platform::allocateVirtualPages(memoryMaxPages + numGuardPages);
-	memory->endOffset   = memoryMaxBytes;
-	if(!memory->baseAddress)
+static Uptr getMemoryNumPageFilePages() { return memoryMaxBytes >> Platform::getPageSizeLog2(); }
+static Uptr getMemoryNumReservedPages() { return getMemoryNumPageFilePages() + numGuardPages; }
+
+// Applies a memory's commit policy to a range of its committed pages.
+static bool applyMemoryCommitPolicy(MemoryInstance* memory, Uptr pageIndex, Uptr numPages)
+{
+	const MemoryCommitPolicy& policy = memory->commitPolicy;
+	U8* baseAddress                  = memory->baseAddress + (pageIndex << IR::numBytesPerPageLog2);
+	const Uptr numPlatformPages      = numPages << getPlatformPagesPerWebAssemblyPageLog2();
+	if(!numPlatformPages) { return true; }
+
+	if(policy.useHugePages) { Platform::adviseHugeVirtualPages(baseAddress, numPlatformPages); }
+
+	// Prefault copy-on-write pages for reading, so they keep sharing the page file's pages until
+	// they are written.
+	const bool isCopyOnWrite = memory->pageFile && !memory->isPageFileShared;
+	if(policy.prefault
+	   && !Platform::prefaultVirtualPages(baseAddress, numPlatformPages, !isCopyOnWrite))
+	{ return false; }
+
+	return !policy.lock || Platform::lockVirtualPages(baseAddress, numPlatformPages);
+}
+
+// Maps a memory's page file to its reserved address space: the first numCommittedPages
+// WebAssembly pages are mapped read-write, and the rest are mapped inaccessible.
+static bool mapMemoryPageFile(MemoryInstance* memory, Uptr numCommittedPages)
+{
+	Platform::PageFile* pageFile = memory->pageFile.get();
+	const bool isCopyOnWrite     = !memory->isPageFileShared;
+	const Uptr numCommittedPlatformPages
+		= numCommittedPages << getPlatformPagesPerWebAssemblyPageLog2();
+	U8* uncommittedBaseAddress
+		= memory->baseAddress + (numCommittedPages << IR::numBytesPerPageLog2);
+
+	if(numCommittedPlatformPages
+	   && !Platform::mapPageFile(pageFile,
+								 0,
+								 memory->baseAddress,
+								 numCommittedPlatformPages,
+								 isCopyOnWrite,
+								 Platform::MemoryAccess::readWrite))
+	{ return false; }
+
+	if(!Platform::mapPageFile(pageFile,
+							  numCommittedPlatformPages,
+							  uncommittedBaseAddress,
+							  getMemoryNumPageFilePages() - numCommittedPlatformPages,
+							  isCopyOnWrite,
+							  Platform::MemoryAccess::none))
+	{ return false; }
+
+	// Mapping the page file replaced the committed pages, so apply the commit policy to them again.
+	return applyMemoryCommitPolicy(memory, 0, numCommittedPages);
+}
+
+// Decommits the physical memory committed to a range of a memory's pages.
+static void decommitMemoryPages(MemoryInstance* memory, Uptr pageIndex, Uptr numPages)
+{
+	const Uptr platformPagesPerWebAssemblyPageLog2 = getPlatformPagesPerWebAssemblyPageLog2();
+
+	U8* baseAddress = memory->baseAddress + (pageIndex << IR::numBytesPerPageLog2);
+	const Uptr numPlatformPages = numPages << platformPagesPerWebAssemblyPageLog2;
+
+	// Locked pages must be unlocked before they are decommitted.
+	if(memory->commitPolicy.lock) { Platform::unlockVirtualPages(baseAddress, numPlatformPages); }
+
+	// If the memory writes to its page file, the pages must be decommitted from the file.
+	if(memory->pageFile && memory->isPageFileShared)
 	{
-		delete memory;
-		return nullptr;
+		Platform::decommitPageFilePages(memory->pageFile.get(),
+										pageIndex << platformPagesPerWebAssemblyPageLog2,
+										numPlatformPages);
 	}
 
-	// Grow the memory to the type's minimum size.
-	wavmAssert(type.size.min <= UINTPTR_MAX);
-	if(growMemory(memory, Uptr(type.size.min)) == -1)
+	Platform::decommitVirtualPages(baseAddress, numPlatformPages);
+}
+
+// Commits physical memory to a range of a memory's pages.
+static bool commitMemoryPages(MemoryInstance* memory, Uptr pageIndex, Uptr numPages)
+{
+	U8* baseAddress = memory->baseAddress + (pageIndex << IR::numBytesPerPageLog2);
+	if(!Platform::commitVirtualPages(baseAddress,
+									 numPages << getPlatformPagesPerWebAssemblyPageLog2()))
+	{ return false; }
+
+	// Decommitting pages of a copy-on-write memory reverts them to the page file's data, so zero
+	// the pages that the page file may have data for.
+	if(memory->pageFile && !memory->isPageFileShared && pageIndex < memory->numPageFileDataPages)
 	{
-		delete memory;
-		return nullptr;
+		const Uptr numDataPages = std::min(numPages, memory->numPageFileDataPages - pageIndex);
+		memset(baseAddress, 0, numDataPages << IR::numBytesPerPageLog2);
 	}
 
-	// Add the memory to the compartment.
+	if(!applyMemoryCommitPolicy(memory, pageIndex, numPages))
+	{
+		decommitMemoryPages(memory, pageIndex, numPages);
+		return false;
+	}
+
+	return true;
+}
+
+// Returns the commit policy of the memories that are created in a compartment.
+static MemoryCommitPolicy getMemoryCommitPolicy(Compartment* compartment)
+{
+	if(!compartment) { return MemoryCommitPolicy(); }
+
+	Lock<Platform::Mutex> compartmentLock(compartment->mutex);
+	return compartment->memoryCommitPolicy;
+}
+
+// Creates a memory and reserves its address space, but doesn't commit any pages to it. The memory
+// may reuse a pooled reservation that a page file is mapped to.
+static MemoryInstance* createMemoryReservation(Compartment* compartment, MemoryType type)
+{
+	MemoryInstance* memory = new MemoryInstance(compartment, type);
+	memory->endOffset      = memoryMaxBytes;
+	memory->commitPolicy   = getMemoryCommitPolicy(compartment);
+
+	// Reuse a pooled address space reservation if there is one, and add the memory to the global
+	// array. Memories that use huge pages need a reservation without a page file.
+	if(!memory->commitPolicy.useHugePages)
+	{
+		Lock<Platform::Mutex> memoriesLock(memoriesMutex);
+		if(pooledMemoryReservations.size())
+		{
+			PooledMemoryReservation& reservation = pooledMemoryReservations.back();
+			memory->baseAddress                  = reservation.baseAddress;
+			memory->pageFile                     = std::move(reservation.pageFile);
+			memory->isPageFileShared             = memory->pageFile != nullptr;
+			pooledMemoryReservations.pop_back();
+			++numReusedMemoryReservations;
+			memories.push_back(memory);
+		}
+	}
+
+	// Otherwise, reserve new address space for the memory.
+	if(!memory->baseAddress)
+	{
+		memory->baseAddress = Platform::allocateVirtualPages(getMemoryNumReservedPages());
+		if(!memory->baseAddress)
+		{
+			delete memory;
+			return nullptr;
+		}
+
+		Lock<Platform::Mutex> memoriesLock(memoriesMutex);
+		++numAllocatedMemoryReservations;
+		memories.push_back(memory);
+	}
+
+	return memory;
+}
+
+// Adds a memory to its compartment. If the compartment already has the maximum number of memories,
+// deletes the memory and returns false.
+static bool addMemoryToCompartment(MemoryInstance* memory)
+{
+	Compartment* compartment = memory->compartment;
 	if(compartment)
 	{
 		Lock<Platform::Mutex> compartmentLock(compartment->mutex);
@@ -56,31 +221,254 @@ MemoryInstance* Runtime::createMemory(Compartment* compartment, MemoryType type)
 		if(compartment->memories.size() >= maxMemories)
 		{
 			delete memory;
-			return nullptr;
+			return false;
 		}
 
 		memory->id = compartment->memories.size();
 		compartment->memories.push_back(memory);
 		compartment->runtimeData->memories[memory->id] = memory->baseAddress;
+		updateRuntimeDataNumPages(memory);
 	}
+	return true;
+}
+
+MemoryInstance* Runtime::createMemory(Compartment* compartment, MemoryType type)
+{
+	MemoryInstance* memory = createMemoryReservation(compartment, type);
+	if(!memory) { return nullptr; }
 
-	// Add the memory to the global array.
+	// If the platform supports it, map a page file to the memory's address space, which the memory
+	// writes to until it is cloned. Otherwise, the memory's pages are anonymous, and cloning it
+	// copies them. A pooled reservation may already have a page file mapped to it. Hosts usually
+	// only allow huge pages for anonymous memory, so memories that use huge pages don't use a page
+	// file.
+	if(!memory->pageFile && !memory->commitPolicy.useHugePages)
 	{
-		Lock<Platform::Mutex> memoriesLock(memoriesMutex);
-		memories.push_back(memory);
+		Platform::PageFile* pageFile = Platform::createPageFile(getMemoryNumPageFilePages());
+		if(pageFile)
+		{
+			memory->pageFile.reset(pageFile, Platform::destroyPageFile);
+			memory->isPageFileShared = true;
+			if(!mapMemoryPageFile(memory, 0))
+			{
+				delete memory;
+				return nullptr;
+			}
+		}
+	}
+
+	// Grow the memory to the type's minimum size.
+	wavmAssert(type.size.min <= UINTPTR_MAX);
+	if(growMemory(memory, Uptr(type.size.min)) == -1)
+	{
+		delete memory;
+		return nullptr;
 	}
+
+	// Add the memory to the compartment.
+	if(!addMemoryToCompartment(memory)) { return nullptr; }
+
 	return memory;
 }
 
+// If a memory writes to its page file, remaps it copy-on-write, so the page file doesn't change
+// after this, and can be shared with other memories. The memory's pages are in the page file, so
+// this doesn't change their contents, and they are only copied when the memory writes to them.
+// Returns false if the page file couldn't be remapped, in which case the memory still writes to it.
+static bool freezeMemoryPageFile(MemoryInstance* memory)
+{
+	if(!memory->isPageFileShared) { return true; }
+
+	const Uptr numPageFileDataPages = memory->numPageFileDataPages;
+	memory->isPageFileShared        = false;
+	memory->numPageFileDataPages    = memory->numPages;
+	if(mapMemoryPageFile(memory, memory->numPages)) { return true; }
+
+	// Map the page file back to the memory read-write, which restores its pages. If that fails
+	// too, the memory has no usable mapping of its pages.
+	memory->isPageFileShared     = true;
+	memory->numPageFileDataPages = numPageFileDataPages;
+	if(!mapMemoryPageFile(memory, memory->numPages))
+	{ Errors::fatal("Failed to restore memory's mapping of its page file"); }
+	return false;
+}
+
+// Maps a page file copy-on-write to a memory that was created by createMemoryReservation, and
+// commits its first numPages pages. If it fails, deletes the memory and returns false.
+static bool mapCopyOnWritePageFile(MemoryInstance* memory,
+								   const std::shared_ptr<Platform::PageFile>& pageFile,
+								   Uptr numPageFileDataPages,
+								   Uptr numPages)
+{
+	memory->pageFile             = pageFile;
+	memory->isPageFileShared     = false;
+	memory->numPageFileDataPages = numPageFileDataPages;
+	if(!mapMemoryPageFile(memory, numPages))
+	{
+		delete memory;
+		return false;
+	}
+	memory->numPages = numPages;
+	return true;
+}
+
+// Calls visitRun for each run of consecutive platform pages that a copy-on-write memory has written
+// since it was mapped, which no longer match its page file. If the platform can't determine which
+// pages those are, calls visitRun for all the memory's pages.
+static void visitCopiedPageRuns(MemoryInstance* memory,
+								const std::function<void(Uptr, Uptr)>& visitRun)
+{
+	wavmAssert(memory->pageFile && !memory->isPageFileShared);
+	const Uptr numPlatformPages = memory->numPages << getPlatformPagesPerWebAssemblyPageLog2();
+	std::vector<bool> isPageCopied;
+	if(!Platform::getCopiedVirtualPages(memory->baseAddress, numPlatformPages, isPageCopied))
+	{ isPageCopied.assign(numPlatformPages, true); }
+
+	Uptr pageIndex = 0;
+	while(pageIndex < numPlatformPages)
+	{
+		if(!isPageCopied[pageIndex])
+		{
+			++pageIndex;
+			continue;
+		}
+		const Uptr runPageIndex = pageIndex;
+		while(pageIndex < numPlatformPages && isPageCopied[pageIndex]) { ++pageIndex; }
+		visitRun(runPageIndex, pageIndex - runPageIndex);
+	}
+}
+
 MemoryInstance* Runtime::cloneMemory(MemoryInstance* memory, Compartment* newCompartment)
 {
-	MemoryInstance* newMemory = createMemory(newCompartment, memory->type);
-	const Uptr numPages       = memory->numPages;
-	growMemory(newMemory, numPages);
-	memcpy(newMemory->baseAddress, memory->baseAddress, numPages * IR::numBytesPerPage);
+	const Uptr numPages = memory->numPages;
+
+	// If the memory doesn't have a page file, copy all its pages. Hosts usually only allow huge
+	// pages for anonymous memory, so also copy the pages if the clone uses huge pages.
+	if(!memory->pageFile || getMemoryCommitPolicy(newCompartment).useHugePages)
+	{
+		MemoryInstance* newMemory = createMemory(newCompartment, memory->type);
+		if(!newMemory) { return nullptr; }
+
+		// If the new memory can't grow to the memory's size, fail the clone. The new memory is
+		// already in the compartment, so the garbage collector frees it.
+		if(growMemory(newMemory, numPages - newMemory->numPages) == -1) { return nullptr; }
+		memcpy(newMemory->baseAddress, memory->baseAddress, numPages * IR::numBytesPerPage);
+		return newMemory;
+	}
+
+	// Map the memory's page file to the clone, copy-on-write.
+	if(!freezeMemoryPageFile(memory)) { return nullptr; }
+	MemoryInstance* newMemory = createMemoryReservation(newCompartment, memory->type);
+	if(!newMemory
+	   || !mapCopyOnWritePageFile(
+			  newMemory, memory->pageFile, memory->numPageFileDataPages, numPages))
+	{ return nullptr; }
+
+	// Copy the pages that the memory has written since it was mapped copy-on-write.
+	const Uptr pageBytesLog2 = Platform::getPageSizeLog2();
+	visitCopiedPageRuns(memory, [&](Uptr runPageIndex, Uptr numRunPages) {
+		memcpy(newMemory->baseAddress + (runPageIndex << pageBytesLog2),
+			   memory->baseAddress + (runPageIndex << pageBytesLog2),
+			   numRunPages << pageBytesLog2);
+	});
+
+	// Add the clone to the compartment.
+	if(!addMemoryToCompartment(newMemory)) { return nullptr; }
+
 	return newMemory;
 }
 
+MemorySnapshot Runtime::snapshotMemory(MemoryInstance* memory)
+{
+	MemorySnapshot snapshot;
+	snapshot.type                 = memory->type;
+	snapshot.numPages             = memory->numPages;
+	snapshot.numPageFileDataPages = 0;
+
+	const Uptr pageBytesLog2 = Platform::getPageSizeLog2();
+	if(memory->pageFile && freezeMemoryPageFile(memory))
+	{
+		// Share the memory's page file with the snapshot, and copy the pages that the memory has
+		// written since it was mapped copy-on-write.
+		snapshot.pageFile             = memory->pageFile;
+		snapshot.numPageFileDataPages = memory->numPageFileDataPages;
+		visitCopiedPageRuns(memory, [&](Uptr runPageIndex, Uptr numRunPages) {
+			U8* runBaseAddress = memory->baseAddress + (runPageIndex << pageBytesLog2);
+			snapshot.copiedPageRuns.push_back({runPageIndex, numRunPages});
+			snapshot.copiedPageData.insert(snapshot.copiedPageData.end(),
+										   runBaseAddress,
+										   runBaseAddress + (numRunPages << pageBytesLog2));
+		});
+	}
+	else if(snapshot.numPages)
+	{
+		// If the memory doesn't have a page file, or it couldn't be remapped copy-on-write, copy
+		// all its pages.
+		const Uptr numPlatformPages = snapshot.numPages << getPlatformPagesPerWebAssemblyPageLog2();
+		snapshot.copiedPageRuns.push_back({0, numPlatformPages});
+		snapshot.copiedPageData.assign(
+			memory->baseAddress, memory->baseAddress + (numPlatformPages << pageBytesLog2));
+	}
+
+	return snapshot;
+}
+
+MemoryInstance* Runtime::restoreMemorySnapshot(const MemorySnapshot& snapshot,
+											   Compartment* compartment)
+{
+	MemoryInstance* memory = createMemoryReservation(compartment, snapshot.type);
+	if(!memory) { return nullptr; }
+
+	// Hosts usually only allow huge pages for anonymous memory, so if the new memory uses huge
+	// pages, restore the snapshot to a temporary memory that maps its page file, and copy its pages
+	// to the new memory.
+	if(snapshot.pageFile && memory->commitPolicy.useHugePages)
+	{
+		MemoryInstance* pageFileMemory = restoreMemorySnapshot(snapshot, nullptr);
+		if(!pageFileMemory || growMemory(memory, snapshot.numPages) == -1)
+		{
+			delete pageFileMemory;
+			delete memory;
+			return nullptr;
+		}
+		memcpy(memory->baseAddress,
+			   pageFileMemory->baseAddress,
+			   snapshot.numPages << IR::numBytesPerPageLog2);
+		delete pageFileMemory;
+		if(!addMemoryToCompartment(memory)) { return nullptr; }
+		return memory;
+	}
+
+	// Otherwise, map the snapshot's page file to the new memory copy-on-write, or if it doesn't
+	// have one, commit the memory's pages.
+	if(snapshot.pageFile)
+	{
+		if(!mapCopyOnWritePageFile(
+			   memory, snapshot.pageFile, snapshot.numPageFileDataPages, snapshot.numPages))
+		{ return nullptr; }
+	}
+	else if(growMemory(memory, snapshot.numPages) == -1)
+	{
+		delete memory;
+		return nullptr;
+	}
+
+	// Copy the pages that the snapshot doesn't share with the page file.
+	const Uptr pageBytesLog2 = Platform::getPageSizeLog2();
+	const U8* copiedPageData = snapshot.copiedPageData.data();
+	for(const std::pair<Uptr, Uptr>& run : snapshot.copiedPageRuns)
+	{
+		const Uptr numRunBytes = run.second << pageBytesLog2;
+		memcpy(memory->baseAddress + (run.first << pageBytesLog2), copiedPageData, numRunBytes);
+		copiedPageData += numRunBytes;
+	}
+
+	// Add the memory to the compartment.
+	if(!addMemoryToCompartment(memory)) { return nullptr; }
+
+	return memory;
+}
+
 void Runtime::MemoryInstance::finalize()
 {
 	Lock<Platform::Mutex> compartmentLock(compartment->mutex);
@@ -88,35 +476,107 @@ void Runtime::MemoryInstance::finalize()
 	wavmAssert(compartment->runtimeData->memories[id] == baseAddress);
 	compartment->memories[id]              = nullptr;
 	compartment->runtimeData->memories[id] = nullptr;
+	compartment->runtimeData->memoryNumPages[id].store(0);
 }
 
 Runtime::MemoryInstance::~MemoryInstance()
 {
-	// Decommit all default memory pages.
-	if(numPages > 0)
+	if(!baseAddress) { return; }
+
+	std::shared_ptr<Platform::PageFile> pooledPageFile;
+	if(pageFile && isPageFileShared)
 	{
-		Platform::decommitVirtualPages(baseAddress,
-									   numPages << getPlatformPagesPerWebAssemblyPageLog2());
+		// The memory is the only mapping of its page file, so the page file can stay mapped to the
+		// reservation if it is pooled. Decommit the memory's pages from it, which resets all its
+		// pages to zero.
+		if(numPages > 0) { decommitMemoryPages(this, 0, numPages); }
+		pooledPageFile = std::move(pageFile);
+	}
+	else if(pageFile)
+	{
+		// Unmap the copy-on-write page file, which resets the whole reservation to its initial
+		// state. The page file is destroyed when no memories map it.
+		Platform::unmapPageFile(baseAddress, getMemoryNumPageFilePages());
+		pageFile = nullptr;
+	}
+	else if(numPages > 0)
+	{
+		// Decommit all default memory pages. Pages beyond numPages were never committed, or were
+		// decommitted when they were shrunk off the end of the memory, so this resets the whole
+		// reservation to its initial state without touching the rest of the address space.
+		decommitMemoryPages(this, 0, numPages);
 	}
 
-	// Free the virtual address space.
-	const Uptr pageBytesLog2 = Platform::getPageSizeLog2();
-	if(endOffset > 0)
-	{ Platform::freeVirtualPages(baseAddress, (endOffset >> pageBytesLog2) + numGuardPages); }
-	baseAddress = nullptr;
-
-	// Remove the memory from the global array.
+	// Remove the memory from the global array, and add its address space reservation to the pool
+	// if it isn't full. The huge page hint can't be removed from a reservation, so don't pool the
+	// reservations of memories that use huge pages.
+	bool isReservationPooled = false;
 	{
 		Lock<Platform::Mutex> memoriesLock(memoriesMutex);
 		for(Uptr memoryIndex = 0; memoryIndex < memories.size(); ++memoryIndex)
 		{
 			if(memories[memoryIndex] == this)
 			{
-				memories.erase(memories.begin() + memoryIndex);
+				memories[memoryIndex] = memories.back();
+				memories.pop_back();
 				break;
 			}
 		}
+
+		if(pooledMemoryReservations.size() < maxPooledMemoryReservations
+		   && !commitPolicy.useHugePages)
+		{
+			pooledMemoryReservations.push_back({baseAddress, std::move(pooledPageFile)});
+			isReservationPooled = true;
+		}
+		else
+		{
+			++numFreedMemoryReservations;
+		}
+	}
+
+	// Otherwise, free the virtual address space.
+	if(!isReservationPooled)
+	{ Platform::freeVirtualPages(baseAddress, getMemoryNumReservedPages()); }
+	baseAddress = nullptr;
+}
+
+void Runtime::setMaxPooledMemoryReservations(Uptr maxReservations)
+{
+	// Remove reservations from the pool until it fits the new size, and free them.
+	std::vector<PooledMemoryReservation> freedReservations;
+	{
+		Lock<Platform::Mutex> memoriesLock(memoriesMutex);
+		maxPooledMemoryReservations = maxReservations;
+		while(pooledMemoryReservations.size() > maxPooledMemoryReservations)
+		{
+			freedReservations.push_back(std::move(pooledMemoryReservations.back()));
+			pooledMemoryReservations.pop_back();
+			++numFreedMemoryReservations;
+		}
 	}
+
+	for(const PooledMemoryReservation& reservation : freedReservations)
+	{ Platform::freeVirtualPages(reservation.baseAddress, getMemoryNumReservedPages()); }
+}
+
+void Runtime::setMemoryCommitPolicy(Compartment* compartment, const MemoryCommitPolicy& policy)
+{
+	Lock<Platform::Mutex> compartmentLock(compartment->mutex);
+	compartment->memoryCommitPolicy = policy;
+}
+
+MemoryReservationPoolStats Runtime::getMemoryReservationPoolStats()
+{
+	Lock<Platform::Mutex> memoriesLock(memoriesMutex);
+
+	MemoryReservationPoolStats stats;
+	stats.numPooledReservations    = pooledMemoryReservations.size();
+	stats.maxPooledReservations    = maxPooledMemoryReservations;
+	stats.numAllocatedReservations = numAllocatedMemoryReservations;
+	stats.numReusedReservations    = numReusedMemoryReservations;
+	stats.numFreedReservations     = numFreedMemoryReservations;
+	return stats;
 }
 
 bool Runtime::isAddressOwnedByMemory(U8* address)
@@ -152,11 +612,9 @@ Iptr Runtime::growMemory(MemoryInstance* memory, Uptr numNewPages)
 		{ return -1; }
 
 		// Try to commit the new pages, and return -1 if the commit fails.
-		if(!Platform::commitVirtualPages(
-			   memory->baseAddress + (memory->numPages << IR::numBytesPerPageLog2),
-			   numNewPages << getPlatformPagesPerWebAssemblyPageLog2()))
-		{ return -1; }
+		if(!commitMemoryPages(memory, memory->numPages, numNewPages)) { return -1; }
 		memory->numPages += numNewPages;
+		updateRuntimeDataNumPages(memory);
 	}
 	return previousNumPages;
 }
@@ -172,11 +630,10 @@ Iptr Runtime::shrinkMemory(MemoryInstance* memory, Uptr numPagesToShrink)
 		   || memory->numPages - numPagesToShrink < memory->type.size.min)
 		{ return -1; }
 		memory->numPages -= numPagesToShrink;
+		updateRuntimeDataNumPages(memory);
 
 		// Decommit the pages that were shrunk off the end of the memory.
-		Platform::decommitVirtualPages(
-			memory->baseAddress + (memory->numPages << IR::numBytesPerPageLog2),
-			numPagesToShrink << getPlatformPagesPerWebAssemblyPageLog2());
+		decommitMemoryPages(memory, memory->numPages, numPagesToShrink);
 	}
 	return previousNumPages;
 }
@@ -188,8 +645,7 @@ void Runtime::unmapMemoryPages(MemoryInstance* memory, Uptr pageIndex, Uptr numP
 	wavmAssert(pageIndex + numPages < memory->numPages);
 
 	// Decommit the pages.
-	Platform::decommitVirtualPages(memory->baseAddress + (pageIndex << IR::numBytesPerPageLog2),
-								   numPages << getPlatformPagesPerWebAssemblyPageLog2());
+	decommitMemoryPages(memory, pageIndex, numPages);
 }
 
 U8* Runtime::getMemoryBaseAddress(MemoryInstance* memory) { return memory->baseAddress; }
@@ -1,10 +1,15 @@
 #include "IR/Module.h"
 #include "Inline/Assert.h"
 #include "Inline/BasicTypes.h"
+#include "Inline/Hash.h"
+#include "Inline/Lock.h"
+#include "Logging/Logging.h"
 #include "Runtime.h"
 #include "RuntimePrivate.h"
 
 #include <string.h>
+#include <memory>
+#include <vector>
 
 using namespace Runtime;
 
@@ -28,10 +33,177 @@ static Value evaluateInitializer(ModuleInstance* moduleInstance, InitializerExpr
 	};
 }
 
-ModuleInstance* Runtime::instantiateModule(Compartment* compartment,
-										   const IR::Module& module,
-										   ImportBindings&& imports,
-										   std::string&& moduleDebugName)
+// The contents of a memory after copying a module's data segments into it. Later instances of the
+// module that initialize their memory with the same data segments restore it copy-on-write instead
+// of copying the data segments.
+struct MemoryImage
+{
+	U64 hashes[2];
+	Uptr numDataBytes;
+	MemorySnapshot snapshot;
+};
+
+enum
+{
+	defaultMaxMemoryImageCacheBytes = 256 * 1024 * 1024
+};
+
+static Platform::Mutex memoryImageCacheMutex;
+static std::vector<std::shared_ptr<MemoryImage>> memoryImageCache;
+static Uptr numMemoryImageCacheBytes      = 0;
+static Uptr maxMemoryImageCacheBytes      = defaultMaxMemoryImageCacheBytes;
+static Uptr numRestoredMemoriesFromImages = 0;
+static Uptr numRejectedMemoryImages       = 0;
+
+// Hashes everything a memory's initial contents depend on: the memory's type, and the offset and
+// contents of each data segment that is copied into it. Returns false if no data segments are
+// copied into the memory.
+static bool getMemoryImageHashes(const IR::Module& module,
+								 ModuleInstance* moduleInstance,
+								 Uptr memoryIndex,
+								 const MemoryType& type,
+								 U64 outHashes[2],
+								 Uptr& outNumDataBytes)
+{
+	std::vector<U64> keyData = {U64(type.isShared), type.size.min, type.size.max};
+	outNumDataBytes          = 0;
+	for(const DataSegment& dataSegment : module.dataSegments)
+	{
+		if(dataSegment.memoryIndex != memoryIndex || !dataSegment.data.size()) { continue; }
+
+		const Value baseOffsetValue = evaluateInitializer(moduleInstance, dataSegment.baseOffset);
+		errorUnless(baseOffsetValue.type == ValueType::i32);
+		keyData.push_back(baseOffsetValue.i32);
+		keyData.push_back(dataSegment.data.size());
+		keyData.push_back(XXH<U64>(dataSegment.data.data(), dataSegment.data.size(), 0));
+		outNumDataBytes += dataSegment.data.size();
+	}
+	if(!outNumDataBytes) { return false; }
+
+	outHashes[0] = XXH<U64>(keyData.data(), keyData.size() * sizeof(U64), 0);
+	outHashes[1] = XXH<U64>(keyData.data(), keyData.size() * sizeof(U64), 1);
+	return true;
+}
+
+// Returns true if a memory that was restored from an image has the type and size that the module
+// defines it with, and contains the module's data segments. Images are found by hashing the data
+// segments, so this rejects an image that was found by a hash collision.
+static bool isMemoryImageValid(const IR::Module& module,
+							   ModuleInstance* moduleInstance,
+							   Uptr memoryIndex,
+							   const MemoryType& type,
+							   MemoryInstance* memory)
+{
+	if(!(memory->type == type) || memory->numPages != type.size.min) { return false; }
+
+	const Uptr numMemoryBytes = memory->numPages << IR::numBytesPerPageLog2;
+	for(const DataSegment& dataSegment : module.dataSegments)
+	{
+		if(dataSegment.memoryIndex != memoryIndex || !dataSegment.data.size()) { continue; }
+
+		const Value baseOffsetValue = evaluateInitializer(moduleInstance, dataSegment.baseOffset);
+		errorUnless(baseOffsetValue.type == ValueType::i32);
+		const U32 baseOffset = baseOffsetValue.i32;
+		if(baseOffset > numMemoryBytes || numMemoryBytes - baseOffset < dataSegment.data.size()
+		   || memcmp(memory->baseAddress + baseOffset,
+					 dataSegment.data.data(),
+					 dataSegment.data.size()))
+		{ return false; }
+	}
+	return true;
+}
+
+// Evicts the least recently used memory images until the data segments of the cached images are
+// no larger than maxMemoryImageCacheBytes. The caller must lock memoryImageCacheMutex.
+static void evictMemoryImages()
+{
+	while(numMemoryImageCacheBytes > maxMemoryImageCacheBytes)
+	{
+		numMemoryImageCacheBytes -= memoryImageCache.front()->numDataBytes;
+		memoryImageCache.erase(memoryImageCache.begin());
+	}
+}
+
+// Finds a memory image in the cache, and marks it as most recently used. Returns null if it isn't
+// in the cache.
+static std::shared_ptr<MemoryImage> findMemoryImage(const U64 hashes[2])
+{
+	Lock<Platform::Mutex> memoryImageCacheLock(memoryImageCacheMutex);
+	for(auto it = memoryImageCache.begin(); it != memoryImageCache.end(); ++it)
+	{
+		if((*it)->hashes[0] == hashes[0] && (*it)->hashes[1] == hashes[1])
+		{
+			std::shared_ptr<MemoryImage> memoryImage = *it;
+			memoryImageCache.erase(it);
+			memoryImageCache.push_back(memoryImage);
+			return memoryImage;
+		}
+	}
+	return nullptr;
+}
+
+// Adds a memory image to the cache, and evicts the least recently used images until the data
+// segments of the cached images are no larger than maxMemoryImageCacheBytes.
+static void addMemoryImage(const std::shared_ptr<MemoryImage>& memoryImage)
+{
+	Lock<Platform::Mutex> memoryImageCacheLock(memoryImageCacheMutex);
+
+	// If another thread added an image of the same memory concurrently, keep its image.
+	for(const std::shared_ptr<MemoryImage>& cachedImage : memoryImageCache)
+	{
+		if(cachedImage->hashes[0] == memoryImage->hashes[0]
+		   && cachedImage->hashes[1] == memoryImage->hashes[1])
+		{ return; }
+	}
+
+	memoryImageCache.push_back(memoryImage);
+	numMemoryImageCacheBytes += memoryImage->numDataBytes;
+	evictMemoryImages();
+}
+
+void Runtime::setMaxMemoryImageCacheBytes(Uptr maxBytes)
+{
+	Lock<Platform::Mutex> memoryImageCacheLock(memoryImageCacheMutex);
+	maxMemoryImageCacheBytes = maxBytes;
+	evictMemoryImages();
+}
+
+MemoryImageCacheStats Runtime::getMemoryImageCacheStats()
+{
+	Lock<Platform::Mutex> memoryImageCacheLock(memoryImageCacheMutex);
+
+	MemoryImageCacheStats stats;
+	stats.numImages           = memoryImageCache.size();
+	stats.numDataBytes        = numMemoryImageCacheBytes;
+	stats.maxDataBytes        = maxMemoryImageCacheBytes;
+	stats.numRestoredMemories = numRestoredMemoriesFromImages;
+	stats.numRejectedImages   = numRejectedMemoryImages;
+	return stats;
+}
+
+// Returns true if a compartment's new memories may be restored from memory images. Hosts usually
+// only allow huge pages for anonymous memory, so restoring an image copy-on-write to a memory
+// that uses huge pages would either not use huge pages, or copy the whole image. Copying the data
+// segments is cheaper, so those memories don't use the cache.
+static bool shouldUseMemoryImages(Compartment* compartment)
+{
+	{
+		Lock<Platform::Mutex> compartmentLock(compartment->mutex);
+		if(compartment->memoryCommitPolicy.useHugePages) { return false; }
+	}
+
+	Lock<Platform::Mutex> memoryImageCacheLock(memoryImageCacheMutex);
+	return maxMemoryImageCacheBytes > 0;
+}
+
+// Instantiates a module, and either compiles its code with the specified optimization level, or
+// loads the code that was compiled for it ahead of time if precompiledModule is non-null.
+static ModuleInstance* instantiateModuleImpl(Compartment* compartment,
+											 const IR::Module& module,
+											 ImportBindings&& imports,
+											 std::string&& moduleDebugName,
+											 OptimizationLevel optimizationLevel,
+											 PrecompiledModule* precompiledModule)
 {
 	ModuleInstance* moduleInstance = new ModuleInstance(compartment,
 														std::move(imports.functions),
@@ -85,11 +257,60 @@ ModuleInstance* Runtime::instantiateModule(Compartment* compartment,
 		if(!table) { throwException(Exception::outOfMemoryType); }
 		moduleInstance->tables.push_back(table);
 	}
+	const bool useMemoryImages = shouldUseMemoryImages(compartment);
+	std::vector<std::shared_ptr<MemoryImage>> memoryImages(module.memories.imports.size());
 	for(const MemoryDef& memoryDef : module.memories.defs)
 	{
-		auto memory = createMemory(compartment, memoryDef.type);
+		// If an earlier instance of the module copied the same data segments into the memory,
+		// restore the memory from its image.
+		const Uptr memoryIndex = moduleInstance->memories.size();
+		std::shared_ptr<MemoryImage> memoryImage;
+		U64 hashes[2];
+		Uptr numDataBytes = 0;
+		if(useMemoryImages
+		   && getMemoryImageHashes(
+				  module, moduleInstance, memoryIndex, memoryDef.type, hashes, numDataBytes))
+		{
+			memoryImage = findMemoryImage(hashes);
+			if(!memoryImage)
+			{
+				memoryImage               = std::make_shared<MemoryImage>();
+				memoryImage->hashes[0]    = hashes[0];
+				memoryImage->hashes[1]    = hashes[1];
+				memoryImage->numDataBytes = numDataBytes;
+			}
+		}
+
+		MemoryInstance* memory = nullptr;
+		if(memoryImage && memoryImage->snapshot.pageFile)
+		{
+			memory = restoreMemorySnapshot(memoryImage->snapshot, compartment);
+			if(!memory) { throwException(Exception::outOfMemoryType); }
+
+			// If the image doesn't contain the module's data segments, create a new memory and copy
+			// the data segments into it, without caching its image. Nothing references the
+			// restored memory, so the garbage collector frees it.
+			const bool isImageValid
+				= isMemoryImageValid(module, moduleInstance, memoryIndex, memoryDef.type, memory);
+			Lock<Platform::Mutex> memoryImageCacheLock(memoryImageCacheMutex);
+			if(isImageValid)
+			{
+				++numRestoredMemoriesFromImages;
+				Log::printf(Log::metrics,
+							"Restored memory from the image of an earlier instance\n");
+			}
+			else
+			{
+				++numRejectedMemoryImages;
+				Log::printf(Log::debug, "Rejected a memory image that doesn't match the module\n");
+				memory      = nullptr;
+				memoryImage = nullptr;
+			}
+		}
+		if(!memory) { memory = createMemory(compartment, memoryDef.type); }
 		if(!memory) { throwException(Exception::outOfMemoryType); }
 		moduleInstance->memories.push_back(memory);
+		memoryImages.push_back(memoryImage);
 	}
 
 	// Find the default memory and table for the module and initialize the runtime data memory/table
@@ -129,9 +350,13 @@ ModuleInstance* Runtime::instantiateModule(Compartment* compartment,
 		{ throwException(Exception::invalidSegmentOffsetType); }
 	}
 
-	// Copy the module's data segments into the module's default memory.
+	// Copy the module's data segments into the module's default memory, unless it was restored from
+	// an image that already contains them.
 	for(const DataSegment& dataSegment : module.dataSegments)
 	{
+		const std::shared_ptr<MemoryImage>& memoryImage = memoryImages[dataSegment.memoryIndex];
+		if(memoryImage && memoryImage->snapshot.pageFile) { continue; }
+
 		MemoryInstance* memory = moduleInstance->memories[dataSegment.memoryIndex];
 
 		const Value baseOffsetValue = evaluateInitializer(moduleInstance, dataSegment.baseOffset);
@@ -148,6 +373,20 @@ ModuleInstance* Runtime::instantiateModule(Compartment* compartment,
 		}
 	}
 
+	// Snapshot the memories that data segments were copied into, so later instances of the module
+	// can restore them copy-on-write. If the platform doesn't support sharing the memory's pages,
+	// restoring the snapshot would copy them, so it isn't worth caching.
+	for(Uptr memoryIndex = 0; memoryIndex < memoryImages.size(); ++memoryIndex)
+	{
+		const std::shared_ptr<MemoryImage>& memoryImage = memoryImages[memoryIndex];
+		MemoryInstance* memory = moduleInstance->memories[memoryIndex];
+		if(memoryImage && !memoryImage->snapshot.pageFile && memory->pageFile)
+		{
+			memoryImage->snapshot = snapshotMemory(memory);
+			addMemoryImage(memoryImage);
+		}
+	}
+
 	// Instantiate the module's global definitions.
 	for(const GlobalDef& globalDef : module.globals.defs)
 	{
@@ -182,8 +421,17 @@ ModuleInstance* Runtime::instantiateModule(Compartment* compartment,
 		moduleInstance->functions.push_back(functionInstance);
 	}
 
-	// Generate machine code for the module.
-	LLVMJIT::instantiateModule(module, moduleInstance);
+	// Generate machine code for the module, or load the machine code that was compiled for it ahead
+	// of time.
+	if(precompiledModule)
+	{
+		if(!LLVMJIT::instantiatePrecompiledModule(moduleInstance, precompiledModule))
+		{ return nullptr; }
+	}
+	else
+	{
+		LLVMJIT::instantiateModule(module, moduleInstance, optimizationLevel);
+	}
 
 	// Set up the instance's exports.
 	for(const Export& exportIt : module.exports)
@@ -237,6 +485,33 @@ ModuleInstance* Runtime::instantiateModule(Compartment* compartment,
 	return moduleInstance;
 }
 
+ModuleInstance* Runtime::instantiateModule(Compartment* compartment,
+										   const IR::Module& module,
+										   ImportBindings&& imports,
+										   std::string&& moduleDebugName,
+										   OptimizationLevel optimizationLevel)
+{
+	return instantiateModuleImpl(compartment,
+								 module,
+								 std::move(imports),
+								 std::move(moduleDebugName),
+								 optimizationLevel,
+								 nullptr);
+}
+
+ModuleInstance* Runtime::instantiatePrecompiledModule(Compartment* compartment,
+													  PrecompiledModule* precompiledModule,
+													  ImportBindings&& imports,
+													  std::string&& moduleDebugName)
+{
+	return instantiateModuleImpl(compartment,
+								 getPrecompiledModuleIR(precompiledModule),
+								 std::move(imports),
+								 std::move(moduleDebugName),
+								 OptimizationLevel::basic,
+								 precompiledModule);
+}
+
 Runtime::ModuleInstance::~ModuleInstance()
 {
 	if(jitModule) { delete jitModule; }
@@ -1,3 +1,4 @@
+#include "Inline/Assert.h"
 #include "Inline/BasicTypes.h"
 #include "Inline/HashSet.h"
 #include "Inline/Lock.h"
@@ -27,13 +28,37 @@ private:
 	GCGlobals() {}
 };
 
+// The objects created by this thread within a RootNewObjectsScope, or null if the thread isn't in
+// one.
+static thread_local std::vector<ObjectImpl*>* threadNewObjectRoots = nullptr;
+
 Runtime::ObjectImpl::ObjectImpl(ObjectKind inKind) : Object(inKind), numRootReferences(0)
 {
+	// Root the object before it is visible to the garbage collector if the thread is in a
+	// RootNewObjectsScope.
+	if(threadNewObjectRoots)
+	{
+		numRootReferences = 1;
+		threadNewObjectRoots->push_back(this);
+	}
+
 	// Add the object to the global array.
 	Lock<Platform::Mutex> lock(GCGlobals::get().mutex);
 	GCGlobals::get().allObjects.add(this);
 }
 
+Runtime::RootNewObjectsScope::RootNewObjectsScope() : outerObjects(threadNewObjectRoots)
+{
+	threadNewObjectRoots = &objects;
+}
+
+Runtime::RootNewObjectsScope::~RootNewObjectsScope()
+{
+	wavmAssert(threadNewObjectRoots == &objects);
+	threadNewObjectRoots = outerObjects;
+	for(ObjectImpl* object : objects) { removeGCRoot(object); }
+}
+
 void Runtime::addGCRoot(Object* object)
 {
 	ObjectImpl* gcObject = (ObjectImpl*)object;
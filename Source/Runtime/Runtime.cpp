@@ -42,8 +42,16 @@ UntaggedValue* Runtime::invokeFunctionUnchecked(Context* context,
 {
 	FunctionType functionType = function->type;
 
-	// Get the invoke thunk for this function type.
-	auto invokeFunctionPointer = LLVMJIT::getInvokeThunk(functionType, function->callingConvention);
+	// Get the invoke thunk for this function type. The thunk is looked up once per function, and
+	// cached on the FunctionInstance so that concurrent invokes of the function don't contend on
+	// the JIT's thunk lock.
+	LLVMJIT::InvokeFunctionPointer invokeFunctionPointer
+		= function->invokeThunk.load(std::memory_order_acquire);
+	if(!invokeFunctionPointer)
+	{
+		invokeFunctionPointer = LLVMJIT::getInvokeThunk(functionType, function->callingConvention);
+		function->invokeThunk.store(invokeFunctionPointer, std::memory_order_release);
+	}
 
 	// Copy the arguments into the thunk arguments buffer in ContextRuntimeData.
 	ContextRuntimeData* contextRuntimeData
@@ -76,6 +84,72 @@ UntaggedValue* Runtime::invokeFunctionUnchecked(Context* context,
 	return (UntaggedValue*)contextRuntimeData->thunkArgAndReturnData;
 }
 
+Uptr Runtime::invokeFunctionBatch(
+	Context* context,
+	FunctionInstance* function,
+	Uptr numInvokes,
+	const UntaggedValue* arguments,
+	UntaggedValue* results,
+	const std::function<void(Uptr invokeIndex, Exception&&)>& catchThunk)
+{
+	FunctionType functionType = function->type;
+	const Uptr numParams      = functionType.params().size();
+	const Uptr numResults     = functionType.results().size();
+
+	// Get the batch invoke thunk for this function type.
+	LLVMJIT::InvokeBatchFunctionPointer invokeBatchFunctionPointer
+		= function->invokeBatchThunk.load(std::memory_order_acquire);
+	if(!invokeBatchFunctionPointer)
+	{
+		invokeBatchFunctionPointer
+			= LLVMJIT::getInvokeBatchThunk(functionType, function->callingConvention);
+		function->invokeBatchThunk.store(invokeBatchFunctionPointer, std::memory_order_release);
+	}
+
+	// Call the batch invoke thunk inside a single runtime exception catching scope. If an invoke
+	// causes a runtime exception, the thunk is unwound, so report the exception and call the thunk
+	// again to resume the batch after the invoke that caused it.
+	Uptr numExceptions = 0;
+	Uptr invokeIndex   = 0;
+	while(invokeIndex < numInvokes)
+	{
+		ContextRuntimeData* contextRuntimeData
+			= &context->compartment->runtimeData->contexts[context->id];
+		U64 batchInvokeIndex = 0;
+		catchRuntimeExceptions(
+			[&] {
+				(*invokeBatchFunctionPointer)(function->nativeFunction,
+											  contextRuntimeData,
+											  arguments + invokeIndex * numParams,
+											  results + invokeIndex * numResults,
+											  numInvokes - invokeIndex,
+											  &batchInvokeIndex);
+				batchInvokeIndex = numInvokes - invokeIndex;
+			},
+			[&](Exception&& exception) {
+				const Uptr exceptionInvokeIndex = invokeIndex + Uptr(batchInvokeIndex);
+				for(Uptr resultIndex = 0; resultIndex < numResults; ++resultIndex)
+				{ results[exceptionInvokeIndex * numResults + resultIndex] = UntaggedValue(); }
+
+				++numExceptions;
+				catchThunk(exceptionInvokeIndex, std::move(exception));
+				++batchInvokeIndex;
+			});
+		invokeIndex += Uptr(batchInvokeIndex);
+	}
+
+	return numExceptions;
+}
+
+void* Runtime::getTypedInvokeThunk(FunctionInstance* function,
+								   void* const*& outNativeFunctionPointer)
+{
+	// Return a pointer to the function's code pointer, so that calls through the thunk use the
+	// function's latest code if it is recompiled by tiered or lazy compilation.
+	outNativeFunctionPointer = &function->nativeFunction;
+	return LLVMJIT::getTypedInvokeThunk(function->type, function->callingConvention);
+}
+
 ValueTuple Runtime::invokeFunctionChecked(Context* context,
 										  FunctionInstance* function,
 										  const std::vector<Value>& arguments)
@@ -224,6 +298,7 @@ Compartment* Runtime::cloneCompartment(Compartment* compartment)
 	Compartment* newCompartment = new Compartment;
 
 	Lock<Platform::Mutex> lock(compartment->mutex);
+	newCompartment->memoryCommitPolicy = compartment->memoryCommitPolicy;
 
 	// Clone globals.
 	for(Uptr globalIndex = 0; globalIndex < compartment->globals.size(); ++globalIndex)
@@ -257,6 +332,26 @@ Compartment* Runtime::cloneCompartment(Compartment* compartment)
 	return newCompartment;
 }
 
+Object* Runtime::remapToClonedCompartment(Object* object, Compartment* newCompartment)
+{
+	Lock<Platform::Mutex> lock(newCompartment->mutex);
+	switch(object->kind)
+	{
+	case ObjectKind::function: return object;
+	case ObjectKind::table:
+		wavmAssert(asTable(object)->id < newCompartment->tables.size());
+		return newCompartment->tables[asTable(object)->id];
+	case ObjectKind::memory:
+		wavmAssert(asMemory(object)->id < newCompartment->memories.size());
+		return newCompartment->memories[asMemory(object)->id];
+	case ObjectKind::global:
+		wavmAssert(asGlobal(object)->id < newCompartment->globals.size());
+		return newCompartment->globals[asGlobal(object)->id];
+	case ObjectKind::exceptionTypeInstance: return object;
+	default: Errors::unreachable();
+	};
+}
+
 Context* Runtime::createContext(Compartment* compartment)
 {
 	wavmAssert(compartment);
@@ -7,6 +7,8 @@
 
 #include <atomic>
 #include <functional>
+#include <memory>
+#include <vector>
 
 namespace Intrinsics
 {
@@ -27,7 +29,14 @@ namespace LLVMJIT
 		virtual ~JITModuleBase() {}
 	};
 
-	void instantiateModule(const IR::Module& module, Runtime::ModuleInstance* moduleInstance);
+	void instantiateModule(const IR::Module& module,
+						   Runtime::ModuleInstance* moduleInstance,
+						   Runtime::OptimizationLevel optimizationLevel);
+
+	// Loads the object code in a precompiled module for an instance of it. Returns false if the
+	// object code can't be used for the instance.
+	bool instantiatePrecompiledModule(Runtime::ModuleInstance* moduleInstance,
+									  Runtime::PrecompiledModule* precompiledModule);
 	bool describeInstructionPointer(Uptr ip, std::string& outDescription);
 
 	typedef Runtime::ContextRuntimeData* (*InvokeFunctionPointer)(void*,
@@ -37,10 +46,39 @@ namespace LLVMJIT
 	InvokeFunctionPointer getInvokeThunk(IR::FunctionType functionType,
 										 Runtime::CallingConvention callingConvention);
 
+	typedef Runtime::ContextRuntimeData* (*InvokeBatchFunctionPointer)(
+		void*,
+		Runtime::ContextRuntimeData*,
+		const IR::UntaggedValue* arguments,
+		IR::UntaggedValue* results,
+		U64 numInvokes,
+		U64* outInvokeIndex);
+
+	// Generates a thunk that invokes a function of a specific type once for each element of an
+	// array of arguments, writing the index of each invoke to outInvokeIndex before making it.
+	InvokeBatchFunctionPointer getInvokeBatchThunk(IR::FunctionType functionType,
+												   Runtime::CallingConvention callingConvention);
+
+	// Generates a thunk with the C calling convention that calls a function of a specific type. The
+	// thunk takes a pointer to the function's code pointer, the context runtime data, and the
+	// function's arguments, and returns its result.
+	void* getTypedInvokeThunk(IR::FunctionType functionType,
+							  Runtime::CallingConvention callingConvention);
+
 	// Generates a thunk to call a native function from generated code.
-	void* getIntrinsicThunk(void* nativeFunction,
-							IR::FunctionType functionType,
-							Runtime::CallingConvention callingConvention);
+	void* getIntrinsicThunk(Runtime::FunctionInstance* function);
+
+	// Generates the thunks for a set of native functions in a single compile, so getIntrinsicThunk
+	// can return them without compiling.
+	void compileIntrinsicThunks(const std::vector<Runtime::FunctionInstance*>& functions);
+
+	// Queues a hot function defined by a module instance to be recompiled in the background at the
+	// optimized tier.
+	void requestTierUp(Runtime::FunctionInstance* function, Uptr functionDefIndex);
+
+	// Compiles a function defined by a module instance that was called through its lazy
+	// compilation stub.
+	void compileLazyFunction(Runtime::FunctionInstance* function, Uptr functionDefIndex);
 }
 
 namespace Runtime
@@ -58,6 +96,22 @@ namespace Runtime
 		virtual void finalize() {}
 	};
 
+	// Roots the objects that the calling thread creates until the scope ends. This keeps objects
+	// that aren't referenced by a rooted object yet alive if another thread collects garbage while
+	// they are being created, e.g. while a module is instantiated in the background.
+	struct RootNewObjectsScope
+	{
+		RootNewObjectsScope();
+		~RootNewObjectsScope();
+
+	private:
+		std::vector<ObjectImpl*> objects;
+		std::vector<ObjectImpl*>* outerObjects;
+
+		RootNewObjectsScope(const RootNewObjectsScope&) = delete;
+		void operator=(const RootNewObjectsScope&) = delete;
+	};
+
 	// An instance of a function: a function defined in an instantiated module, or an intrinsic
 	// function.
 	struct FunctionInstance : ObjectImpl
@@ -68,6 +122,11 @@ namespace Runtime
 		CallingConvention callingConvention;
 		std::string debugName;
 
+		// The invoke thunks for the function's type, cached by the first invoke of the function so
+		// later invokes don't need to lock the JIT's thunk maps.
+		std::atomic<LLVMJIT::InvokeFunctionPointer> invokeThunk{nullptr};
+		std::atomic<LLVMJIT::InvokeBatchFunctionPointer> invokeBatchThunk{nullptr};
+
 		FunctionInstance(ModuleInstance* inModuleInstance,
 						 FunctionType inType,
 						 void* inNativeFunction,
@@ -129,6 +188,17 @@ namespace Runtime
 		std::atomic<Uptr> numPages;
 		Uptr endOffset;
 
+		// The page file mapped to the memory's address space, or null if the platform doesn't
+		// support page files. If isPageFileShared, the memory writes to the page file. Otherwise,
+		// the memory is a copy-on-write mapping of the page file, which is shared with the memories
+		// it was cloned from or to, and only the first numPageFileDataPages pages of the file may
+		// be non-zero.
+		std::shared_ptr<Platform::PageFile> pageFile;
+		bool isPageFileShared;
+		Uptr numPageFileDataPages;
+
+		MemoryCommitPolicy commitPolicy;
+
 		MemoryInstance(Compartment* inCompartment, const MemoryType& inType)
 		: ObjectImpl(ObjectKind::memory)
 		, compartment(inCompartment)
@@ -137,6 +207,8 @@ namespace Runtime
 		, baseAddress(nullptr)
 		, numPages(0)
 		, endOffset(0)
+		, isPageFileShared(false)
+		, numPageFileDataPages(0)
 		{
 		}
 		~MemoryInstance() override;
@@ -306,6 +378,9 @@ namespace Runtime
 
 		U8 initialContextGlobalData[maxGlobalBytes];
 
+		// The commit policy of new memories in the compartment.
+		MemoryCommitPolicy memoryCommitPolicy;
+
 		ModuleInstance* wavmIntrinsics;
 
 		Compartment();
@@ -323,6 +398,12 @@ namespace Runtime
 		Compartment* compartment;
 		U8* memories[maxMemories];
 		TableInstance::FunctionElement* tables[maxTables];
+
+		// The number of pages in each memory, so generated code can read the size of a memory
+		// without calling into the runtime. Padded to keep the contexts page-aligned.
+		std::atomic<Uptr> memoryNumPages[maxMemories];
+		U8 memoryNumPagesPadding[4096 - sizeof(Uptr) * maxMemories];
+
 		ContextRuntimeData contexts[1]; // Actually [maxContexts], but at least MSVC doesn't allow
 										// declaring arrays that large.
 	};
@@ -353,7 +434,42 @@ namespace Runtime
 	// Initializes global state used by the WAVM intrinsics.
 	Runtime::ModuleInstance* instantiateWAVMIntrinsics(Compartment* compartment);
 
+	// Updates the elements of all tables that reference a function to use the function's current
+	// nativeFunction.
+	void updateTableElementsForFunction(FunctionInstance* function);
+
 	// Checks whether an address is owned by a table or memory.
 	bool isAddressOwnedByTable(U8* address);
 	bool isAddressOwnedByMemory(U8* address);
+
+	// Cancels the queued asynchronous instantiations, and waits for the running ones to complete
+	// and for the instantiation threads to exit.
+	void shutdownAsyncInstantiationThreads();
+
+	// The contents of a memory, captured so they can be restored to new memories.
+	struct MemorySnapshot
+	{
+		MemoryType type;
+		Uptr numPages;
+
+		// If the platform supports page files, the restored memories map pageFile copy-on-write,
+		// like the memories it was cloned from. Only the first numPageFileDataPages pages of the
+		// file may be non-zero.
+		std::shared_ptr<Platform::PageFile> pageFile;
+		Uptr numPageFileDataPages;
+
+		// Runs of platform pages, given by their first page index and number of pages, that are
+		// copied to the restored memories from copiedPageData. These are the pages that don't match
+		// the page file, or if there is no page file, all the memory's pages.
+		std::vector<std::pair<Uptr, Uptr>> copiedPageRuns;
+		std::vector<U8> copiedPageData;
+	};
+
+	// Captures the contents of a memory. If the platform supports it, the snapshot shares the
+	// memory's pages copy-on-write.
+	MemorySnapshot snapshotMemory(MemoryInstance* memory);
+
+	// Creates a memory in a compartment with the contents of a snapshot. May return null if the
+	// memory allocation fails.
+	MemoryInstance* restoreMemorySnapshot(const MemorySnapshot& snapshot, Compartment* compartment);
 }
@@ -6,7 +6,8 @@
 
 using namespace Runtime;
 
-// Global lists of tables; used to query whether an address is reserved by one of them.
+// Global lists of tables; used to query whether an address is reserved by one of them, and to
+// update the elements of every table that references a function when its code changes.
 static Platform::Mutex tablesMutex;
 static std::vector<TableInstance*> tables;
 
@@ -73,13 +74,34 @@ TableInstance* Runtime::createTable(Compartment* compartment, TableType type)
 
 TableInstance* Runtime::cloneTable(TableInstance* table, Compartment* newCompartment)
 {
-	Lock<Platform::Mutex> elementsLock(table->elementsMutex);
+	// Create the new table before locking the old table's elements: createTable locks tablesMutex,
+	// which updateTableElementsForFunction locks before locking the elements of each table.
 	TableInstance* newTable = createTable(newCompartment, table->type);
-	growTable(newTable, table->elements.size());
+	if(!newTable) { return nullptr; }
+
+	Lock<Platform::Mutex> elementsLock(table->elementsMutex);
+	if(growTable(newTable, table->elements.size() - newTable->elements.size()) == -1)
+	{ return nullptr; }
+
+	Lock<Platform::Mutex> newElementsLock(newTable->elementsMutex);
 	newTable->elements = table->elements;
 	memcpy(newTable->baseAddress,
 		   table->baseAddress,
 		   table->elements.size() * sizeof(TableInstance::FunctionElement));
+
+	// Re-resolve the code of WASM functions from their current nativeFunction, in case a function
+	// was tiered up after the old table's elements were last updated. The new table is already in
+	// the global list, so any later change is written to it by updateTableElementsForFunction.
+	for(Uptr elementIndex = 0; elementIndex < newTable->elements.size(); ++elementIndex)
+	{
+		Object* element = newTable->elements[elementIndex];
+		if(!element) { continue; }
+
+		FunctionInstance* function = asFunction(element);
+		if(function->callingConvention == CallingConvention::wasm)
+		{ newTable->baseAddress[elementIndex].value = function->nativeFunction; }
+	}
+
 	return newTable;
 }
 
@@ -94,6 +116,20 @@ void TableInstance::finalize()
 
 TableInstance::~TableInstance()
 {
+	// Remove the table from the global array before freeing its pages, so
+	// updateTableElementsForFunction can't write to them after they are freed.
+	{
+		Lock<Platform::Mutex> tablesLock(tablesMutex);
+		for(Uptr tableIndex = 0; tableIndex < tables.size(); ++tableIndex)
+		{
+			if(tables[tableIndex] == this)
+			{
+				tables.erase(tables.begin() + tableIndex);
+				break;
+			}
+		}
+	}
+
 	// Decommit all pages.
 	if(elements.size() > 0)
 	{
@@ -109,17 +145,21 @@ TableInstance::~TableInstance()
 		Platform::freeVirtualPages((U8*)baseAddress, (endOffset >> pageBytesLog2) + numGuardPages);
 	}
 	baseAddress = nullptr;
+}
 
-	// Remove the table from the global array.
+void Runtime::updateTableElementsForFunction(FunctionInstance* function)
+{
+	// Walk all tables, rather than just the tables in the function's compartment: tables cloned
+	// into other compartments, restored from snapshots, or held by a snapshot may also reference
+	// the function.
+	Lock<Platform::Mutex> tablesLock(tablesMutex);
+	for(TableInstance* table : tables)
 	{
-		Lock<Platform::Mutex> tablesLock(tablesMutex);
-		for(Uptr tableIndex = 0; tableIndex < tables.size(); ++tableIndex)
+		Lock<Platform::Mutex> elementsLock(table->elementsMutex);
+		for(Uptr elementIndex = 0; elementIndex < table->elements.size(); ++elementIndex)
 		{
-			if(tables[tableIndex] == this)
-			{
-				tables.erase(tables.begin() + tableIndex);
-				break;
-			}
+			if(table->elements[elementIndex] == function)
+			{ table->baseAddress[elementIndex].value = function->nativeFunction; }
 		}
 	}
 }
@@ -147,10 +187,7 @@ Object* Runtime::setTableElement(TableInstance* table, Uptr index, Object* newVa
 
 	// If the function isn't a WASM function, generate a thunk for it.
 	if(functionInstance->callingConvention != CallingConvention::wasm)
-	{
-		nativeFunction = LLVMJIT::getIntrinsicThunk(
-			nativeFunction, functionInstance->type, functionInstance->callingConvention);
-	}
+	{ nativeFunction = LLVMJIT::getIntrinsicThunk(functionInstance); }
 
 	// Lock the table's elements array.
 	Lock<Platform::Mutex> elementsLock(table->elementsMutex);
@@ -0,0 +1,18 @@
+#!/bin/sh
+
+# Measures the run time of the floating-point min, max, and rounding operators.
+# Usage: float-ops.sh path/to/wavm [iterations]
+
+set -e
+
+WAVM=${1:-wavm}
+ITERATIONS=${2:-100000000}
+BENCHMARK_DIR=$(cd "$(dirname "$0")" && pwd)
+
+for FUNCTION in f32_min_max f64_min_max f32_rounding f64_rounding; do
+	OUTPUT=$("$WAVM" --metrics --disable-emscripten "$BENCHMARK_DIR/float-ops.wast" \
+		-f $FUNCTION $ITERATIONS)
+	RUN_MS=$(echo "$OUTPUT" | sed -n 's/^Invoked function in \([0-9.]*\)ms.*/\1/p')
+	NS_PER_ITERATION=$(echo "$RUN_MS $ITERATIONS" | awk '{printf "%.2f", $1 * 1000000 / $2}')
+	printf "%-14s %10sms  %6sns/iteration\n" $FUNCTION $RUN_MS $NS_PER_ITERATION
+done
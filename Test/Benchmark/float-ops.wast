@@ -0,0 +1,65 @@
+;; Microbenchmarks for the floating-point min, max, and rounding operators.
+;; Each function takes an iteration count, and returns an accumulated value that depends on the result
+;; of every operation so that none of them can be optimized away.
+
+(module
+  (func (export "f32_min_max") (param $n i32) (result f32)
+    (local $i i32) (local $x f32) (local $acc f32)
+    (loop $loop
+      (set_local $x (f32.mul (f32.convert_s/i32 (get_local $i)) (f32.const 0.37)))
+      (set_local $acc
+        (f32.max
+          (f32.min (f32.add (get_local $acc) (get_local $x)) (f32.mul (get_local $x) (f32.const 2)))
+          (f32.neg (get_local $x))))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $loop (i32.lt_u (get_local $i) (get_local $n)))
+    )
+    (get_local $acc)
+  )
+
+  (func (export "f64_min_max") (param $n i32) (result f64)
+    (local $i i32) (local $x f64) (local $acc f64)
+    (loop $loop
+      (set_local $x (f64.mul (f64.convert_s/i32 (get_local $i)) (f64.const 0.37)))
+      (set_local $acc
+        (f64.max
+          (f64.min (f64.add (get_local $acc) (get_local $x)) (f64.mul (get_local $x) (f64.const 2)))
+          (f64.neg (get_local $x))))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $loop (i32.lt_u (get_local $i) (get_local $n)))
+    )
+    (get_local $acc)
+  )
+
+  (func (export "f32_rounding") (param $n i32) (result f32)
+    (local $i i32) (local $x f32) (local $acc f32)
+    (loop $loop
+      (set_local $x (f32.mul (f32.convert_s/i32 (get_local $i)) (f32.const -0.37)))
+      (set_local $acc
+        (f32.add
+          (get_local $acc)
+          (f32.add
+            (f32.add (f32.ceil (get_local $x)) (f32.floor (get_local $x)))
+            (f32.add (f32.trunc (get_local $x)) (f32.nearest (get_local $x))))))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $loop (i32.lt_u (get_local $i) (get_local $n)))
+    )
+    (get_local $acc)
+  )
+
+  (func (export "f64_rounding") (param $n i32) (result f64)
+    (local $i i32) (local $x f64) (local $acc f64)
+    (loop $loop
+      (set_local $x (f64.mul (f64.convert_s/i32 (get_local $i)) (f64.const -0.37)))
+      (set_local $acc
+        (f64.add
+          (get_local $acc)
+          (f64.add
+            (f64.add (f64.ceil (get_local $x)) (f64.floor (get_local $x)))
+            (f64.add (f64.trunc (get_local $x)) (f64.nearest (get_local $x))))))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $loop (i32.lt_u (get_local $i) (get_local $n)))
+    )
+    (get_local $acc)
+  )
+)
@@ -0,0 +1,24 @@
+#!/bin/sh
+
+# Compares the run time of the zlib and Blake2b tests with and without relaxed memory traps.
+# Usage: memory-traps.sh path/to/wavm
+
+set -e
+
+WAVM=${1:-wavm}
+TEST_DIR=$(cd "$(dirname "$0")/.." && pwd)
+
+run_benchmark()
+{
+	NAME=$1
+	shift
+	for MODE in precise relaxed; do
+		if [ $MODE = relaxed ]; then FLAGS=--relaxed-memory-traps; else FLAGS=; fi
+		OUTPUT=$("$WAVM" --metrics $FLAGS "$@")
+		RUN_MS=$(echo "$OUTPUT" | sed -n 's/^Invoked function in \([0-9.]*\)ms.*/\1/p')
+		printf "%-8s %-8s run %10sms\n" $NAME $MODE $RUN_MS
+	done
+}
+
+run_benchmark zlib "$TEST_DIR/zlib/zlib.wast"
+run_benchmark blake2b --enable-thread-test "$TEST_DIR/Blake2b/blake2b.wast"
@@ -0,0 +1,24 @@
+#!/bin/sh
+
+# Compares the compile time and run time of the zlib and Blake2b tests at each optimization level.
+# Usage: opt-levels.sh path/to/wavm
+
+set -e
+
+WAVM=${1:-wavm}
+TEST_DIR=$(cd "$(dirname "$0")/.." && pwd)
+
+run_benchmark()
+{
+	NAME=$1
+	shift
+	for OPT_LEVEL in none basic full; do
+		OUTPUT=$("$WAVM" --metrics --opt-level $OPT_LEVEL "$@")
+		COMPILE_MS=$(echo "$OUTPUT" | sed -n 's/^Compiled module in \([0-9.]*\)ms.*/\1/p')
+		RUN_MS=$(echo "$OUTPUT" | sed -n 's/^Invoked function in \([0-9.]*\)ms.*/\1/p')
+		printf "%-8s %-6s compile %10sms  run %10sms\n" $NAME $OPT_LEVEL $COMPILE_MS $RUN_MS
+	done
+}
+
+run_benchmark zlib "$TEST_DIR/zlib/zlib.wast"
+run_benchmark blake2b --enable-thread-test "$TEST_DIR/Blake2b/blake2b.wast"
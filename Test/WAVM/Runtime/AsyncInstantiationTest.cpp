@@ -0,0 +1,151 @@
+#include "IR/Module.h"
+#include "Inline/Assert.h"
+#include "Inline/BasicTypes.h"
+#include "Inline/Timing.h"
+#include "Logging/Logging.h"
+#include "Platform/Platform.h"
+#include "Runtime/Runtime.h"
+#include "WAST/WAST.h"
+
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+using namespace IR;
+using namespace Runtime;
+
+static const char testModuleWAST[]
+	= "(module\n"
+	  "  (memory 1)\n"
+	  "  (data (i32.const 16) \"\\2a\")\n"
+	  "  (table anyfunc (elem $getData))\n"
+	  "  (global $counter (mut i32) (i32.const 100))\n"
+	  "  (func $getData (result i32) (i32.load8_u (i32.const 16)))\n"
+	  "  (func (export \"run\") (result i32)\n"
+	  "    (set_global $counter (i32.add (get_global $counter) (i32.const 1)))\n"
+	  "    (i32.add (get_global $counter) (call_indirect (result i32) (i32.const 0)))\n"
+	  "  )\n"
+	  ")\n";
+
+enum
+{
+	testThreadNumStackBytes = 1 * 1024 * 1024,
+	numInstantiations       = 16
+};
+
+static void parseTestModule(Module& module)
+{
+	std::vector<WAST::Error> parseErrors;
+	errorUnless(WAST::parseModule(testModuleWAST, strlen(testModuleWAST), module, parseErrors));
+}
+
+static I64 collectGarbageThreadEntry(void* isDoneVoid)
+{
+	std::atomic<bool>* isDone = (std::atomic<bool>*)isDoneVoid;
+	Uptr numCollections       = 0;
+	while(!isDone->load(std::memory_order_acquire))
+	{
+		collectGarbage();
+		++numCollections;
+	}
+	return numCollections;
+}
+
+static void testInstantiationDuringGarbageCollection()
+{
+	Module module;
+	parseTestModule(module);
+
+	// Instantiate the module on several threads, with a compile memory budget that only allows
+	// one instantiation at a time, while another thread continually collects garbage. Nothing
+	// roots the compartment except the instantiations.
+	setMaxAsyncInstantiationThreads(4);
+	setMaxAsyncCompileCodeBytes(1);
+
+	Compartment* compartment = createCompartment();
+	std::vector<AsyncInstantiation*> instantiations;
+	for(Uptr instantiationIndex = 0; instantiationIndex < numInstantiations; ++instantiationIndex)
+	{
+		instantiations.push_back(instantiateModuleAsync(compartment,
+														module,
+														ImportBindings{},
+														"AsyncInstantiationTest",
+														OptimizationLevel::basic,
+														[](ModuleInstance* moduleInstance) {
+															errorUnless(moduleInstance);
+														}));
+	}
+
+	std::atomic<bool> isGCDone{false};
+	Platform::Thread* gcThread
+		= Platform::createThread(testThreadNumStackBytes, collectGarbageThreadEntry, &isGCDone);
+
+	std::vector<ModuleInstance*> moduleInstances;
+	for(AsyncInstantiation* instantiation : instantiations)
+	{
+		ModuleInstance* moduleInstance = waitForInstantiation(instantiation);
+		errorUnless(moduleInstance);
+		moduleInstances.push_back(moduleInstance);
+	}
+
+	isGCDone.store(true, std::memory_order_release);
+	Platform::joinThread(gcThread);
+
+	// Each instance's memory, table, and global must have survived the collections.
+	Context* context = createContext(compartment);
+	for(ModuleInstance* moduleInstance : moduleInstances)
+	{
+		FunctionInstance* run = asFunctionNullable(getInstanceExport(moduleInstance, "run"));
+		errorUnless(run);
+		errorUnless(invokeFunctionChecked(context, run, {})[0].i32 == 101 + 42);
+		errorUnless(invokeFunctionChecked(context, run, {})[0].i32 == 102 + 42);
+	}
+
+	for(AsyncInstantiation* instantiation : instantiations)
+	{ deleteAsyncInstantiation(instantiation); }
+	collectGarbage();
+
+	setMaxAsyncCompileCodeBytes(0);
+	setMaxAsyncInstantiationThreads(1);
+}
+
+static void testCancelledInstantiations()
+{
+	Module module;
+	parseTestModule(module);
+
+	// Cancelling an instantiation discards its module instance, whether or not it has started.
+	GCPointer<Compartment> compartment = createCompartment();
+	std::vector<AsyncInstantiation*> instantiations;
+	for(Uptr instantiationIndex = 0; instantiationIndex < numInstantiations; ++instantiationIndex)
+	{
+		instantiations.push_back(instantiateModuleAsync(compartment,
+														module,
+														ImportBindings{},
+														"AsyncInstantiationTest",
+														OptimizationLevel::basic,
+														[](ModuleInstance* moduleInstance) {
+															errorUnless(!moduleInstance);
+														}));
+	}
+	for(AsyncInstantiation* instantiation : instantiations) { cancelInstantiation(instantiation); }
+
+	for(AsyncInstantiation* instantiation : instantiations)
+	{
+		errorUnless(!waitForInstantiation(instantiation));
+		errorUnless(isInstantiationComplete(instantiation));
+		deleteAsyncInstantiation(instantiation);
+	}
+
+	compartment = nullptr;
+	collectGarbage();
+}
+
+I32 main()
+{
+	Timing::Timer timer;
+	testInstantiationDuringGarbageCollection();
+	testCancelledInstantiations();
+	Timing::logTimer("AsyncInstantiationTest", timer);
+	return 0;
+}
@@ -0,0 +1,198 @@
+#include "IR/Module.h"
+#include "Inline/Assert.h"
+#include "Inline/BasicTypes.h"
+#include "Inline/Timing.h"
+#include "Logging/Logging.h"
+#include "Runtime/Runtime.h"
+#include "WAST/WAST.h"
+
+#include <string.h>
+#include <vector>
+
+using namespace IR;
+using namespace Runtime;
+
+static const char testModuleWAST[]
+	= "(module\n"
+	  "  (memory (export \"memory\") 1)\n"
+	  "  (data (i32.const 16) \"\\2a\")\n"
+	  "  (table (export \"table\") 2 anyfunc)\n"
+	  "  (elem (i32.const 0) $getOne)\n"
+	  "  (global (export \"counter\") (mut i32) (i32.const 100))\n"
+	  "  (func $getOne (export \"getOne\") (result i32) (i32.const 1))\n"
+	  "  (func $getTwo (export \"getTwo\") (result i32) (i32.const 2))\n"
+	  "  (func (export \"increment\") (result i32)\n"
+	  "    (set_global 0 (i32.add (get_global 0) (i32.const 1)))\n"
+	  "    (get_global 0)\n"
+	  "  )\n"
+	  "  (func (export \"load\") (param i32) (result i32) (i32.load8_u (get_local 0)))\n"
+	  "  (func (export \"store\") (param i32 i32) (i32.store8 (get_local 0) (get_local 1)))\n"
+	  "  (func (export \"callIndirect\") (param i32) (result i32)\n"
+	  "    (call_indirect (result i32) (get_local 0))\n"
+	  "  )\n"
+	  ")\n";
+
+// The exports of an instance of the test module. Compartments don't keep their memories, tables,
+// and globals alive, so the exports root them.
+struct TestExports
+{
+	GCPointer<MemoryInstance> memory;
+	GCPointer<TableInstance> table;
+	GCPointer<GlobalInstance> counter;
+	FunctionInstance* getOne;
+	FunctionInstance* getTwo;
+	FunctionInstance* increment;
+	FunctionInstance* load;
+	FunctionInstance* store;
+	FunctionInstance* callIndirect;
+};
+
+static TestExports getTestExports(ModuleInstance* moduleInstance)
+{
+	TestExports exports;
+	exports.memory       = asMemoryNullable(getInstanceExport(moduleInstance, "memory"));
+	exports.table        = asTableNullable(getInstanceExport(moduleInstance, "table"));
+	exports.counter      = asGlobalNullable(getInstanceExport(moduleInstance, "counter"));
+	exports.getOne       = asFunctionNullable(getInstanceExport(moduleInstance, "getOne"));
+	exports.getTwo       = asFunctionNullable(getInstanceExport(moduleInstance, "getTwo"));
+	exports.increment    = asFunctionNullable(getInstanceExport(moduleInstance, "increment"));
+	exports.load         = asFunctionNullable(getInstanceExport(moduleInstance, "load"));
+	exports.store        = asFunctionNullable(getInstanceExport(moduleInstance, "store"));
+	exports.callIndirect = asFunctionNullable(getInstanceExport(moduleInstance, "callIndirect"));
+	errorUnless(exports.memory && exports.table && exports.counter);
+	errorUnless(exports.getOne && exports.getTwo && exports.increment);
+	errorUnless(exports.load && exports.store && exports.callIndirect);
+	return exports;
+}
+
+// Maps the memory, table, and global exports to a clone of their compartment. The functions are
+// shared between compartments, and access the objects of the compartment they are invoked in.
+static TestExports remapTestExports(const TestExports& exports, Compartment* newCompartment)
+{
+	TestExports newExports = exports;
+	newExports.memory
+		= asMemory(remapToClonedCompartment(asObject(exports.memory), newCompartment));
+	newExports.table = asTable(remapToClonedCompartment(asObject(exports.table), newCompartment));
+	newExports.counter
+		= asGlobal(remapToClonedCompartment(asObject(exports.counter), newCompartment));
+	errorUnless(newExports.memory != exports.memory);
+	errorUnless(newExports.table != exports.table);
+	errorUnless(newExports.counter != exports.counter);
+	return newExports;
+}
+
+static I32 invokeI32(Context* context, FunctionInstance* function, std::vector<Value> args)
+{
+	const ValueTuple results = invokeFunctionChecked(context, function, args);
+	errorUnless(results.size() == 1 && results[0].type == ValueType::i32);
+	return results[0].i32;
+}
+
+static void store(Context* context, const TestExports& exports, I32 address, I32 value)
+{ invokeFunctionChecked(context, exports.store, {address, value}); }
+
+// Checks that a compartment has the state it had when it was snapshotted.
+static void checkSnapshottedState(Context* context, const TestExports& exports)
+{
+	errorUnless(getMemoryNumPages(exports.memory) == 1);
+	errorUnless(getMemoryBaseAddress(exports.memory)[16] == 42);
+	errorUnless(getMemoryBaseAddress(exports.memory)[100] == 7);
+	errorUnless(invokeI32(context, exports.load, {I32(100)}) == 7);
+
+	errorUnless(getTableElement(exports.table, 0) == asObject(exports.getOne));
+	errorUnless(getTableElement(exports.table, 1) == asObject(exports.getTwo));
+	errorUnless(invokeI32(context, exports.callIndirect, {I32(0)}) == 1);
+	errorUnless(invokeI32(context, exports.callIndirect, {I32(1)}) == 2);
+
+	errorUnless(getGlobalValue(context, exports.counter).i32 == 101);
+}
+
+static void testSnapshotRestore(bool useHugePages)
+{
+	Module module;
+	std::vector<WAST::Error> parseErrors;
+	errorUnless(WAST::parseModule(testModuleWAST, strlen(testModuleWAST), module, parseErrors));
+
+	GCPointer<Compartment> compartment = createCompartment();
+	ModuleInstance* moduleInstance
+		= instantiateModule(compartment, module, ImportBindings{}, "CompartmentSnapshotTest");
+	errorUnless(moduleInstance);
+	GCPointer<ModuleInstance> moduleInstanceRoot = moduleInstance;
+	const TestExports exports                    = getTestExports(moduleInstance);
+	GCPointer<Context> context                   = createContext(compartment);
+
+	// If the test uses huge pages, set the policy after instantiating the module, so the snapshot
+	// shares the memory's pages copy-on-write, but the restored memories use huge pages.
+	if(useHugePages)
+	{
+		MemoryCommitPolicy hugePagePolicy;
+		hugePagePolicy.useHugePages = true;
+		setMemoryCommitPolicy(compartment, hugePagePolicy);
+	}
+
+	// Change the memory, table, and mutable global, and snapshot the compartment.
+	store(context, exports, 100, 7);
+	errorUnless(invokeI32(context, exports.increment, {}) == 101);
+	setTableElement(exports.table, 1, asObject(exports.getTwo));
+	checkSnapshottedState(context, exports);
+	CompartmentSnapshot* snapshot = snapshotCompartment(context);
+
+	// Change the snapshotted compartment after taking the snapshot.
+	store(context, exports, 16, 9);
+	store(context, exports, 100, 8);
+	errorUnless(growMemory(exports.memory, 1) == 1);
+	errorUnless(invokeI32(context, exports.increment, {}) == 102);
+	setTableElement(exports.table, 0, asObject(exports.getTwo));
+
+	// Restore the snapshot twice. Both restored compartments must have the snapshotted state.
+	GCPointer<Context> restoredContextA = restoreCompartmentSnapshot(snapshot);
+	GCPointer<Context> restoredContextB = restoreCompartmentSnapshot(snapshot);
+	errorUnless(restoredContextA && restoredContextB);
+	const TestExports restoredExportsA
+		= remapTestExports(exports, getCompartmentFromContext(restoredContextA));
+	const TestExports restoredExportsB
+		= remapTestExports(exports, getCompartmentFromContext(restoredContextB));
+	checkSnapshottedState(restoredContextA, restoredExportsA);
+	checkSnapshottedState(restoredContextB, restoredExportsB);
+
+	// Change the first restored compartment. The second restored compartment, the snapshotted
+	// compartment, and compartments restored from the snapshot after this must not change.
+	store(restoredContextA, restoredExportsA, 100, 11);
+	errorUnless(growMemory(restoredExportsA.memory, 2) == 1);
+	errorUnless(invokeI32(restoredContextA, restoredExportsA.increment, {}) == 102);
+	setGlobalValue(restoredContextA, restoredExportsA.counter, Value(I32(200)));
+	setTableElement(restoredExportsA.table, 1, asObject(exports.getOne));
+	errorUnless(invokeI32(restoredContextA, restoredExportsA.load, {I32(100)}) == 11);
+	errorUnless(invokeI32(restoredContextA, restoredExportsA.callIndirect, {I32(1)}) == 1);
+	errorUnless(getGlobalValue(restoredContextA, restoredExportsA.counter).i32 == 200);
+
+	checkSnapshottedState(restoredContextB, restoredExportsB);
+
+	errorUnless(getMemoryNumPages(exports.memory) == 2);
+	errorUnless(invokeI32(context, exports.load, {I32(16)}) == 9);
+	errorUnless(invokeI32(context, exports.load, {I32(100)}) == 8);
+	errorUnless(invokeI32(context, exports.callIndirect, {I32(0)}) == 2);
+	errorUnless(getGlobalValue(context, exports.counter).i32 == 102);
+
+	GCPointer<Context> restoredContextC = restoreCompartmentSnapshot(snapshot);
+	errorUnless(restoredContextC);
+	checkSnapshottedState(restoredContextC,
+						  remapTestExports(exports, getCompartmentFromContext(restoredContextC)));
+
+	// Deleting the snapshot must not change the compartments restored from it.
+	deleteCompartmentSnapshot(snapshot);
+	collectGarbage();
+	checkSnapshottedState(restoredContextB, restoredExportsB);
+}
+
+I32 main()
+{
+	Timing::Timer timer;
+	// The test roots its objects in local variables, so collect them after it returns.
+	testSnapshotRestore(false);
+	collectGarbage();
+	testSnapshotRestore(true);
+	collectGarbage();
+	Timing::logTimer("CompartmentSnapshotTest", timer);
+	return 0;
+}
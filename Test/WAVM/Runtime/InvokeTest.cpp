@@ -0,0 +1,311 @@
+#include "IR/Module.h"
+#include "Inline/Assert.h"
+#include "Inline/BasicTypes.h"
+#include "Inline/Timing.h"
+#include "Logging/Logging.h"
+#include "Platform/Platform.h"
+#include "Runtime/Runtime.h"
+#include "WAST/WAST.h"
+
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+using namespace IR;
+using namespace Runtime;
+
+static const char testModuleWAST[]
+	= "(module\n"
+	  "  (func (export \"increment\") (param i32) (result i32)\n"
+	  "    (i32.add (get_local 0) (i32.const 1))\n"
+	  "  )\n"
+	  "  (func (export \"addF64\") (param f64 f64) (result f64)\n"
+	  "    (f64.add (get_local 0) (get_local 1))\n"
+	  "  )\n"
+	  "  (func (export \"divide\") (param i32 i32) (result i32)\n"
+	  "    (i32.div_s (get_local 0) (get_local 1))\n"
+	  "  )\n"
+	  "  (global $counter (mut i32) (i32.const 0))\n"
+	  "  (func (export \"incrementCounter\")\n"
+	  "    (set_global $counter (i32.add (get_global $counter) (i32.const 1)))\n"
+	  "  )\n"
+	  "  (func (export \"getCounter\") (result i32) (get_global $counter))\n"
+	  "  (func (export \"sum\") (param $n i32) (result i32)\n"
+	  "    (local $total i32)\n"
+	  "    (block $done\n"
+	  "      (loop $continue\n"
+	  "        (br_if $done (i32.eqz (get_local $n)))\n"
+	  "        (set_local $total (i32.add (get_local $total) (get_local $n)))\n"
+	  "        (set_local $n (i32.sub (get_local $n) (i32.const 1)))\n"
+	  "        (br $continue)\n"
+	  "      )\n"
+	  "    )\n"
+	  "    (get_local $total)\n"
+	  "  )\n"
+	  ")\n";
+
+static ModuleInstance* instantiateTestModule(Compartment* compartment)
+{
+	Module module;
+	std::vector<WAST::Error> parseErrors;
+	errorUnless(WAST::parseModule(testModuleWAST, strlen(testModuleWAST), module, parseErrors));
+
+	ModuleInstance* moduleInstance
+		= instantiateModule(compartment, module, ImportBindings{}, "InvokeTest");
+	errorUnless(moduleInstance);
+	return moduleInstance;
+}
+
+static FunctionInstance* getTestFunction(ModuleInstance* moduleInstance, const char* name)
+{
+	FunctionInstance* function = asFunctionNullable(getInstanceExport(moduleInstance, name));
+	errorUnless(function);
+	return function;
+}
+
+enum
+{
+	testThreadNumStackBytes = 1 * 1024 * 1024,
+	numTestThreads          = 8,
+	numInvokesPerThread     = 10000
+};
+
+struct UncheckedInvokeThreadArgs
+{
+	Context* context;
+	FunctionInstance* increment;
+	FunctionInstance* addF64;
+	std::atomic<bool>* startFlag;
+};
+
+static I64 uncheckedInvokeThreadEntry(void* argsVoid)
+{
+	UncheckedInvokeThreadArgs* args = (UncheckedInvokeThreadArgs*)argsVoid;
+	while(!args->startFlag->load(std::memory_order_acquire)) {};
+
+	// Alternate between functions of different types, so the threads race to look up and cache
+	// each function's invoke thunk, and check every result.
+	I32 count = 0;
+	F64 sum   = 0.0;
+	for(Uptr invokeIndex = 0; invokeIndex < numInvokesPerThread; ++invokeIndex)
+	{
+		UntaggedValue incrementArgument;
+		incrementArgument.i32 = count;
+		const I32 newCount
+			= invokeFunctionUnchecked(args->context, args->increment, &incrementArgument)->i32;
+		errorUnless(newCount == count + 1);
+		count = newCount;
+
+		UntaggedValue addArguments[2];
+		addArguments[0].f64 = sum;
+		addArguments[1].f64 = 0.5;
+		const F64 newSum = invokeFunctionUnchecked(args->context, args->addF64, addArguments)->f64;
+		errorUnless(newSum == sum + 0.5);
+		sum = newSum;
+	}
+
+	return count;
+}
+
+static void testConcurrentUncheckedInvokes()
+{
+	GCPointer<Compartment> compartment = createCompartment();
+	ModuleInstance* moduleInstance     = instantiateTestModule(compartment);
+
+	std::atomic<bool> startFlag{false};
+	std::vector<UncheckedInvokeThreadArgs> threadArgs(numTestThreads);
+	for(UncheckedInvokeThreadArgs& args : threadArgs)
+	{
+		args.context   = createContext(compartment);
+		args.increment = getTestFunction(moduleInstance, "increment");
+		args.addF64    = getTestFunction(moduleInstance, "addF64");
+		args.startFlag = &startFlag;
+	}
+
+	std::vector<Platform::Thread*> threads;
+	for(UncheckedInvokeThreadArgs& args : threadArgs)
+	{
+		threads.push_back(
+			Platform::createThread(testThreadNumStackBytes, uncheckedInvokeThreadEntry, &args));
+	}
+
+	startFlag.store(true, std::memory_order_release);
+	for(Platform::Thread* thread : threads)
+	{ errorUnless(Platform::joinThread(thread) == numInvokesPerThread); }
+
+	compartment = nullptr;
+	collectGarbage();
+}
+
+static void testBatchedInvokes()
+{
+	enum
+	{
+		numBatchInvokes = 1000
+	};
+
+	GCPointer<Compartment> compartment = createCompartment();
+	ModuleInstance* moduleInstance     = instantiateTestModule(compartment);
+	Context* context                   = createContext(compartment);
+	FunctionInstance* divide           = getTestFunction(moduleInstance, "divide");
+
+	// Divide by zero in the first invoke, the last invoke, and every 7th invoke in between, to
+	// check that each trap is reported with the index of the invoke that caused it, and that the
+	// batch resumes with the next invoke.
+	auto isTrappingInvoke = [](Uptr invokeIndex) {
+		return invokeIndex == 0 || invokeIndex == numBatchInvokes - 1 || invokeIndex % 7 == 3;
+	};
+
+	std::vector<UntaggedValue> arguments(numBatchInvokes * 2);
+	std::vector<UntaggedValue> results(numBatchInvokes);
+	Uptr numExpectedTraps = 0;
+	for(Uptr invokeIndex = 0; invokeIndex < numBatchInvokes; ++invokeIndex)
+	{
+		arguments[invokeIndex * 2 + 0].i32 = I32(invokeIndex * 6);
+		arguments[invokeIndex * 2 + 1].i32 = isTrappingInvoke(invokeIndex) ? 0 : 3;
+		results[invokeIndex].i32           = -1;
+		if(isTrappingInvoke(invokeIndex)) { ++numExpectedTraps; }
+	}
+
+	std::vector<Uptr> trapInvokeIndices;
+	const Uptr numTraps = invokeFunctionBatch(
+		context,
+		divide,
+		numBatchInvokes,
+		arguments.data(),
+		results.data(),
+		[&](Uptr invokeIndex, Exception&& exception) {
+			errorUnless(exception.typeInstance == Exception::integerDivideByZeroOrOverflowType);
+			trapInvokeIndices.push_back(invokeIndex);
+		});
+
+	errorUnless(numTraps == numExpectedTraps);
+	errorUnless(trapInvokeIndices.size() == numExpectedTraps);
+	Uptr trapIndex = 0;
+	for(Uptr invokeIndex = 0; invokeIndex < numBatchInvokes; ++invokeIndex)
+	{
+		if(isTrappingInvoke(invokeIndex))
+		{
+			errorUnless(trapInvokeIndices[trapIndex++] == invokeIndex);
+			errorUnless(results[invokeIndex].i32 == 0);
+		}
+		else
+		{
+			errorUnless(results[invokeIndex].i32 == I32(invokeIndex * 2));
+		}
+	}
+
+	// An empty batch doesn't invoke the function.
+	errorUnless(invokeFunctionBatch(context,
+									divide,
+									0,
+									nullptr,
+									nullptr,
+									[](Uptr, Exception&&) { Errors::unreachable(); })
+				== 0);
+
+	compartment = nullptr;
+	collectGarbage();
+}
+
+template<typename Signature>
+static bool isTypedFunctionSignatureMismatch(FunctionInstance* function)
+{
+	bool threwMismatch = false;
+	catchRuntimeExceptions([&] { TypedFunction<Signature> typedFunction(function); },
+						   [&](Exception&& exception) {
+							   errorUnless(exception.typeInstance
+										   == Exception::invokeSignatureMismatchType);
+							   threwMismatch = true;
+						   });
+	return threwMismatch;
+}
+
+static void testTypedFunctionSignatures()
+{
+	GCPointer<Compartment> compartment = createCompartment();
+	ModuleInstance* moduleInstance     = instantiateTestModule(compartment);
+	Context* context                   = createContext(compartment);
+	FunctionInstance* increment        = getTestFunction(moduleInstance, "increment");
+	FunctionInstance* addF64           = getTestFunction(moduleInstance, "addF64");
+	FunctionInstance* incrementCounter = getTestFunction(moduleInstance, "incrementCounter");
+	FunctionInstance* getCounter       = getTestFunction(moduleInstance, "getCounter");
+
+	// Binding to a signature that doesn't exactly match the function's type throws.
+	errorUnless(isTypedFunctionSignatureMismatch<I32(I64)>(increment));
+	errorUnless(isTypedFunctionSignatureMismatch<I64(I32)>(increment));
+	errorUnless(isTypedFunctionSignatureMismatch<void(I32)>(increment));
+	errorUnless(isTypedFunctionSignatureMismatch<I32(I32, I32)>(increment));
+	errorUnless(isTypedFunctionSignatureMismatch<I32()>(increment));
+	errorUnless(isTypedFunctionSignatureMismatch<F64(F64, F32)>(addF64));
+	errorUnless(isTypedFunctionSignatureMismatch<F32(F64, F64)>(addF64));
+	errorUnless(isTypedFunctionSignatureMismatch<I32()>(incrementCounter));
+	errorUnless(isTypedFunctionSignatureMismatch<void()>(getCounter));
+	errorUnless(!isTypedFunctionSignatureMismatch<I32(I32)>(increment));
+	errorUnless(!isTypedFunctionSignatureMismatch<F64(F64, F64)>(addF64));
+	errorUnless(!isTypedFunctionSignatureMismatch<void()>(incrementCounter));
+	errorUnless(!isTypedFunctionSignatureMismatch<I32()>(getCounter));
+
+	// Call functions with i32, f64, and no results through TypedFunctions.
+	TypedFunction<I32(I32)> typedIncrement(increment);
+	errorUnless(typedIncrement(context, 41) == 42);
+	errorUnless(typedIncrement(context, -1) == 0);
+
+	TypedFunction<F64(F64, F64)> typedAddF64(addF64);
+	errorUnless(typedAddF64(context, 1.25, 2.5) == 3.75);
+
+	TypedFunction<void()> typedIncrementCounter(incrementCounter);
+	TypedFunction<I32()> typedGetCounter(getCounter);
+	for(Uptr callIndex = 0; callIndex < 3; ++callIndex) { typedIncrementCounter(context); }
+	errorUnless(typedGetCounter(context) == 3);
+
+	compartment = nullptr;
+	collectGarbage();
+}
+
+static void testTypedFunctionRecompilation(bool lazy)
+{
+	setLazyCompilation(lazy);
+	setTieredCompilation(true);
+
+	GCPointer<Compartment> compartment = createCompartment();
+	ModuleInstance* moduleInstance     = instantiateTestModule(compartment);
+	Context* context                   = createContext(compartment);
+	FunctionInstance* sum              = getTestFunction(moduleInstance, "sum");
+
+	// Bind the TypedFunction before the function is compiled lazily or tiered up, and remember the
+	// code it calls.
+	TypedFunction<I32(I32)> typedSum(sum);
+	void* const* nativeFunctionPointer = nullptr;
+	getTypedInvokeThunk(sum, nativeFunctionPointer);
+	void* const initialNativeFunction = *nativeFunctionPointer;
+
+	// The first call compiles the function if it's lazy, and loops enough to queue the function to
+	// be recompiled at the optimized tier.
+	const Uptr numTieredUpFunctions = getNumTieredUpFunctions();
+	errorUnless(typedSum(context, 100000) == I32(U32(100000) * U32(100001) / 2));
+	waitForTierUp();
+	errorUnless(getNumTieredUpFunctions() > numTieredUpFunctions);
+
+	// Calls through the TypedFunction use the optimized code.
+	errorUnless(*nativeFunctionPointer != initialNativeFunction);
+	errorUnless(typedSum(context, 100) == 5050);
+
+	compartment = nullptr;
+	collectGarbage();
+
+	setTieredCompilation(false);
+	setLazyCompilation(false);
+}
+
+I32 main()
+{
+	Timing::Timer timer;
+	testConcurrentUncheckedInvokes();
+	testBatchedInvokes();
+	testTypedFunctionSignatures();
+	testTypedFunctionRecompilation(false);
+	testTypedFunctionRecompilation(true);
+	Timing::logTimer("InvokeTest", timer);
+	return 0;
+}
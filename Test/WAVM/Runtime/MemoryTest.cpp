@@ -0,0 +1,421 @@
+#include "IR/Module.h"
+#include "IR/Types.h"
+#include "Inline/Assert.h"
+#include "Inline/BasicTypes.h"
+#include "Inline/Timing.h"
+#include "Logging/Logging.h"
+#include "Runtime/Runtime.h"
+#include "WAST/WAST.h"
+
+#include <string.h>
+#include <vector>
+
+using namespace IR;
+using namespace Runtime;
+
+enum
+{
+	numTestMemories                 = 4,
+	defaultMaxMemoryImageCacheBytes = 256 * 1024 * 1024
+};
+
+static const MemoryType testMemoryType(false, SizeConstraints{1, 65536});
+
+// Returns true if all the bytes in a range of a memory are zero.
+static bool isMemoryZero(MemoryInstance* memory, Uptr offset, Uptr numBytes)
+{
+	const U8* baseAddress = getMemoryBaseAddress(memory);
+	for(Uptr byteIndex = offset; byteIndex < offset + numBytes; ++byteIndex)
+	{
+		if(baseAddress[byteIndex]) { return false; }
+	}
+	return true;
+}
+
+static void testPooledReservationReuse()
+{
+	// Empty the pool, and allow it to hold a single reservation.
+	setMaxPooledMemoryReservations(0);
+	setMaxPooledMemoryReservations(1);
+
+	// Create a memory, write to its pages, and free it.
+	GCPointer<Compartment> compartment = createCompartment();
+	MemoryInstance* memory             = createMemory(compartment, testMemoryType);
+	errorUnless(memory);
+	errorUnless(growMemory(memory, 2) == 1);
+
+	U8* freedBaseAddress                             = getMemoryBaseAddress(memory);
+	freedBaseAddress[0]                              = 1;
+	freedBaseAddress[IR::numBytesPerPage - 1]        = 2;
+	freedBaseAddress[2 * IR::numBytesPerPage + 1000] = 3;
+
+	const MemoryReservationPoolStats statsBeforeFreeing = getMemoryReservationPoolStats();
+	compartment                                         = nullptr;
+	collectGarbage();
+
+	// Freeing the memory must have added its reservation to the pool.
+	const MemoryReservationPoolStats statsAfterFreeing = getMemoryReservationPoolStats();
+	errorUnless(statsAfterFreeing.numPooledReservations == 1);
+	errorUnless(statsAfterFreeing.numFreedReservations == statsBeforeFreeing.numFreedReservations);
+
+	// The next memory must reuse the pooled reservation, and all its pages must read as zero,
+	// including the pages that it grows into.
+	compartment = createCompartment();
+	memory      = createMemory(compartment, testMemoryType);
+	errorUnless(memory);
+	const MemoryReservationPoolStats statsAfterReuse = getMemoryReservationPoolStats();
+	errorUnless(statsAfterReuse.numPooledReservations == 0);
+	errorUnless(statsAfterReuse.numReusedReservations
+				== statsAfterFreeing.numReusedReservations + 1);
+	errorUnless(statsAfterReuse.numAllocatedReservations
+				== statsAfterFreeing.numAllocatedReservations);
+	errorUnless(getMemoryBaseAddress(memory) == freedBaseAddress);
+	errorUnless(getMemoryNumPages(memory) == 1);
+	errorUnless(isMemoryZero(memory, 0, IR::numBytesPerPage));
+	errorUnless(growMemory(memory, 2) == 1);
+	errorUnless(isMemoryZero(memory, 0, 3 * IR::numBytesPerPage));
+
+	compartment = nullptr;
+	collectGarbage();
+}
+
+static void testPoolSize()
+{
+	setMaxPooledMemoryReservations(0);
+	setMaxPooledMemoryReservations(numTestMemories);
+
+	// Freeing more memories than the pool holds must free the remaining reservations.
+	const MemoryReservationPoolStats statsBeforeFreeing = getMemoryReservationPoolStats();
+	GCPointer<Compartment> compartment                  = createCompartment();
+	for(Uptr memoryIndex = 0; memoryIndex < numTestMemories + 1; ++memoryIndex)
+	{ errorUnless(createMemory(compartment, testMemoryType)); }
+	compartment = nullptr;
+	collectGarbage();
+
+	const MemoryReservationPoolStats statsAfterFreeing = getMemoryReservationPoolStats();
+	errorUnless(statsAfterFreeing.numPooledReservations == numTestMemories);
+	errorUnless(statsAfterFreeing.maxPooledReservations == numTestMemories);
+	errorUnless(statsAfterFreeing.numFreedReservations
+				== statsBeforeFreeing.numFreedReservations + 1);
+
+	// Shrinking the pool must free the reservations that no longer fit in it.
+	setMaxPooledMemoryReservations(1);
+	const MemoryReservationPoolStats statsAfterShrinking = getMemoryReservationPoolStats();
+	errorUnless(statsAfterShrinking.numPooledReservations == 1);
+	errorUnless(statsAfterShrinking.numFreedReservations
+				== statsAfterFreeing.numFreedReservations + numTestMemories - 1);
+
+	// Disabling the pool must free the last pooled reservation, and with pooling disabled, freeing
+	// a memory must free its reservation.
+	setMaxPooledMemoryReservations(0);
+	compartment = createCompartment();
+	errorUnless(createMemory(compartment, testMemoryType));
+	compartment = nullptr;
+	collectGarbage();
+
+	const MemoryReservationPoolStats statsWithoutPool = getMemoryReservationPoolStats();
+	errorUnless(statsWithoutPool.numPooledReservations == 0);
+	errorUnless(statsWithoutPool.numFreedReservations
+				== statsAfterShrinking.numFreedReservations + 2);
+}
+
+// Writes a byte to each of a set of offsets in a memory.
+static void writeTestBytes(MemoryInstance* memory, U8 value)
+{
+	U8* baseAddress                             = getMemoryBaseAddress(memory);
+	baseAddress[0]                              = value;
+	baseAddress[IR::numBytesPerPage]            = value + 1;
+	baseAddress[3 * IR::numBytesPerPage + 1000] = value + 2;
+}
+
+// Returns true if a memory contains the bytes written by writeTestBytes.
+static bool hasTestBytes(MemoryInstance* memory, U8 value)
+{
+	const U8* baseAddress = getMemoryBaseAddress(memory);
+	return baseAddress[0] == value && baseAddress[IR::numBytesPerPage] == U8(value + 1)
+		   && baseAddress[3 * IR::numBytesPerPage + 1000] == U8(value + 2);
+}
+
+// Creates a memory with 4 pages, and writes the test bytes to it.
+static MemoryInstance* createTestMemory(Compartment* compartment, U8 value)
+{
+	MemoryInstance* memory = createMemory(compartment, testMemoryType);
+	errorUnless(memory);
+	errorUnless(growMemory(memory, 3) == 1);
+	writeTestBytes(memory, value);
+	return memory;
+}
+
+static void testCloneIsolation()
+{
+	GCPointer<Compartment> compartment = createCompartment();
+	MemoryInstance* memory             = createTestMemory(compartment, 1);
+
+	// The clone must have the memory's size and contents. Compartments don't keep their memories
+	// alive, so root the clones until the end of the test.
+	GCPointer<Compartment> cloneCompartment = createCompartment();
+	GCPointer<MemoryInstance> clone         = cloneMemory(memory, cloneCompartment);
+	errorUnless(clone);
+	errorUnless(getMemoryNumPages(clone) == 4);
+	errorUnless(hasTestBytes(clone, 1));
+
+	// Writes to the memory after cloning it must not change the clone, and writes to the clone
+	// must not change the memory.
+	writeTestBytes(memory, 10);
+	errorUnless(hasTestBytes(clone, 1));
+	writeTestBytes(clone, 20);
+	errorUnless(hasTestBytes(memory, 10));
+
+	// Cloning the memory again must copy the pages it wrote since it was first cloned, without
+	// changing the first clone.
+	GCPointer<MemoryInstance> secondClone = cloneMemory(memory, cloneCompartment);
+	errorUnless(secondClone);
+	errorUnless(hasTestBytes(secondClone, 10));
+	errorUnless(hasTestBytes(clone, 20));
+
+	// A clone of a clone must have the clone's contents, and be isolated from it and from the
+	// original memory.
+	GCPointer<MemoryInstance> cloneOfClone = cloneMemory(clone, cloneCompartment);
+	errorUnless(cloneOfClone);
+	errorUnless(hasTestBytes(cloneOfClone, 20));
+	writeTestBytes(cloneOfClone, 30);
+	writeTestBytes(clone, 40);
+	writeTestBytes(memory, 50);
+	errorUnless(hasTestBytes(cloneOfClone, 30));
+	errorUnless(hasTestBytes(clone, 40));
+	errorUnless(hasTestBytes(secondClone, 10));
+
+	// Freeing the original memory must not change its clones.
+	compartment = nullptr;
+	collectGarbage();
+	errorUnless(hasTestBytes(clone, 40));
+	errorUnless(hasTestBytes(secondClone, 10));
+	errorUnless(hasTestBytes(cloneOfClone, 30));
+
+	clone            = nullptr;
+	secondClone      = nullptr;
+	cloneOfClone     = nullptr;
+	cloneCompartment = nullptr;
+	collectGarbage();
+}
+
+static void testCopyOnWriteShrinkAndGrow()
+{
+	GCPointer<Compartment> compartment = createCompartment();
+	MemoryInstance* memory             = createTestMemory(compartment, 1);
+	MemoryInstance* clone              = cloneMemory(memory, compartment);
+	errorUnless(clone);
+
+	// Shrinking a copy-on-write memory and growing it again must zero the regrown pages, instead
+	// of reverting them to the page file's data. Check both the memory, which was remapped
+	// copy-on-write when it was cloned, and the clone.
+	for(MemoryInstance* copyOnWriteMemory : {memory, clone})
+	{
+		errorUnless(shrinkMemory(copyOnWriteMemory, 3) == 4);
+		errorUnless(growMemory(copyOnWriteMemory, 3) == 1);
+		errorUnless(getMemoryBaseAddress(copyOnWriteMemory)[0] == 1);
+		errorUnless(isMemoryZero(copyOnWriteMemory, IR::numBytesPerPage, 3 * IR::numBytesPerPage));
+	}
+
+	// A clone of the shrunk and regrown memory must also read the regrown pages as zero.
+	MemoryInstance* cloneOfRegrown = cloneMemory(clone, compartment);
+	errorUnless(cloneOfRegrown);
+	errorUnless(getMemoryBaseAddress(cloneOfRegrown)[0] == 1);
+	errorUnless(isMemoryZero(cloneOfRegrown, IR::numBytesPerPage, 3 * IR::numBytesPerPage));
+
+	compartment = nullptr;
+	collectGarbage();
+}
+
+static void testCloneIntoPooledReservation()
+{
+	// Root the memory, so it isn't freed by the collection that frees the other memory.
+	GCPointer<Compartment> compartment = createCompartment();
+	GCPointer<MemoryInstance> memory   = createMemory(compartment, testMemoryType);
+	errorUnless(memory);
+	errorUnless(growMemory(memory, 3) == 1);
+	getMemoryBaseAddress(memory)[IR::numBytesPerPage] = 5;
+
+	// Free a memory that wrote to its pages, so its reservation is pooled with its page file still
+	// mapped to it.
+	setMaxPooledMemoryReservations(0);
+	setMaxPooledMemoryReservations(1);
+	GCPointer<Compartment> freedCompartment = createCompartment();
+	createTestMemory(freedCompartment, 1);
+	freedCompartment = nullptr;
+	collectGarbage();
+
+	// A clone that reuses the pooled reservation must have the cloned memory's contents, and
+	// nothing from the freed memory.
+	const MemoryReservationPoolStats statsBeforeClone = getMemoryReservationPoolStats();
+	errorUnless(statsBeforeClone.numPooledReservations == 1);
+	MemoryInstance* clone = cloneMemory(memory, compartment);
+	errorUnless(clone);
+	errorUnless(getMemoryReservationPoolStats().numReusedReservations
+				== statsBeforeClone.numReusedReservations + 1);
+	errorUnless(getMemoryBaseAddress(clone)[IR::numBytesPerPage] == 5);
+	errorUnless(isMemoryZero(clone, 0, IR::numBytesPerPage));
+	errorUnless(isMemoryZero(clone, 2 * IR::numBytesPerPage, 2 * IR::numBytesPerPage));
+
+	// Writes to the clone must not change the memory.
+	writeTestBytes(clone, 60);
+	errorUnless(getMemoryBaseAddress(memory)[0] == 0);
+	errorUnless(getMemoryBaseAddress(memory)[IR::numBytesPerPage] == 5);
+
+	memory      = nullptr;
+	compartment = nullptr;
+	collectGarbage();
+}
+
+static const char imageModuleWAST[]
+	= "(module\n"
+	  "  (memory (export \"memory\") 2)\n"
+	  "  (data (i32.const 16) \"\\2a\\2b\")\n"
+	  "  (data (i32.const 70000) \"\\2c\")\n"
+	  ")\n";
+
+// Instantiates the image test module, and checks that its memory contains the data segments.
+static MemoryInstance* instantiateImageModule(Compartment* compartment, const Module& module)
+{
+	ModuleInstance* moduleInstance
+		= instantiateModule(compartment, module, ImportBindings{}, "MemoryTest");
+	errorUnless(moduleInstance);
+	MemoryInstance* memory = asMemoryNullable(getInstanceExport(moduleInstance, "memory"));
+	errorUnless(memory);
+	errorUnless(getMemoryNumPages(memory) == 2);
+
+	const U8* baseAddress = getMemoryBaseAddress(memory);
+	errorUnless(baseAddress[16] == 0x2a && baseAddress[17] == 0x2b && baseAddress[70000] == 0x2c);
+	errorUnless(isMemoryZero(memory, 0, 16));
+	errorUnless(isMemoryZero(memory, 18, 70000 - 18));
+	errorUnless(isMemoryZero(memory, 70001, 2 * IR::numBytesPerPage - 70001));
+	return memory;
+}
+
+static void testMemoryImageCache()
+{
+	Module module;
+	std::vector<WAST::Error> parseErrors;
+	errorUnless(WAST::parseModule(imageModuleWAST, strlen(imageModuleWAST), module, parseErrors));
+	setMaxMemoryImageCacheBytes(defaultMaxMemoryImageCacheBytes);
+
+	// The first instance's memory must be added to the cache, and the second instance's memory
+	// must be restored from it. If the platform can't share memory pages copy-on-write, memories
+	// aren't cached, but the instances' memories must still be initialized.
+	GCPointer<Compartment> compartment          = createCompartment();
+	const MemoryImageCacheStats statsBeforeFirst = getMemoryImageCacheStats();
+	MemoryInstance* firstMemory                  = instantiateImageModule(compartment, module);
+	const MemoryImageCacheStats statsAfterFirst  = getMemoryImageCacheStats();
+	const bool isCacheSupported = statsAfterFirst.numImages != statsBeforeFirst.numImages;
+	if(isCacheSupported)
+	{
+		errorUnless(statsAfterFirst.numImages == statsBeforeFirst.numImages + 1);
+		errorUnless(statsAfterFirst.numDataBytes == statsBeforeFirst.numDataBytes + 3);
+	}
+	errorUnless(statsAfterFirst.numRestoredMemories == statsBeforeFirst.numRestoredMemories);
+
+	MemoryInstance* secondMemory                 = instantiateImageModule(compartment, module);
+	const MemoryImageCacheStats statsAfterSecond = getMemoryImageCacheStats();
+	errorUnless(statsAfterSecond.numImages == statsAfterFirst.numImages);
+	errorUnless(statsAfterSecond.numRestoredMemories
+				== statsAfterFirst.numRestoredMemories + (isCacheSupported ? 1 : 0));
+	errorUnless(statsAfterSecond.numRejectedImages == statsAfterFirst.numRejectedImages);
+
+	// The restored memory must not share writes with the memory the image was taken from.
+	getMemoryBaseAddress(firstMemory)[16]  = 1;
+	getMemoryBaseAddress(secondMemory)[17] = 2;
+	errorUnless(getMemoryBaseAddress(secondMemory)[16] == 0x2a);
+	errorUnless(getMemoryBaseAddress(firstMemory)[17] == 0x2b);
+
+	// Memories that use huge pages must not be restored from the cache.
+	GCPointer<Compartment> hugePageCompartment = createCompartment();
+	MemoryCommitPolicy hugePagePolicy;
+	hugePagePolicy.useHugePages = true;
+	setMemoryCommitPolicy(hugePageCompartment, hugePagePolicy);
+	instantiateImageModule(hugePageCompartment, module);
+	errorUnless(getMemoryImageCacheStats().numRestoredMemories
+				== statsAfterSecond.numRestoredMemories);
+
+	// Disabling the cache must evict all the images, and stop restoring memories from it.
+	setMaxMemoryImageCacheBytes(0);
+	const MemoryImageCacheStats statsAfterDisabling = getMemoryImageCacheStats();
+	errorUnless(statsAfterDisabling.numImages == 0);
+	errorUnless(statsAfterDisabling.numDataBytes == 0);
+	errorUnless(statsAfterDisabling.maxDataBytes == 0);
+	instantiateImageModule(compartment, module);
+	instantiateImageModule(compartment, module);
+	const MemoryImageCacheStats statsWhileDisabled = getMemoryImageCacheStats();
+	errorUnless(statsWhileDisabled.numImages == 0);
+	errorUnless(statsWhileDisabled.numRestoredMemories == statsAfterDisabling.numRestoredMemories);
+
+	setMaxMemoryImageCacheBytes(defaultMaxMemoryImageCacheBytes);
+	compartment         = nullptr;
+	hugePageCompartment = nullptr;
+	collectGarbage();
+}
+
+static void testCommitPolicies()
+{
+	Module module;
+	std::vector<WAST::Error> parseErrors;
+	errorUnless(WAST::parseModule(imageModuleWAST, strlen(imageModuleWAST), module, parseErrors));
+
+	// Each combination of using huge pages and prefaulting must only change how pages are
+	// committed, and not the contents of the memories, their clones, or their regrown pages.
+	for(bool useHugePages : {false, true})
+	{
+		for(bool prefault : {false, true})
+		{
+			MemoryCommitPolicy policy;
+			policy.useHugePages = useHugePages;
+			policy.prefault     = prefault;
+
+			GCPointer<Compartment> compartment = createCompartment();
+			setMemoryCommitPolicy(compartment, policy);
+
+			// Instantiate the module twice, so the second instance may restore its memory from
+			// the first instance's image.
+			instantiateImageModule(compartment, module);
+			MemoryInstance* memory = instantiateImageModule(compartment, module);
+			errorUnless(growMemory(memory, 2) == 2);
+			errorUnless(isMemoryZero(memory, 2 * IR::numBytesPerPage, 2 * IR::numBytesPerPage));
+			writeTestBytes(memory, 1);
+
+			MemoryInstance* clone = cloneMemory(memory, compartment);
+			errorUnless(clone);
+			errorUnless(hasTestBytes(clone, 1));
+			errorUnless(getMemoryBaseAddress(clone)[17] == 0x2b);
+			writeTestBytes(clone, 2);
+			errorUnless(hasTestBytes(memory, 1));
+
+			// The module's memory can't shrink below its 2 page minimum, so shrink off the pages
+			// it grew into, including the test byte in page 3. The test bytes and data segments
+			// in the first 2 pages must be kept, and the regrown pages must read as zero.
+			errorUnless(shrinkMemory(memory, 2) == 4);
+			errorUnless(growMemory(memory, 2) == 2);
+			const U8* baseAddress = getMemoryBaseAddress(memory);
+			errorUnless(baseAddress[0] == 1 && baseAddress[IR::numBytesPerPage] == 2);
+			errorUnless(baseAddress[17] == 0x2b && baseAddress[70000] == 0x2c);
+			errorUnless(isMemoryZero(memory, 2 * IR::numBytesPerPage, 2 * IR::numBytesPerPage));
+			errorUnless(hasTestBytes(clone, 2));
+
+			compartment = nullptr;
+			collectGarbage();
+		}
+	}
+}
+
+I32 main()
+{
+	Timing::Timer timer;
+	testPooledReservationReuse();
+	testPoolSize();
+	testCloneIsolation();
+	testCopyOnWriteShrinkAndGrow();
+	testCloneIntoPooledReservation();
+	testMemoryImageCache();
+	testCommitPolicies();
+	setMaxPooledMemoryReservations(16);
+	Timing::logTimer("MemoryTest", timer);
+	return 0;
+}
@@ -0,0 +1,175 @@
+#include "IR/Module.h"
+#include "Inline/Assert.h"
+#include "Inline/BasicTypes.h"
+#include "Inline/Timing.h"
+#include "Logging/Logging.h"
+#include "Platform/Platform.h"
+#include "Runtime/Runtime.h"
+#include "WAST/WAST.h"
+
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+using namespace IR;
+using namespace Runtime;
+
+static const char testModuleWAST[]
+	= "(module\n"
+	  "  (func $trap (export \"trap\") (param i32) (result i32)\n"
+	  "    (if (i32.eqz (get_local 0)) (then unreachable))\n"
+	  "    (i32.add (call $trap (i32.sub (get_local 0) (i32.const 1))) (get_local 0))\n"
+	  "  )\n"
+	  ")\n";
+
+enum
+{
+	testThreadNumStackBytes = 1 * 1024 * 1024,
+	numTestThreads          = 8,
+	numTrapsPerThread       = 1000,
+	trapCallDepth           = 4
+};
+
+static const char wasmFramePrefix[] = "  wasm!TrapTest!";
+
+static void parseTestModule(Module& module)
+{
+	std::vector<WAST::Error> parseErrors;
+	errorUnless(WAST::parseModule(testModuleWAST, strlen(testModuleWAST), module, parseErrors));
+}
+
+static FunctionInstance* instantiateTrapFunction(Compartment* compartment, const Module& module)
+{
+	ModuleInstance* moduleInstance
+		= instantiateModule(compartment, module, ImportBindings{}, "TrapTest");
+	errorUnless(moduleInstance);
+	FunctionInstance* function = asFunctionNullable(getInstanceExport(moduleInstance, "trap"));
+	errorUnless(function);
+	return function;
+}
+
+// Calls the trap function, and returns the description of the exception it causes.
+static std::string describeTrap(Context* context, FunctionInstance* function)
+{
+	std::string description;
+	catchRuntimeExceptions(
+		[&] { invokeFunctionChecked(context, function, {I32(trapCallDepth)}); },
+		[&](Exception&& exception) {
+			errorUnless(exception.typeInstance == Exception::reachedUnreachableType);
+			description = describeException(exception);
+		});
+	errorUnless(description.size());
+	return description;
+}
+
+// Returns the number of frames in an exception description that are in the test module.
+static Uptr countWASMFrames(const std::string& description, bool expectOpIndices)
+{
+	Uptr numFrames  = 0;
+	Uptr lineOffset = 0;
+	while(lineOffset < description.size())
+	{
+		Uptr lineEnd = description.find('\n', lineOffset);
+		if(lineEnd == std::string::npos) { lineEnd = description.size(); }
+
+		const std::string line = description.substr(lineOffset, lineEnd - lineOffset);
+		if(!line.compare(0, strlen(wasmFramePrefix), wasmFramePrefix))
+		{
+			// Frames only include the op index if the code was compiled with debug info.
+			const bool hasOpIndex = line.find('+', strlen(wasmFramePrefix)) != std::string::npos;
+			errorUnless(hasOpIndex == expectOpIndices);
+			++numFrames;
+		}
+
+		lineOffset = lineEnd + 1;
+	}
+	return numFrames;
+}
+
+static void testTrapDescriptions(bool enableDebugInfo)
+{
+	setDebugInfo(enableDebugInfo);
+
+	Module module;
+	parseTestModule(module);
+	GCPointer<Compartment> compartment = createCompartment();
+	FunctionInstance* function         = instantiateTrapFunction(compartment, module);
+	Context* context                   = createContext(compartment);
+
+	errorUnless(countWASMFrames(describeTrap(context, function), enableDebugInfo) > 0);
+
+	compartment = nullptr;
+	collectGarbage();
+
+	setDebugInfo(true);
+}
+
+struct TrapThreadArgs
+{
+	Context* context;
+	FunctionInstance* function;
+};
+
+static I64 trapThreadEntry(void* argsVoid)
+{
+	TrapThreadArgs* args = (TrapThreadArgs*)argsVoid;
+
+	Uptr numDescribedTraps = 0;
+	for(Uptr trapIndex = 0; trapIndex < numTrapsPerThread; ++trapIndex)
+	{
+		if(countWASMFrames(describeTrap(args->context, args->function), true))
+		{ ++numDescribedTraps; }
+	}
+	return numDescribedTraps;
+}
+
+static void testConcurrentTrapDescriptions()
+{
+	Module module;
+	parseTestModule(module);
+	GCPointer<Compartment> compartment = createCompartment();
+	FunctionInstance* function         = instantiateTrapFunction(compartment, module);
+
+	// Trap and describe the traps on several threads, while this thread loads and unloads other
+	// instances of the module, which adds and removes symbols from the JIT symbol table. Root the
+	// objects the threads use, since this thread collects garbage while they run.
+	addGCRoot(asObject(function));
+	std::vector<TrapThreadArgs> threadArgs(numTestThreads);
+	for(TrapThreadArgs& args : threadArgs)
+	{
+		args.context  = createContext(compartment);
+		args.function = function;
+		addGCRoot(asObject(args.context));
+	}
+
+	std::vector<Platform::Thread*> threads;
+	for(TrapThreadArgs& args : threadArgs)
+	{ threads.push_back(Platform::createThread(testThreadNumStackBytes, trapThreadEntry, &args)); }
+
+	for(Uptr instanceIndex = 0; instanceIndex < 20; ++instanceIndex)
+	{
+		GCPointer<Compartment> tempCompartment = createCompartment();
+		instantiateTrapFunction(tempCompartment, module);
+		tempCompartment = nullptr;
+		collectGarbage();
+	}
+
+	for(Platform::Thread* thread : threads)
+	{ errorUnless(Uptr(Platform::joinThread(thread)) == numTrapsPerThread); }
+
+	for(TrapThreadArgs& args : threadArgs) { removeGCRoot(asObject(args.context)); }
+	removeGCRoot(asObject(function));
+	compartment = nullptr;
+	collectGarbage();
+}
+
+I32 main()
+{
+	Timing::Timer timer;
+	testTrapDescriptions(true);
+	testTrapDescriptions(false);
+	testConcurrentTrapDescriptions();
+	Timing::logTimer("TrapTest", timer);
+	return 0;
+}
@@ -0,0 +1,53 @@
+;; Functions that are called and loop enough to be recompiled at the optimized tier when run with
+;; tiered compilation, and then called again directly and through a table.
+
+(module
+  (global $counter (mut i32) (i32.const 0))
+
+  (table anyfunc (elem $sum $fib))
+
+  (type $i32_to_i64 (func (param i32) (result i64)))
+
+  (func $sum (export "sum") (param $n i32) (result i64)
+    (local $i i32)
+    (local $total i64)
+    (block $done
+      (loop $continue
+        (br_if $done (i32.ge_u (get_local $i) (get_local $n)))
+        (set_local $total (i64.add (get_local $total) (i64.extend_u/i32 (get_local $i))))
+        (set_local $i (i32.add (get_local $i) (i32.const 1)))
+        (br $continue)
+      )
+    )
+    (get_local $total)
+  )
+
+  (func $fib (export "fib") (param $n i32) (result i64)
+    (set_global $counter (i32.add (get_global $counter) (i32.const 1)))
+    (if (result i64) (i32.lt_u (get_local $n) (i32.const 2))
+      (then (i64.extend_u/i32 (get_local $n)))
+      (else
+        (i64.add
+          (call $fib (i32.sub (get_local $n) (i32.const 1)))
+          (call $fib (i32.sub (get_local $n) (i32.const 2)))
+        )
+      )
+    )
+  )
+
+  (func (export "call_indirect") (param $index i32) (param $n i32) (result i64)
+    (call_indirect (type $i32_to_i64) (get_local $n) (get_local $index))
+  )
+
+  (func (export "counter") (result i32) (get_global $counter))
+)
+
+(assert_return (invoke "sum" (i32.const 100000)) (i64.const 4999950000))
+(assert_return (invoke "sum" (i32.const 100000)) (i64.const 4999950000))
+(assert_return (invoke "call_indirect" (i32.const 0) (i32.const 100000)) (i64.const 4999950000))
+
+(assert_return (invoke "fib" (i32.const 25)) (i64.const 75025))
+(assert_return (invoke "counter") (i32.const 242785))
+(assert_return (invoke "fib" (i32.const 25)) (i64.const 75025))
+(assert_return (invoke "call_indirect" (i32.const 1) (i32.const 25)) (i64.const 75025))
+(assert_return (invoke "counter") (i32.const 728355))